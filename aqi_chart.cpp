@@ -0,0 +1,247 @@
+// Chart drawing shared by the AqiChart widget and the benchmarks; see
+// aqi_chart.h.
+
+#include "aqi_chart.h"
+
+#include <stdio.h>
+
+const GdkRGBA chart_series_color = {0.2f, 0.6f, 1.0f, 1.0f};
+
+// Muted so the lines stay behind the series they break down
+static const GdkRGBA chart_line_colors[] = {
+    {0.90f, 0.45f, 0.20f, 0.7f}, {0.30f, 0.70f, 0.35f, 0.7f}, {0.65f, 0.40f, 0.80f, 0.7f},
+    {0.85f, 0.70f, 0.15f, 0.7f}, {0.20f, 0.65f, 0.70f, 0.7f}, {0.85f, 0.35f, 0.55f, 0.7f},
+    {0.55f, 0.55f, 0.55f, 0.7f}, {0.50f, 0.35f, 0.20f, 0.7f},
+};
+
+void chart_format_value(ChartUnit unit, double value, char *buf, size_t len)
+{
+    switch (unit)
+    {
+    case CHART_UNIT_PERCENT:
+        snprintf(buf, len, "%.0f%%", value);
+        break;
+    case CHART_UNIT_MBPS:
+        snprintf(buf, len, "%.1f Mbps", value);
+        break;
+    default:
+        snprintf(buf, len, "%.0f", value);
+        break;
+    }
+}
+
+double chart_value_y(const ChartGeometry &geo, double value)
+{
+    return geo.margin_y + geo.graph_h - (value / (double)geo.max_val * geo.graph_h);
+}
+
+// Lays out text so that (x, baseline) matches cairo_move_to + cairo_show_text
+void chart_append_text(GtkSnapshot *snapshot, PangoContext *pango, const char *text, const char *font,
+                       const GdkRGBA *color, double x, double baseline)
+{
+    PangoLayout *layout = pango_layout_new(pango);
+    pango_layout_set_text(layout, text, -1);
+    PangoFontDescription *desc = pango_font_description_from_string(font);
+    pango_layout_set_font_description(layout, desc);
+    pango_font_description_free(desc);
+
+    gtk_snapshot_save(snapshot);
+    double top = baseline - pango_layout_get_baseline(layout) / (double)PANGO_SCALE;
+    graphene_point_t origin = GRAPHENE_POINT_INIT((float)x, (float)top);
+    gtk_snapshot_translate(snapshot, &origin);
+    gtk_snapshot_append_layout(snapshot, layout, color);
+    gtk_snapshot_restore(snapshot);
+
+    g_object_unref(layout);
+}
+
+void chart_text_extents(PangoContext *pango, const char *text, const char *font, PangoRectangle *ink)
+{
+    PangoLayout *layout = pango_layout_new(pango);
+    pango_layout_set_text(layout, text, -1);
+    PangoFontDescription *desc = pango_font_description_from_string(font);
+    pango_layout_set_font_description(layout, desc);
+    pango_font_description_free(desc);
+    pango_layout_get_pixel_extents(layout, ink, NULL);
+    g_object_unref(layout);
+}
+
+static void chart_append_line(GtkSnapshot *snapshot, const std::vector<ChartPoint> &points, const ChartGeometry &geo,
+                              const GdkRGBA *color)
+{
+    if (points.size() < 2)
+        return;
+
+#if GTK_CHECK_VERSION(4, 14, 0)
+    GskPathBuilder *builder = gsk_path_builder_new();
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        float x = (float)(geo.margin_x + points[i].index * geo.step_x);
+        float y = (float)chart_value_y(geo, points[i].value);
+        if (i == 0)
+            gsk_path_builder_move_to(builder, x, y);
+        else
+            gsk_path_builder_line_to(builder, x, y);
+    }
+    GskPath *line = gsk_path_builder_free_to_path(builder);
+
+    GskStroke *stroke = gsk_stroke_new(1.5f);
+    gtk_snapshot_append_stroke(snapshot, line, stroke, color);
+    gsk_stroke_free(stroke);
+    gsk_path_unref(line);
+#else
+    graphene_rect_t bounds = GRAPHENE_RECT_INIT(0.0f, 0.0f, (float)(geo.margin_x + geo.graph_w + 20.0),
+                                                (float)(geo.margin_y * 2 + geo.graph_h));
+    cairo_t *cr = gtk_snapshot_append_cairo(snapshot, &bounds);
+    gdk_cairo_set_source_rgba(cr, color);
+    cairo_set_line_width(cr, 1.5);
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        double x = geo.margin_x + points[i].index * geo.step_x;
+        double y = chart_value_y(geo, points[i].value);
+        if (i == 0)
+            cairo_move_to(cr, x, y);
+        else
+            cairo_line_to(cr, x, y);
+    }
+    cairo_stroke(cr);
+    cairo_destroy(cr);
+#endif
+}
+
+static void chart_append_series(GtkSnapshot *snapshot, const std::vector<ChartPoint> &points, const ChartGeometry &geo)
+{
+    graphene_rect_t plot = GRAPHENE_RECT_INIT((float)geo.margin_x, (float)geo.margin_y, (float)geo.graph_w,
+                                              (float)geo.graph_h);
+    GskColorStop stops[2] = {{0.0f, {0.2f, 0.6f, 1.0f, 0.4f}}, {1.0f, {0.2f, 0.6f, 1.0f, 0.0f}}};
+    graphene_point_t grad_start = GRAPHENE_POINT_INIT(0.0f, (float)geo.margin_y);
+    graphene_point_t grad_end = GRAPHENE_POINT_INIT(0.0f, (float)(geo.margin_y + geo.graph_h));
+
+#if GTK_CHECK_VERSION(4, 14, 0)
+    GskPathBuilder *line_builder = gsk_path_builder_new();
+    GskPathBuilder *area_builder = gsk_path_builder_new();
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        float x = (float)(geo.margin_x + points[i].index * geo.step_x);
+        float y = (float)chart_value_y(geo, points[i].value);
+        if (i == 0)
+        {
+            gsk_path_builder_move_to(line_builder, x, y);
+            gsk_path_builder_move_to(area_builder, x, y);
+        }
+        else
+        {
+            gsk_path_builder_line_to(line_builder, x, y);
+            gsk_path_builder_line_to(area_builder, x, y);
+        }
+    }
+    gsk_path_builder_line_to(area_builder, (float)(geo.margin_x + geo.graph_w), (float)(geo.margin_y + geo.graph_h));
+    gsk_path_builder_line_to(area_builder, (float)geo.margin_x, (float)(geo.margin_y + geo.graph_h));
+    gsk_path_builder_close(area_builder);
+
+    GskPath *line = gsk_path_builder_free_to_path(line_builder);
+    GskPath *area = gsk_path_builder_free_to_path(area_builder);
+
+    GskStroke *stroke = gsk_stroke_new(3.0f);
+    gtk_snapshot_append_stroke(snapshot, line, stroke, &chart_series_color);
+    gsk_stroke_free(stroke);
+
+    gtk_snapshot_push_fill(snapshot, area, GSK_FILL_RULE_WINDING);
+    gtk_snapshot_append_linear_gradient(snapshot, &plot, &grad_start, &grad_end, stops, G_N_ELEMENTS(stops));
+    gtk_snapshot_pop(snapshot);
+
+    gsk_path_unref(line);
+    gsk_path_unref(area);
+#else
+    // Pre-4.14 GTK has no path nodes; rasterize only the series via Cairo
+    graphene_rect_t bounds = GRAPHENE_RECT_INIT(0.0f, 0.0f, (float)(geo.margin_x + geo.graph_w + 20.0),
+                                                (float)(geo.margin_y * 2 + geo.graph_h));
+    cairo_t *cr = gtk_snapshot_append_cairo(snapshot, &bounds);
+    gdk_cairo_set_source_rgba(cr, &chart_series_color);
+    cairo_set_line_width(cr, 3.0);
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        double x = geo.margin_x + points[i].index * geo.step_x;
+        double y = chart_value_y(geo, points[i].value);
+        if (i == 0)
+            cairo_move_to(cr, x, y);
+        else
+            cairo_line_to(cr, x, y);
+    }
+    cairo_stroke_preserve(cr);
+    cairo_line_to(cr, geo.margin_x + geo.graph_w, geo.margin_y + geo.graph_h);
+    cairo_line_to(cr, geo.margin_x, geo.margin_y + geo.graph_h);
+    cairo_close_path(cr);
+
+    cairo_pattern_t *pat = cairo_pattern_create_linear(grad_start.x, grad_start.y, grad_end.x, grad_end.y);
+    for (const GskColorStop &stop : stops)
+        cairo_pattern_add_color_stop_rgba(pat, stop.offset, stop.color.red, stop.color.green, stop.color.blue,
+                                          stop.color.alpha);
+    cairo_set_source(cr, pat);
+    cairo_fill(cr);
+    cairo_pattern_destroy(pat);
+    cairo_destroy(cr);
+    (void)plot;
+#endif
+}
+
+GskRenderNode *chart_build_static_node(PangoContext *pango, const std::vector<ChartPoint> &points,
+                                       const std::vector<std::vector<ChartPoint>> *lines, const ChartGeometry &geo,
+                                       int width, int height, const char *value_label)
+{
+    const GdkRGBA background = {0.95f, 0.95f, 0.95f, 1.0f};
+    const GdkRGBA grid_color = {0.8f, 0.8f, 0.8f, 1.0f};
+    const GdkRGBA label_color = {0.4f, 0.4f, 0.4f, 1.0f};
+    GtkSnapshot *snapshot = gtk_snapshot_new();
+
+    graphene_rect_t bounds = GRAPHENE_RECT_INIT(0.0f, 0.0f, (float)width, (float)height);
+    gtk_snapshot_append_color(snapshot, &background, &bounds);
+
+    for (int i = 0; i <= 4; i++)
+    {
+        double y = geo.margin_y + geo.graph_h - (i * geo.graph_h / 4.0);
+
+        graphene_rect_t grid_line = GRAPHENE_RECT_INIT((float)geo.margin_x, (float)(y - 0.5), (float)geo.graph_w, 1.0f);
+        gtk_snapshot_append_color(snapshot, &grid_color, &grid_line);
+
+        char label[16];
+        snprintf(label, sizeof(label), "%d", geo.max_val * i / 4);
+        PangoRectangle ink;
+        chart_text_extents(pango, label, "Sans 10px", &ink);
+        chart_append_text(snapshot, pango, label, "Sans 10px", &label_color, geo.margin_x - ink.width - 5,
+                          y + ink.height / 2.0 - 2);
+    }
+
+    if (lines)
+    {
+        for (size_t i = 0; i < lines->size(); i++)
+            chart_append_line(snapshot, (*lines)[i], geo, &chart_line_colors[i % G_N_ELEMENTS(chart_line_colors)]);
+    }
+
+    chart_append_series(snapshot, points, geo);
+
+    if (value_label)
+    {
+        const GdkRGBA value_color = {0.1f, 0.1f, 0.1f, 0.8f};
+        PangoRectangle ink;
+        chart_text_extents(pango, value_label, "Sans Bold 24px", &ink);
+        chart_append_text(snapshot, pango, value_label, "Sans Bold 24px", &value_color,
+                          width - geo.margin_x - ink.width, geo.margin_y + ink.height);
+    }
+
+    return gtk_snapshot_free_to_node(snapshot);
+}
+
+GdkTexture *chart_render_texture(GskRenderer *renderer, GskRenderNode *node, int width, int height, int scale)
+{
+    // The renderer draws one texture pixel per node unit, so scale the node
+    // up to device pixels as the widget's surface would
+    GskTransform *transform = gsk_transform_scale(NULL, (float)scale, (float)scale);
+    GskRenderNode *scaled = gsk_transform_node_new(node, transform);
+    gsk_transform_unref(transform);
+
+    graphene_rect_t viewport = GRAPHENE_RECT_INIT(0.0f, 0.0f, (float)(width * scale), (float)(height * scale));
+    GdkTexture *texture = gsk_renderer_render_texture(renderer, scaled, &viewport);
+    gsk_render_node_unref(scaled);
+    return texture;
+}
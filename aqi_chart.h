@@ -0,0 +1,99 @@
+// Chart drawing shared by the AqiChart widget and the benchmarks. The
+// static layers of a chart (background, grid, axis labels, the filled
+// series and the live value) are built as a render node from decimated
+// points, so the same node can be appended to a widget snapshot or handed
+// to a GskRenderer offscreen.
+
+#ifndef AQI_CHART_H
+#define AQI_CHART_H
+
+#include <gtk/gtk.h>
+#include <math.h>
+#include <vector>
+
+#include "aqi_core.h"
+
+// How a chart formats its values for the live label and the tooltip
+typedef enum
+{
+    CHART_UNIT_AQI,
+    CHART_UNIT_PERCENT,
+    CHART_UNIT_MBPS,
+} ChartUnit;
+
+extern const GdkRGBA chart_series_color;
+
+void chart_format_value(ChartUnit unit, double value, char *buf, size_t len);
+
+double chart_value_y(const ChartGeometry &geo, double value);
+
+// Lays out text so that (x, baseline) matches cairo_move_to + cairo_show_text
+void chart_append_text(GtkSnapshot *snapshot, PangoContext *pango, const char *text, const char *font,
+                       const GdkRGBA *color, double x, double baseline);
+
+void chart_text_extents(PangoContext *pango, const char *text, const char *font, PangoRectangle *ink);
+
+// Builds the static layers of a width x height chart. `lines`, when not
+// NULL, are stroked thinly under the series in a rotating palette, and
+// `value_label`, when not NULL, is drawn large in the top right corner.
+GskRenderNode *chart_build_static_node(PangoContext *pango, const std::vector<ChartPoint> &points,
+                                       const std::vector<std::vector<ChartPoint>> *lines, const ChartGeometry &geo,
+                                       int width, int height, const char *value_label);
+
+// Decimates `history` for a chart drawn at `scale` device pixels per pixel
+// and lays it out, the work a data change costs the widget before the
+// node is built. `points` receives the plotted vertices.
+template <typename Series>
+ChartGeometry chart_layout(const Series &history, int width, int height, int scale, std::vector<ChartPoint> &points)
+{
+    int columns = (int)ceil(chart_graph_width(width) * scale);
+    chart_downsample(history, columns, points);
+    return chart_compute_geometry(points, history.size(), width, height);
+}
+
+// Decimates each of `lines` into `points` for a chart laid out by
+// chart_layout over `n_samples` samples. The lines are aligned on their
+// newest sample, and geo.max_val grows to fit their peaks.
+template <typename Series>
+void chart_layout_lines(const std::vector<Series> &lines, size_t n_samples, int width, int scale, ChartGeometry &geo,
+                        std::vector<std::vector<ChartPoint>> &points)
+{
+    int columns = (int)ceil(chart_graph_width(width) * scale);
+    points.resize(lines.size());
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        SeriesWindow<Series> window(lines[i], n_samples);
+        chart_downsample(window, columns, points[i]);
+
+        double offset = (double)(n_samples - window.size());
+        for (ChartPoint &p : points[i])
+        {
+            p.index += offset;
+            if (p.value > geo.max_val)
+                geo.max_val = (int)ceil(p.value);
+        }
+    }
+}
+
+// Renders `node` for a width x height chart into a texture at `scale`
+GdkTexture *chart_render_texture(GskRenderer *renderer, GskRenderNode *node, int width, int height, int scale);
+
+// The whole path of a data change, offscreen: decimation, layout, node
+// building and rendering. Returns NULL for an empty series.
+template <typename Series>
+GdkTexture *chart_render_offscreen(GskRenderer *renderer, PangoContext *pango, const Series &history, int width,
+                                   int height, int scale, ChartUnit unit, std::vector<ChartPoint> &points)
+{
+    if (history.empty() || width <= 0 || height <= 0)
+        return NULL;
+
+    ChartGeometry geo = chart_layout(history, width, height, scale, points);
+    char value_label[64];
+    chart_format_value(unit, history.back(), value_label, sizeof(value_label));
+    GskRenderNode *node = chart_build_static_node(pango, points, NULL, geo, width, height, value_label);
+    GdkTexture *texture = chart_render_texture(renderer, node, width, height, scale);
+    gsk_render_node_unref(node);
+    return texture;
+}
+
+#endif // AQI_CHART_H
@@ -0,0 +1,1768 @@
+#include "aqi_core.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define JSON_SIMD_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define JSON_SIMD_NEON 1
+#endif
+#ifdef HAVE_SYSPROF
+#include <sysprof-capture.h>
+#endif
+
+// --- Tracing ---
+
+#define TRACE_RING_SIZE 8192 // Power of two
+
+// A slot is a seqlock keyed on the event index: while event i is being
+// written its sequence is 2i+1, and 2i+2 once complete. A reader accepts
+// a slot only if the sequence reads 2i+2 both before and after the copy,
+// which also rejects slots that have since been reused for a later event.
+// The fields are relaxed atomics so those racing copies stay defined.
+typedef struct
+{
+    std::atomic<size_t> seq;
+    std::atomic<const char *> name;
+    std::atomic<gint64> start_us;
+    std::atomic<gint64> duration_us;
+} TraceSlot;
+
+typedef struct
+{
+    TraceSlot slots[TRACE_RING_SIZE];
+    std::atomic<size_t> head; // Advanced by the owning thread only
+    guint tid;                // Small sequential id for trace exports
+} TraceRing;
+
+std::atomic<bool> trace_enabled(false);
+
+static GMutex trace_rings_lock;
+// Guarded by trace_rings_lock. Never destroyed, so threads still recording
+// during exit, and leak checkers, keep seeing the rings.
+static std::vector<TraceRing *> &trace_rings = *new std::vector<TraceRing *>();
+static thread_local TraceRing *trace_thread_ring = NULL;
+
+static TraceRing *trace_ring_for_thread()
+{
+    if (G_LIKELY(trace_thread_ring))
+        return trace_thread_ring;
+
+    TraceRing *ring = new TraceRing();
+    ring->head.store(0);
+    for (TraceSlot &slot : ring->slots)
+        slot.seq.store(0, std::memory_order_relaxed);
+    g_mutex_lock(&trace_rings_lock);
+    ring->tid = (guint)trace_rings.size() + 1;
+    trace_rings.push_back(ring);
+    g_mutex_unlock(&trace_rings_lock);
+    trace_thread_ring = ring;
+    return ring;
+}
+
+void trace_record(const char *name, gint64 start_us, gint64 end_us)
+{
+    TraceRing *ring = trace_ring_for_thread();
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    TraceSlot &slot = ring->slots[head & (TRACE_RING_SIZE - 1)];
+    slot.seq.store(2 * head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start_us.store(start_us, std::memory_order_relaxed);
+    slot.duration_us.store(end_us - start_us, std::memory_order_relaxed);
+    slot.seq.store(2 * head + 2, std::memory_order_release);
+    ring->head.store(head + 1, std::memory_order_release);
+
+#ifdef HAVE_SYSPROF
+    sysprof_collector_mark(start_us * 1000, (end_us - start_us) * 1000, "aqi", name, NULL);
+#endif
+}
+
+void trace_collect(gint64 since_us, std::vector<TraceEvent> &out, std::vector<guint> *tids)
+{
+    g_mutex_lock(&trace_rings_lock);
+    std::vector<TraceRing *> rings = trace_rings;
+    g_mutex_unlock(&trace_rings_lock);
+
+    for (TraceRing *ring : rings)
+    {
+        size_t head = ring->head.load(std::memory_order_acquire);
+        size_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        for (size_t i = first; i < head; i++)
+        {
+            const TraceSlot &slot = ring->slots[i & (TRACE_RING_SIZE - 1)];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq != 2 * i + 2)
+                continue; // Overwritten by a later event, or being written
+
+            TraceEvent e;
+            e.name = slot.name.load(std::memory_order_relaxed);
+            e.start_us = slot.start_us.load(std::memory_order_relaxed);
+            e.duration_us = slot.duration_us.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != seq)
+                continue; // The writer lapped us during the copy
+
+            if (e.start_us < since_us)
+                continue;
+            out.push_back(e);
+            if (tids)
+                tids->push_back(ring->tid);
+        }
+    }
+}
+
+// --- JSON Helpers ---
+
+// Copies the number at `pos`, short of `end`, into `buf` for the C library
+// readers, which need it NUL-terminated
+static const char *json_copy_number(const char *pos, const char *end, char (&buf)[64])
+{
+    size_t n = 0;
+    while (pos < end && n < sizeof(buf) - 1 &&
+           ((*pos >= '0' && *pos <= '9') || *pos == '-' || *pos == '+' || *pos == '.' || *pos == 'e' || *pos == 'E'))
+        buf[n++] = *pos++;
+    buf[n] = '\0';
+    return buf;
+}
+
+// Parse integer from JSON position
+int json_parse_int(const char *pos, const char *end)
+{
+    if (!pos)
+        return 0;
+    if (pos < end && *pos == '"')
+        pos++; // Skip opening quote if string
+    char buf[64];
+    return atoi(json_copy_number(pos, end, buf));
+}
+
+// Parse double from JSON position. Plain decimals of up to 15 digits, all
+// the feeds send, are read directly and exactly: both the digits and the
+// power of ten are exact doubles, so the one division rounds as strtod
+// would. Anything else goes to g_ascii_strtod, which unlike atof does not
+// depend on the locale.
+double json_parse_double(const char *pos, const char *end)
+{
+    if (!pos)
+        return 0.0;
+    if (pos < end && *pos == '"')
+        pos++;
+
+    static const double powers_of_ten[] = {1e0, 1e1, 1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                           1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+    const char *p = pos;
+    bool negative = p < end && *p == '-';
+    if (negative)
+        p++;
+    guint64 digits = 0;
+    int n_digits = 0;
+    int n_fraction = 0;
+    while (p < end && *p >= '0' && *p <= '9' && n_digits <= 15)
+    {
+        digits = digits * 10 + (guint64)(*p++ - '0');
+        n_digits++;
+    }
+    if (p < end && *p == '.')
+    {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9' && n_digits <= 15)
+        {
+            digits = digits * 10 + (guint64)(*p++ - '0');
+            n_digits++;
+            n_fraction++;
+        }
+    }
+    if (n_digits == 0 || n_digits > 15 || (p < end && ((*p >= '0' && *p <= '9') || *p == 'e' || *p == 'E')))
+    {
+        char buf[64];
+        return g_ascii_strtod(json_copy_number(pos, end, buf), NULL);
+    }
+
+    double value = (double)digits / powers_of_ten[n_fraction];
+    return negative ? -value : value;
+}
+
+// Extract string value from JSON (up to delimiter)
+std::string json_parse_string(const char *pos, const char *end, size_t max_len)
+{
+    if (!pos)
+        return "";
+    std::string result;
+    if (pos < end && *pos == '"')
+        pos++;
+    while (pos < end && *pos && *pos != '"' && *pos != ',' && *pos != '}' && result.length() < max_len)
+    {
+        if (*pos == '\\' && pos + 1 < end && *(pos + 1))
+        {
+            pos++; // Skip escape
+        }
+        result += *pos++;
+    }
+    return result;
+}
+
+const char *json_skip_long_string(const char *p, const char *end)
+{
+    const char *body = p + 1;
+    p = body;
+    while (p < end)
+    {
+        const char *quote = (const char *)memchr(p, '"', (size_t)(end - p));
+        if (!quote)
+            break;
+
+        // The quote is escaped if an odd run of backslashes precedes it
+        const char *b = quote;
+        while (b > body && b[-1] == '\\')
+            b--;
+        if (((quote - b) & 1) == 0)
+            return quote + 1;
+        p = quote + 1;
+    }
+    return end;
+}
+
+// --- JSON Structural Index ---
+// Arrays and objects are walked 64 bytes at a time. One classification
+// pass turns a block into bit masks of its quotes, backslashes and
+// brackets (SSE2 or NEON where the target has them), and which bytes lie
+// inside strings falls out of a prefix XOR over the unescaped quotes. A
+// walk then settles most blocks by counting brackets and visits only the
+// few bytes it asks about, rather than stepping from token to token.
+
+#define JSON_MAX_MARKS 2
+
+typedef struct
+{
+    guint64 quote;
+    guint64 backslash;
+    guint64 open;    // '[' and '{'
+    guint64 close;   // ']' and '}'
+    guint64 marks[JSON_MAX_MARKS]; // The bytes the walk asked to have marked
+} JsonBlockMasks;
+
+#if defined(JSON_SIMD_NEON)
+// Packs four 16-byte compare results into one bit per byte
+static inline guint64 json_neon_bitmask(uint8x16_t c0, uint8x16_t c1, uint8x16_t c2, uint8x16_t c3)
+{
+    const uint8x16_t bits = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+                             0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+    uint8x16_t sum0 = vpaddq_u8(vandq_u8(c0, bits), vandq_u8(c1, bits));
+    uint8x16_t sum1 = vpaddq_u8(vandq_u8(c2, bits), vandq_u8(c3, bits));
+    sum0 = vpaddq_u8(sum0, sum1);
+    sum0 = vpaddq_u8(sum0, sum0);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+}
+#endif
+
+// Classifies the 64 bytes at `p`. Brackets are matched after OR-ing in 0x20,
+// which maps '[' onto '{' and ']' onto '}' and no other byte onto either.
+static inline void json_classify_block(const char *p, const char *marks, JsonBlockMasks *m)
+{
+#if defined(JSON_SIMD_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i fold = _mm_set1_epi8(0x20);
+    memset(m, 0, sizeof(*m));
+    __m128i escapes[4];
+    __m128i any_escape = _mm_setzero_si128();
+    for (int k = 0; k < 4; k++)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * k));
+        __m128i folded = _mm_or_si128(v, fold);
+        int shift = 16 * k;
+        escapes[k] = _mm_cmpeq_epi8(v, backslash);
+        any_escape = _mm_or_si128(any_escape, escapes[k]);
+        m->quote |= (guint64)(guint)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << shift;
+        m->open |= (guint64)(guint)_mm_movemask_epi8(_mm_cmpeq_epi8(folded, open)) << shift;
+        m->close |= (guint64)(guint)_mm_movemask_epi8(_mm_cmpeq_epi8(folded, close)) << shift;
+        for (int j = 0; j < JSON_MAX_MARKS && marks[j]; j++)
+            m->marks[j] |= (guint64)(guint)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(marks[j]))) << shift;
+    }
+    // Backslashes are rare, so their mask is only put together when needed
+    if (_mm_movemask_epi8(any_escape))
+    {
+        for (int k = 0; k < 4; k++)
+            m->backslash |= (guint64)(guint)_mm_movemask_epi8(escapes[k]) << (16 * k);
+    }
+#elif defined(JSON_SIMD_NEON)
+    uint8x16_t v[4], folded[4];
+    for (int k = 0; k < 4; k++)
+    {
+        v[k] = vld1q_u8((const uint8_t *)p + 16 * k);
+        folded[k] = vorrq_u8(v[k], vdupq_n_u8(0x20));
+    }
+#define JSON_NEON_MASK(src, c)                                                                                       \
+    json_neon_bitmask(vceqq_u8(src[0], vdupq_n_u8(c)), vceqq_u8(src[1], vdupq_n_u8(c)),                              \
+                      vceqq_u8(src[2], vdupq_n_u8(c)), vceqq_u8(src[3], vdupq_n_u8(c)))
+    m->quote = JSON_NEON_MASK(v, '"');
+    m->backslash = JSON_NEON_MASK(v, '\\');
+    m->open = JSON_NEON_MASK(folded, '{');
+    m->close = JSON_NEON_MASK(folded, '}');
+    memset(m->marks, 0, sizeof(m->marks));
+    for (int j = 0; j < JSON_MAX_MARKS && marks[j]; j++)
+        m->marks[j] = JSON_NEON_MASK(v, (uint8_t)marks[j]);
+#undef JSON_NEON_MASK
+#else
+    memset(m, 0, sizeof(*m));
+    for (int i = 0; i < 64; i++)
+    {
+        guint64 bit = (guint64)1 << i;
+        char folded = (char)(p[i] | 0x20);
+        m->quote |= p[i] == '"' ? bit : 0;
+        m->backslash |= p[i] == '\\' ? bit : 0;
+        m->open |= folded == '{' ? bit : 0;
+        m->close |= folded == '}' ? bit : 0;
+        for (int j = 0; j < JSON_MAX_MARKS && marks[j]; j++)
+            m->marks[j] |= p[i] == marks[j] ? bit : 0;
+    }
+#endif
+}
+
+// Bit i of the result is the XOR of bits 0..i of x
+static inline guint64 json_prefix_xor(guint64 x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// Without a population count instruction GCC calls out to libgcc, which
+// costs more than the few operations of the portable version
+static inline int json_popcount(guint64 x)
+{
+#if defined(__POPCNT__) || defined(__aarch64__)
+    return __builtin_popcountll(x);
+#else
+    x -= (x >> 1) & 0x5555555555555555ULL;
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+typedef struct
+{
+    const char *base; // First byte of the block; bit i stands for base[i]
+    guint64 open;     // Brackets outside strings
+    guint64 close;
+    guint64 quotes;   // Unescaped quotes
+    guint64 strings;  // The opening ones among them
+    guint64 marks[JSON_MAX_MARKS]; // Occurrences of each of `marks`, anywhere
+} JsonBlock;
+
+// Classifies [p, end) block by block and calls `visit(block)` on each until
+// it returns false. `marks` holds up to JSON_MAX_MARKS bytes to have marked.
+template <typename F>
+static inline void json_for_each_block(const char *p, const char *end, const char *marks, F visit)
+{
+    guint64 in_string = 0; // All ones while a string runs on from the previous block
+    guint64 carry = 0;     // Bit 0 set when the previous block ended in an escaping backslash
+    while (p < end)
+    {
+        JsonBlockMasks m;
+        size_t n = (size_t)(end - p);
+        if (n >= 64)
+        {
+            json_classify_block(p, marks, &m);
+        }
+        else
+        {
+            // The tail is padded with blanks, which classify as nothing
+            char tail[64];
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, p, n);
+            json_classify_block(tail, marks, &m);
+            for (guint64 &mark : m.marks)
+                mark &= ((guint64)1 << n) - 1;
+        }
+
+        // A backslash escapes the next byte unless it is escaped itself.
+        // Valid JSON has them in strings only, so this loop rarely runs.
+        guint64 escaped = carry;
+        carry = 0;
+        for (guint64 bs = m.backslash; bs; bs &= bs - 1)
+        {
+            guint64 bit = bs & (~bs + 1);
+            if (escaped & bit)
+                continue;
+            if (bit == (guint64)1 << 63)
+                carry = 1;
+            else
+                escaped |= bit << 1;
+        }
+
+        guint64 quotes = m.quote & ~escaped;
+        guint64 inside = json_prefix_xor(quotes) ^ in_string;
+        in_string = 0 - (inside >> 63);
+
+        JsonBlock b;
+        b.base = p;
+        b.open = m.open & ~inside;
+        b.close = m.close & ~inside;
+        b.quotes = quotes;
+        b.strings = quotes & inside;
+        memcpy(b.marks, m.marks, sizeof(b.marks));
+        if (!visit(b))
+            return;
+        p += n >= 64 ? 64 : n;
+    }
+}
+
+static inline guint64 json_word_repeat(guchar c)
+{
+    return c * (guint64)0x0101010101010101ULL;
+}
+
+// Sets the top bit of each byte of `w` that equals `c`, and no other bit
+static inline guint64 json_word_match(guint64 w, guchar c)
+{
+    const guint64 low7 = json_word_repeat(0x7f);
+    guint64 x = w ^ json_word_repeat(c);
+    return ~(((x & low7) + low7) | x | low7);
+}
+
+const char *json_skip_value(const char *p, const char *end)
+{
+    if (p >= end)
+        return end;
+    if (*p == '"')
+        return json_skip_string(p, end);
+    if (*p != '[' && *p != '{')
+    {
+        // A scalar ends at the next separator or closing bracket
+        while (p < end && *p != ',' && *p != ']' && *p != '}')
+            p++;
+        return p;
+    }
+
+    // Short containers of numbers, the feeds' [time, value] pairs above all,
+    // end before a block would pay for its classification. They are read a
+    // word at a time, up to the first quote.
+    int depth = 0;
+    if (end - p >= 32)
+    {
+        for (const char *q = p; q < p + 32; q += 8)
+        {
+            guint64 w;
+            memcpy(&w, q, sizeof(w));
+            w = GUINT64_FROM_LE(w);
+            guint64 folded = w | json_word_repeat(0x20);
+            guint64 quotes = json_word_match(w, '"');
+            guint64 open = json_word_match(folded, '{');
+            guint64 close = json_word_match(folded, '}');
+            guint64 before_quote = quotes ? (quotes & (~quotes + 1)) - 1 : ~(guint64)0;
+            for (guint64 brackets = (open | close) & before_quote; brackets; brackets &= brackets - 1)
+            {
+                int i = __builtin_ctzll(brackets);
+                if ((open >> i) & 1)
+                    depth++;
+                else if (--depth == 0)
+                    return q + i / 8 + 1;
+            }
+            if (quotes)
+                break;
+        }
+    }
+
+    const char *value_end = end;
+    depth = 0;
+    json_for_each_block(p, end, "", [&depth, &value_end](const JsonBlock &b) {
+        // A block with fewer closing brackets than open containers cannot
+        // end the value, so counting settles it
+        int closes = json_popcount(b.close);
+        if (closes < depth)
+        {
+            depth += json_popcount(b.open) - closes;
+            return true;
+        }
+        for (guint64 brackets = b.open | b.close; brackets; brackets &= brackets - 1)
+        {
+            int i = __builtin_ctzll(brackets);
+            if ((b.open >> i) & 1)
+            {
+                depth++;
+            }
+            else if (--depth == 0)
+            {
+                value_end = b.base + i + 1;
+                return false;
+            }
+        }
+        return true;
+    });
+    return value_end;
+}
+
+// --- Bounded JSON Cursor ---
+// A small single-pass tokenizer over a (data, size) view. Every read is
+// checked against `end`, so it never relies on the payload being
+// NUL-terminated and never scans past the value it is looking at.
+
+typedef struct
+{
+    const char *pos;
+    const char *end;
+    bool failed; // Set when a member/element list turned out to be malformed
+} JsonCursor;
+
+static void json_skip_ws(JsonCursor &c)
+{
+    while (c.pos < c.end && (*c.pos == ' ' || *c.pos == '\t' || *c.pos == '\n' || *c.pos == '\r'))
+        c.pos++;
+}
+
+static bool json_consume(JsonCursor &c, char ch)
+{
+    json_skip_ws(c);
+    if (c.pos < c.end && *c.pos == ch)
+    {
+        c.pos++;
+        return true;
+    }
+    return false;
+}
+
+static char json_peek(JsonCursor &c)
+{
+    json_skip_ws(c);
+    return c.pos < c.end ? *c.pos : '\0';
+}
+
+// Reads a string token and returns a view of its raw (still escaped) bytes.
+static bool json_read_raw_string(JsonCursor &c, const char **start, size_t *len, bool *has_escape)
+{
+    if (!json_consume(c, '"'))
+        return false;
+
+    const char *s = c.pos;
+    bool escaped = false;
+    while (c.pos < c.end && *c.pos != '"')
+    {
+        if (*c.pos == '\\')
+        {
+            escaped = true;
+            c.pos++;
+            if (c.pos >= c.end)
+                return false;
+        }
+        c.pos++;
+    }
+    if (c.pos >= c.end)
+        return false;
+
+    *start = s;
+    *len = (size_t)(c.pos - s);
+    if (has_escape)
+        *has_escape = escaped;
+    c.pos++; // Closing quote
+    return true;
+}
+
+static int json_hex4(const char *p)
+{
+    int v = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        char ch = p[i];
+        v <<= 4;
+        if (ch >= '0' && ch <= '9')
+            v |= ch - '0';
+        else if (ch >= 'a' && ch <= 'f')
+            v |= ch - 'a' + 10;
+        else if (ch >= 'A' && ch <= 'F')
+            v |= ch - 'A' + 10;
+        else
+            return -1;
+    }
+    return v;
+}
+
+// Appends the unescaped form of a raw JSON string body to `out`,
+// including \uXXXX escapes and UTF-16 surrogate pairs.
+static void json_unescape_append(const char *s, size_t len, std::string &out)
+{
+    const char *p = s;
+    const char *end = s + len;
+    while (p < end)
+    {
+        const char *run = p;
+        while (p < end && *p != '\\')
+            p++;
+        out.append(run, (size_t)(p - run));
+        if (p >= end)
+            break;
+
+        p++; // Backslash
+        if (p >= end)
+            break;
+        char esc = *p++;
+        switch (esc)
+        {
+        case 'b':
+            out += '\b';
+            break;
+        case 'f':
+            out += '\f';
+            break;
+        case 'n':
+            out += '\n';
+            break;
+        case 'r':
+            out += '\r';
+            break;
+        case 't':
+            out += '\t';
+            break;
+        case 'u':
+        {
+            if (end - p < 4)
+                return;
+            int cp = json_hex4(p);
+            p += 4;
+            if (cp < 0)
+                break;
+            if (cp >= 0xD800 && cp <= 0xDBFF && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+            {
+                int lo = json_hex4(p + 2);
+                if (lo >= 0xDC00 && lo <= 0xDFFF)
+                {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    p += 6;
+                }
+            }
+            if (cp >= 0xD800 && cp <= 0xDFFF)
+                cp = 0xFFFD; // Unpaired surrogate
+            char utf8[8];
+            int n = g_unichar_to_utf8((gunichar)cp, utf8);
+            out.append(utf8, n);
+            break;
+        }
+        default:
+            // \" \\ \/ and anything unknown map to the character itself
+            out += esc;
+            break;
+        }
+    }
+}
+
+// Reads a number, or a string holding a number (WAQI quotes some of them).
+// Returns false without consuming anything if the value is neither.
+static bool json_read_number(JsonCursor &c, double *out)
+{
+    char tmp[64];
+    size_t n = 0;
+    JsonCursor save = c;
+
+    if (json_peek(c) == '"')
+    {
+        const char *s;
+        size_t len;
+        if (!json_read_raw_string(c, &s, &len, NULL) || len == 0 || len >= sizeof(tmp))
+        {
+            c = save;
+            return false;
+        }
+        memcpy(tmp, s, len);
+        n = len;
+    }
+    else
+    {
+        while (c.pos < c.end && n < sizeof(tmp) - 1 &&
+               ((*c.pos >= '0' && *c.pos <= '9') || *c.pos == '-' || *c.pos == '+' ||
+                *c.pos == '.' || *c.pos == 'e' || *c.pos == 'E'))
+            tmp[n++] = *c.pos++;
+    }
+    tmp[n] = '\0';
+
+    char *num_end = NULL;
+    double v = g_ascii_strtod(tmp, &num_end);
+    if (n == 0 || num_end == tmp)
+    {
+        c = save;
+        return false;
+    }
+    *out = v;
+    return true;
+}
+
+// Skips one complete value of any type.
+static bool json_skip_value(JsonCursor &c)
+{
+    char first = json_peek(c);
+    if (first == '"')
+    {
+        const char *s;
+        size_t len;
+        return json_read_raw_string(c, &s, &len, NULL);
+    }
+    if (first == '{' || first == '[')
+    {
+        int depth = 0;
+        while (c.pos < c.end)
+        {
+            char ch = *c.pos;
+            if (ch == '"')
+            {
+                const char *s;
+                size_t len;
+                if (!json_read_raw_string(c, &s, &len, NULL))
+                    return false;
+                continue;
+            }
+            c.pos++;
+            if (ch == '{' || ch == '[')
+                depth++;
+            else if (ch == '}' || ch == ']')
+            {
+                if (--depth == 0)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // Number, true, false or null
+    const char *start = c.pos;
+    while (c.pos < c.end && *c.pos != ',' && *c.pos != '}' && *c.pos != ']' &&
+           *c.pos != ' ' && *c.pos != '\t' && *c.pos != '\n' && *c.pos != '\r')
+        c.pos++;
+    return c.pos > start;
+}
+
+// Reads `"key":` and leaves the cursor on the value. Keys are compared raw;
+// none of the keys we look for contain escapes.
+static bool json_read_key(JsonCursor &c, const char **key, size_t *key_len)
+{
+    if (!json_read_raw_string(c, key, key_len, NULL))
+        return false;
+    return json_consume(c, ':');
+}
+
+static bool json_key_is(const char *key, size_t key_len, const char *name)
+{
+    size_t n = strlen(name);
+    return key_len == n && memcmp(key, name, n) == 0;
+}
+
+// Iterates the members of an object. Call with the cursor just before '{';
+// each call yields the next key, or returns false at the closing brace.
+// Malformed input also returns false and sets c.failed. The caller must
+// consume or skip every value.
+static bool json_next_member(JsonCursor &c, bool *first, const char **key, size_t *key_len)
+{
+    if (*first)
+    {
+        *first = false;
+        if (!json_consume(c, '{'))
+        {
+            c.failed = true;
+            return false;
+        }
+        if (json_consume(c, '}'))
+            return false;
+    }
+    else
+    {
+        if (json_consume(c, '}'))
+            return false;
+        if (!json_consume(c, ','))
+        {
+            c.failed = true;
+            return false;
+        }
+    }
+    if (!json_read_key(c, key, key_len))
+    {
+        c.failed = true;
+        return false;
+    }
+    return true;
+}
+
+// Same as json_next_member for arrays: returns true while there is another
+// element to read.
+static bool json_next_element(JsonCursor &c, bool *first)
+{
+    if (*first)
+    {
+        *first = false;
+        if (!json_consume(c, '['))
+        {
+            c.failed = true;
+            return false;
+        }
+        return !json_consume(c, ']');
+    }
+    if (json_consume(c, ']'))
+        return false;
+    if (!json_consume(c, ','))
+    {
+        c.failed = true;
+        return false;
+    }
+    return true;
+}
+
+// --- WAQI Search Response Parser ---
+
+// Stands in for absent fields, so result strings are never NULL
+static const char empty_string[] = "";
+
+WAQISearchBatch *waqi_search_batch_new(gsize string_space)
+{
+    WAQISearchBatch *batch = new WAQISearchBatch();
+    batch->ref_count = 1;
+    batch->strings = g_string_chunk_new(std::max(string_space, (gsize)256));
+    return batch;
+}
+
+WAQISearchBatch *waqi_search_batch_ref(WAQISearchBatch *batch)
+{
+    g_atomic_int_inc(&batch->ref_count);
+    return batch;
+}
+
+void waqi_search_batch_unref(WAQISearchBatch *batch)
+{
+    if (!batch || !g_atomic_int_dec_and_test(&batch->ref_count))
+        return;
+    g_string_chunk_free(batch->strings);
+    delete batch;
+}
+
+const char *waqi_search_batch_intern(WAQISearchBatch *batch, const char *s, size_t len)
+{
+    if (len == 0)
+        return empty_string;
+    return g_string_chunk_insert_len(batch->strings, s, (gssize)len);
+}
+
+void waqi_search_batch_append(WAQISearchBatch *batch, const WAQISearchResult &result)
+{
+    WAQISearchResult copy = result;
+    copy.station_id = waqi_search_batch_intern(batch, result.station_id, strlen(result.station_id));
+    copy.station_name = waqi_search_batch_intern(batch, result.station_name, strlen(result.station_name));
+    copy.full_address = waqi_search_batch_intern(batch, result.full_address, strlen(result.full_address));
+    copy.url = waqi_search_batch_intern(batch, result.url, strlen(result.url));
+    copy.country = waqi_search_batch_intern(batch, result.country, strlen(result.country));
+    copy.source = waqi_search_batch_intern(batch, result.source, strlen(result.source));
+    batch->results.push_back(copy);
+}
+
+typedef struct
+{
+    WAQISearchBatch *batch;
+    std::string scratch; // Unescaping and address joining, reused across results
+} SearchParse;
+
+// Reads a string into the batch. Strings without escapes are copied
+// straight from the payload; only escaped ones go through the scratch.
+static bool search_read_string(JsonCursor &c, SearchParse &parse, const char **out)
+{
+    const char *s;
+    size_t len;
+    bool has_escape;
+    if (!json_read_raw_string(c, &s, &len, &has_escape))
+        return false;
+    if (has_escape)
+    {
+        parse.scratch.clear();
+        json_unescape_append(s, len, parse.scratch);
+        s = parse.scratch.data();
+        len = parse.scratch.size();
+    }
+    *out = waqi_search_batch_intern(parse.batch, s, len);
+    return true;
+}
+
+// Parses the station sub-object: {"a":"<aqi>","n":["<name>",...],"u":"<url>", ...}
+static bool waqi_parse_search_station(JsonCursor &c, SearchParse &parse, WAQISearchResult &result,
+                                      const char **country, const char **source)
+{
+    const char *key;
+    size_t key_len;
+    bool first = true;
+    while (json_next_member(c, &first, &key, &key_len))
+    {
+        char value_type = json_peek(c);
+        bool ok = true;
+        if (json_key_is(key, key_len, "a"))
+        {
+            // "-" (or anything non-numeric) means the station has no reading
+            double aqi = 0.0;
+            if (json_read_number(c, &aqi))
+            {
+                result.aqi = (int)aqi;
+                result.has_aqi = aqi >= 0.0;
+            }
+            else
+                ok = json_skip_value(c);
+        }
+        else if (json_key_is(key, key_len, "n") && value_type == '[')
+        {
+            bool first_el = true;
+            while (ok && json_next_element(c, &first_el))
+            {
+                if (!*result.station_name && json_peek(c) == '"')
+                    ok = search_read_string(c, parse, &result.station_name);
+                else
+                    ok = json_skip_value(c);
+            }
+        }
+        else if (json_key_is(key, key_len, "u") && value_type == '"')
+            ok = search_read_string(c, parse, &result.url);
+        else if (json_key_is(key, key_len, "c") && value_type == '"')
+            ok = search_read_string(c, parse, country);
+        else if (json_key_is(key, key_len, "$") && value_type == '"')
+            ok = search_read_string(c, parse, source);
+        else
+            ok = json_skip_value(c);
+
+        if (!ok)
+            return false;
+    }
+    return !c.failed;
+}
+
+// Joins the non-empty address parts with " > " in the scratch buffer
+static bool waqi_parse_search_address(JsonCursor &c, SearchParse &parse, const char **address)
+{
+    std::string &joined = parse.scratch;
+    joined.clear();
+    bool first = true;
+    while (json_next_element(c, &first))
+    {
+        if (json_peek(c) == '"')
+        {
+            const char *s;
+            size_t len;
+            bool has_escape;
+            if (!json_read_raw_string(c, &s, &len, &has_escape))
+                return false;
+            if (len == 0)
+                continue;
+            if (!joined.empty())
+                joined += " > ";
+            if (has_escape)
+                json_unescape_append(s, len, joined);
+            else
+                joined.append(s, len);
+        }
+        else if (!json_skip_value(c))
+            return false;
+    }
+    if (c.failed)
+        return false;
+    *address = waqi_search_batch_intern(parse.batch, joined.data(), joined.size());
+    return true;
+}
+
+// Parses one entry of "results". Returns false if the object was malformed
+// and the cursor did not end up on its closing brace.
+static bool waqi_parse_search_result(JsonCursor &c, SearchParse &parse)
+{
+    WAQISearchResult result = {empty_string, empty_string, empty_string, empty_string, empty_string,
+                               empty_string, 0, false};
+
+    // "c" and "$" may sit on the result itself or on its station object;
+    // the top-level value wins.
+    const char *station_country = empty_string;
+    const char *station_source = empty_string;
+    long x_val = 0;
+
+    const char *key;
+    size_t key_len;
+    bool first = true;
+    while (json_next_member(c, &first, &key, &key_len))
+    {
+        char value_type = json_peek(c);
+        bool ok = true;
+        if (json_key_is(key, key_len, "s") && value_type == '{')
+            ok = waqi_parse_search_station(c, parse, result, &station_country, &station_source);
+        else if (json_key_is(key, key_len, "n") && value_type == '[')
+            ok = waqi_parse_search_address(c, parse, &result.full_address);
+        else if (json_key_is(key, key_len, "x"))
+        {
+            double x = 0.0;
+            if (json_read_number(c, &x))
+                x_val = (long)x;
+            else
+                ok = json_skip_value(c);
+        }
+        else if (json_key_is(key, key_len, "c") && value_type == '"')
+            ok = search_read_string(c, parse, &result.country);
+        else if (json_key_is(key, key_len, "$") && value_type == '"')
+            ok = search_read_string(c, parse, &result.source);
+        else
+            ok = json_skip_value(c);
+
+        if (!ok)
+            return false;
+    }
+    if (c.failed)
+        return false;
+
+    if (!*result.country)
+        result.country = station_country;
+    if (!*result.source)
+        result.source = station_source;
+
+    // The id is the tail of the url, which is already in the batch
+    const char *at = strchr(result.url, '@');
+    if (at)
+        result.station_id = at + 1;
+    else if (x_val != 0)
+    {
+        char id[32];
+        int n = snprintf(id, sizeof(id), "%ld", x_val > 0 ? x_val : -x_val);
+        result.station_id = waqi_search_batch_intern(parse.batch, id, (size_t)n);
+    }
+    else
+        result.station_id = result.url;
+
+    if (*result.station_id && *result.station_name)
+        parse.batch->results.push_back(result);
+    return true;
+}
+
+WAQISearchBatch *waqi_parse_search_response(const char *data, gsize size)
+{
+    TRACE_SPAN("waqi_parse_search_response");
+
+    // Decoded strings are never longer than their encoded form, so one
+    // chunk of about the response size holds all of them
+    SearchParse parse;
+    parse.batch = waqi_search_batch_new(size + 256);
+    if (!data || size == 0)
+        return parse.batch;
+
+    JsonCursor c = {data, data + size, false};
+    const char *key;
+    size_t key_len;
+    bool first = true;
+    while (json_next_member(c, &first, &key, &key_len))
+    {
+        if (!json_key_is(key, key_len, "results") || json_peek(c) != '[')
+        {
+            if (!json_skip_value(c))
+                break;
+            continue;
+        }
+
+        bool first_el = true;
+        while (json_next_element(c, &first_el))
+        {
+            if (json_peek(c) != '{')
+            {
+                if (!json_skip_value(c))
+                    break;
+                continue;
+            }
+
+            JsonCursor obj = c;
+            if (!waqi_parse_search_result(c, parse))
+            {
+                c = obj;
+                if (!json_skip_value(c))
+                    break;
+            }
+            if (c.failed)
+                break;
+        }
+        break;
+    }
+    return parse.batch;
+}
+
+// --- SSE Framing ---
+
+void sse_framer_init(SseFramer *f, SseEventFunc on_event, gpointer user_data)
+{
+    memset(f, 0, sizeof(*f));
+    f->on_event = on_event;
+    f->user_data = user_data;
+}
+
+// Drops buffered bytes for a new connection but keeps the allocation and
+// the last event id / retry time, which carry over to a reconnect.
+void sse_framer_reset(SseFramer *f)
+{
+    f->len = f->start = f->line = f->scan = 0;
+    f->bom_checked = false;
+    f->discarding = false;
+}
+
+// Drops the event being assembled and switches to discarding the rest of
+// it. Only an unscanned trailing '\r' is kept, since it may pair with a
+// '\n' of the next chunk.
+static void sse_framer_start_discard(SseFramer *f)
+{
+    f->discarding = true;
+    f->discard_line_empty = f->line == f->scan;
+    memmove(f->data, f->data + f->scan, f->len - f->scan);
+    f->len -= f->scan;
+    f->start = f->line = f->scan = 0;
+}
+
+// Skips bytes of a discarded event up to and including the blank line that
+// ends it. Returns true with the remaining bytes moved to the front of the
+// buffer once that line is found, false if everything was dropped.
+static bool sse_framer_skip_discarded(SseFramer *f)
+{
+    char *base = f->data;
+    char *lim = base + f->len;
+    char *p = base;
+
+    while (p < lim)
+    {
+        // Only line terminators matter here
+        char *nl = (char *)memchr(p, '\n', lim - p);
+        char *cr = (char *)memchr(p, '\r', (nl ? nl : lim) - p);
+        char *t = cr ? cr : nl;
+        if (!t)
+        {
+            f->discard_line_empty = false;
+            p = lim;
+            break;
+        }
+        if (t > p)
+            f->discard_line_empty = false;
+
+        if (*t == '\r')
+        {
+            if (t + 1 >= lim)
+            {
+                p = t; // Wait to see whether a '\n' follows
+                break;
+            }
+            if (t[1] == '\n')
+                t++;
+        }
+        p = t + 1;
+
+        if (f->discard_line_empty)
+        {
+            f->discarding = false;
+            break;
+        }
+        f->discard_line_empty = true;
+    }
+
+    memmove(base, p, lim - p);
+    f->len = lim - p;
+    f->start = f->line = f->scan = 0;
+    return !f->discarding;
+}
+
+// Returns the free tail to read the next chunk into, compacting consumed
+// bytes away or growing the buffer first if less than SSE_MIN_READ is left.
+char *sse_framer_reserve(SseFramer *f, size_t *avail)
+{
+    if (f->capacity - f->len < SSE_MIN_READ && f->start > 0)
+    {
+        memmove(f->data, f->data + f->start, f->len - f->start);
+        f->len -= f->start;
+        f->line -= f->start;
+        f->scan -= f->start;
+        f->start = 0;
+    }
+
+    if (f->capacity - f->len < SSE_MIN_READ)
+    {
+        size_t new_capacity = f->capacity ? f->capacity * 2 : SSE_INITIAL_CAPACITY;
+        if (new_capacity > SSE_MAX_EVENT_SIZE)
+        {
+            g_printerr("SSE event exceeds %d bytes, dropping it\n", SSE_MAX_EVENT_SIZE);
+            sse_framer_start_discard(f);
+        }
+        else
+        {
+            f->data = (char *)g_realloc(f->data, new_capacity);
+            f->capacity = new_capacity;
+        }
+    }
+
+    *avail = f->capacity - f->len;
+    return f->data + f->len;
+}
+
+// Decodes the fields of one complete event in [p, end). Data lines are
+// joined with '\n' by compacting them towards the start of the event, so
+// the payload passed to on_event is NUL-terminated and lives in the buffer.
+static void sse_framer_dispatch(SseFramer *f, char *p, char *end)
+{
+    char *data_start = p;
+    char *data_end = p;
+    bool has_data = false;
+
+    while (p < end)
+    {
+        char *line = p;
+        while (p < end && *p != '\n' && *p != '\r')
+            p++;
+        char *line_end = p;
+        if (p < end && *p == '\r')
+            p++;
+        if (p < end && *p == '\n')
+            p++;
+
+        if (line == line_end || *line == ':')
+            continue; // Comment / keep-alive
+
+        char *colon = (char *)memchr(line, ':', line_end - line);
+        char *name_end = colon ? colon : line_end;
+        char *value = colon ? colon + 1 : line_end;
+        if (value < line_end && *value == ' ')
+            value++;
+        size_t name_len = name_end - line;
+        size_t value_len = line_end - value;
+
+        if (name_len == 4 && memcmp(line, "data", 4) == 0)
+        {
+            memmove(data_end, value, value_len);
+            data_end += value_len;
+            *data_end++ = '\n';
+            has_data = true;
+        }
+        else if (name_len == 2 && memcmp(line, "id", 2) == 0)
+        {
+            if (!memchr(value, '\0', value_len) && value_len < sizeof(f->last_event_id))
+            {
+                memcpy(f->last_event_id, value, value_len);
+                f->last_event_id[value_len] = '\0';
+            }
+        }
+        else if (name_len == 5 && memcmp(line, "retry", 5) == 0)
+        {
+            guint retry = 0;
+            size_t i = 0;
+            while (i < value_len && value[i] >= '0' && value[i] <= '9')
+                retry = retry * 10 + (value[i++] - '0');
+            if (i == value_len && value_len > 0)
+                f->retry_ms = retry;
+        }
+        // "event" is ignored: WAQI carries the event type inside the JSON.
+    }
+
+    if (!has_data)
+        return;
+
+    data_end--; // Trailing '\n'
+    *data_end = '\0';
+    if (f->on_event && data_end > data_start)
+        f->on_event(data_start, data_end - data_start, f->user_data);
+}
+
+// Accounts for `n` bytes just read into the reserved tail and dispatches
+// every event they complete. Accepts \n, \r\n and \r line endings.
+void sse_framer_feed(SseFramer *f, size_t n)
+{
+    TRACE_SPAN("sse_framer_feed");
+    f->len += n;
+
+    if (f->discarding && !sse_framer_skip_discarded(f))
+        return;
+
+    if (!f->bom_checked && f->len >= 3)
+    {
+        f->bom_checked = true;
+        if (memcmp(f->data, "\xEF\xBB\xBF", 3) == 0)
+            f->start = f->line = f->scan = 3;
+    }
+
+    char *base = f->data;
+    char *lim = base + f->len;
+    char *p = base + f->scan;
+
+    while (p < lim)
+    {
+        if (*p != '\n' && *p != '\r')
+        {
+            p++;
+            continue;
+        }
+
+        char *line_end = p;
+        if (*p == '\r')
+        {
+            if (p + 1 >= lim)
+                break; // Wait to see whether a '\n' follows
+            if (p[1] == '\n')
+                p++;
+        }
+        p++;
+
+        if (line_end == base + f->line)
+        {
+            // A blank line terminates the event
+            sse_framer_dispatch(f, base + f->start, line_end);
+            f->start = p - base;
+        }
+        f->line = p - base;
+    }
+
+    f->scan = p - base;
+}
+
+// --- WAQI Feed Decoding ---
+
+int calculate_aqi_from_pm25(double pm)
+{
+    if (pm <= 0.0)
+        return 0;
+    if (pm <= 12.0)
+        return (int)(pm * 50.0 / 12.0);
+    if (pm <= 35.4)
+        return (int)(50 + (pm - 12.0) * 50.0 / 23.4);
+    if (pm <= 55.4)
+        return (int)(100 + (pm - 35.4) * 50.0 / 20.0);
+    if (pm <= 150.4)
+        return (int)(150 + (pm - 55.4) * 50.0 / 95.0);
+    if (pm <= 250.4)
+        return (int)(200 + (pm - 150.4) * 100.0 / 100.0);
+    if (pm <= 350.4)
+        return (int)(300 + (pm - 250.4) * 100.0 / 100.0);
+    return (int)(400 + (pm - 350.4) * 100.0 / 150.0);
+}
+
+// Reads the "t" of an hour object: epoch seconds, or an ISO 8601 date,
+// taken as UTC without an offset. Returns the start of its hour, or 0.
+static guint32 parse_hourly_time(const char *v, const char *end)
+{
+    if (v < end && *v == '"')
+    {
+        const char *close = (const char *)memchr(v + 1, '"', (size_t)(end - v - 1));
+        char text[48];
+        size_t n = close ? (size_t)(close - v - 1) : 0;
+        if (n == 0 || n >= sizeof(text))
+            return 0;
+        memcpy(text, v + 1, n);
+        text[n] = '\0';
+
+        GTimeZone *utc = g_time_zone_new_utc();
+        GDateTime *dt = g_date_time_new_from_iso8601(text, utc);
+        g_time_zone_unref(utc);
+        if (!dt)
+            return 0;
+        gint64 seconds = g_date_time_to_unix(dt);
+        g_date_time_unref(dt);
+        return seconds > 0 && seconds <= G_MAXUINT32 ? (guint32)(seconds / 3600 * 3600) : 0;
+    }
+    // Any fraction is dropped with the rest of the hour. Epoch seconds have
+    // ten digits, so the first eight are converted in one go.
+    guint64 seconds = 0;
+    if (end - v >= 8)
+    {
+        guint64 w;
+        memcpy(&w, v, sizeof(w));
+        w = GUINT64_FROM_LE(w);
+        if (((w & 0xf0f0f0f0f0f0f0f0ULL) | (((w + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL) >> 4)) ==
+            0x3333333333333333ULL)
+        {
+            w -= 0x3030303030303030ULL;
+            w = w * 10 + (w >> 8);
+            seconds = ((w & 0x000000ff000000ffULL) * (100 + (1000000ULL << 32)) +
+                       ((w >> 16) & 0x000000ff000000ffULL) * (1 + (10000ULL << 32))) >>
+                      32;
+            v += 8;
+        }
+    }
+    for (; v < end && *v >= '0' && *v <= '9' && seconds <= G_MAXUINT32; v++)
+        seconds = seconds * 10 + (guint64)(*v - '0');
+    return seconds > 0 && seconds <= G_MAXUINT32 ? (guint32)(seconds / 3600 * 3600) : 0;
+}
+
+// Reads up to WAQI_HOURLY_MAX hourly means from the `[{...}, ...]` array of
+// one pollutant in an `hourly` event, each with the hour of its object's
+// "t". Returns the end of the array. The array is walked by the structural
+// index, stopping only at brackets and at strings that open like "mean" or
+// "t" and are as long, which are then matched as keys where they stand.
+static const char *parse_hourly_means(const char *array, const char *end, HistoryRecord *out, size_t *n_out)
+{
+    static const char mean_key[] = "\"mean\":";
+    static const char time_key[] = "\"t\":";
+    size_t n = 0;
+    int depth = 0;
+    const char *p = end;
+    guint32 entry_time = 0;   // "t" of the current hour object
+    bool entry_mean = false;  // The current hour object's mean is out[n - 1]
+    bool timed = true;        // Every closed hour object with a mean had a "t"
+
+    json_for_each_block(array, end, "mt", [&](const JsonBlock &b) {
+        // The shifts drop what lies past the block, so candidates near its
+        // end are kept and left to the comparisons
+        guint64 means = b.strings & ((b.marks[0] >> 1) | (guint64)1 << 63) & ((b.quotes >> 5) | ~(guint64)0 << 59);
+        guint64 times = b.strings & ((b.marks[1] >> 1) | (guint64)1 << 63) & ((b.quotes >> 2) | ~(guint64)0 << 62);
+        for (guint64 events = b.open | b.close | means | times; events; events &= events - 1)
+        {
+            int i = __builtin_ctzll(events);
+            const char *at = b.base + i;
+            if ((b.open >> i) & 1)
+            {
+                // Hour objects sit at depth 2
+                if (++depth == 2)
+                {
+                    entry_time = 0;
+                    entry_mean = false;
+                }
+            }
+            else if ((b.close >> i) & 1)
+            {
+                if (depth == 2 && entry_mean)
+                {
+                    out[n - 1].time = entry_time;
+                    timed = timed && entry_time != 0;
+                }
+                if (--depth == 0)
+                {
+                    p = at + 1;
+                    return false;
+                }
+            }
+            else if (depth != 2)
+            {
+                continue;
+            }
+            else if (((means >> i) & 1) && n < WAQI_HOURLY_MAX && (size_t)(end - at) > sizeof(mean_key) - 1 &&
+                     memcmp(at, mean_key, sizeof(mean_key) - 1) == 0)
+            {
+                out[n].time = 0;
+                out[n].value = (float)json_parse_double(at + sizeof(mean_key) - 1, end);
+                n++;
+                entry_mean = true;
+            }
+            else if (((times >> i) & 1) && (size_t)(end - at) > sizeof(time_key) - 1 &&
+                     memcmp(at, time_key, sizeof(time_key) - 1) == 0)
+            {
+                entry_time = parse_hourly_time(at + sizeof(time_key) - 1, end);
+            }
+        }
+        return true;
+    });
+
+    // An unterminated last object leaves its time unknown
+    if (n > 0 && depth >= 2 && entry_mean)
+        timed = false;
+
+    if (timed)
+    {
+        // Kept oldest first whatever order the feed lists the hours in;
+        // they come in order, so this is one pass
+        for (size_t i = 1; i < n; i++)
+        {
+            HistoryRecord r = out[i];
+            size_t j = i;
+            for (; j > 0 && out[j - 1].time > r.time; j--)
+                out[j] = out[j - 1];
+            out[j] = r;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < n; i++)
+            out[i].time = 0;
+    }
+    *n_out = n;
+    return p;
+}
+
+// Members waqi_decode_event reads, found in one pass over the event by
+// sse_event_scan. Positions point at the value and are NULL when the event
+// lacks the member.
+typedef struct
+{
+    const char *type;  // "type":"...
+    const char *name;  // "name":"...
+    const char *geo;   // "geo":[...
+    const char *feed;  // "feed":{...
+    const char *data;  // "data":{...
+    const char *pollutants[N_POLLUTANT_FIELDS]; // "<key>":[...
+    guint hourly_read; // Bit i set once the means of pollutant_fields[i] are read
+    // Members of the last entry of "x":[{...}, ...] with a "t", which are
+    // a cwop event's latest readings
+    const char *cwop_t, *cwop_dew, *cwop_w, *cwop_wd;
+} SseEventFields;
+
+static constexpr guint pollutant_history_mask()
+{
+    guint mask = 0;
+    for (size_t i = 0; i < N_POLLUTANT_FIELDS; i++)
+        mask |= pollutant_fields[i].history ? 1u << i : 0;
+    return mask;
+}
+
+template <size_t N>
+static bool sse_key_is(const char *key, size_t key_len, const char (&name)[N])
+{
+    return key_len == N - 1 && memcmp(key, name, N - 1) == 0;
+}
+
+// Whether the string value at `v` is `name`, reading nothing past `end`
+template <size_t N>
+static bool sse_string_is(const char *v, const char *end, const char (&name)[N])
+{
+    return end - v > (ptrdiff_t)N && memcmp(v + 1, name, N - 1) == 0 && v[N] == '"';
+}
+
+// Steps through the entries of a cwop event's "x" array, noting the
+// members of each object that has a "t" as the fields' cwop readings, so
+// the last such entry's are kept. A "t" that opens its entry is not taken,
+// as it never was. Returns the end of the array.
+static const char *sse_scan_cwop_entries(const char *array, const char *end, SseEventFields &f)
+{
+    const char *p = array + 1;
+    while (p < end)
+    {
+        if (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ',')
+        {
+            p++;
+            continue;
+        }
+        if (*p == ']')
+            return p + 1;
+        const char *entry_end = json_skip_value(p, end);
+        if (*p == '{')
+        {
+            const char *t = NULL, *dew = NULL, *w = NULL, *wd = NULL;
+            bool first = true;
+            json_scan_keys(p + 1, entry_end, [&](const char *key, size_t key_len, const char *v) {
+                if (sse_key_is(key, key_len, "t"))
+                    t = first ? NULL : v;
+                else if (sse_key_is(key, key_len, "dew"))
+                    dew = v;
+                else if (sse_key_is(key, key_len, "w"))
+                    w = v;
+                else if (sse_key_is(key, key_len, "wd"))
+                    wd = v;
+                first = false;
+                // Members of nested values are not the entry's
+                return *v == '"' || *v == '{' || *v == '[' ? json_skip_value(v, entry_end) : v;
+            });
+            if (t)
+            {
+                f.cwop_t = t;
+                f.cwop_dew = dew;
+                f.cwop_w = w;
+                f.cwop_wd = wd;
+            }
+        }
+        p = entry_end > p ? entry_end : p + 1;
+    }
+    return end;
+}
+
+// Keeps the first occurrence of each member, except that a pollutant seen
+// after "feed" replaces one seen before it: `meta` events list the current
+// values inside the feed object. Objects and the pollutants' number pairs
+// are descended into; strings and other arrays are stepped over whole
+// once their position is noted, except the hourly arrays, whose means are
+// read on the way. Each byte of the event is thus looked at once at most,
+// and most are jumped over; an hourly event is left once its last history
+// is read. The entries of a cwop event's "x" array are read the same way.
+static void sse_event_scan(const char *json_data, size_t len, SseEventFields &f, WAQIHourlyMeans *hourly)
+{
+    const char *end = json_data + len;
+    json_scan_keys(json_data, end, [&f, hourly, end](const char *key, size_t key_len, const char *v) {
+        switch (*v)
+        {
+        case '"':
+            if (!f.type && sse_key_is(key, key_len, "type"))
+                f.type = v;
+            else if (!f.name && sse_key_is(key, key_len, "name"))
+                f.name = v;
+            return json_skip_string(v, end);
+        case '{':
+            if (!f.feed && sse_key_is(key, key_len, "feed"))
+                f.feed = v;
+            else if (!f.data && sse_key_is(key, key_len, "data"))
+                f.data = v;
+            return v;
+        case '[':
+            if (!f.geo && sse_key_is(key, key_len, "geo"))
+            {
+                f.geo = v;
+                return json_skip_value(v, end);
+            }
+            if (f.data && v > f.data && sse_key_is(key, key_len, "x"))
+                return sse_scan_cwop_entries(v, end, f);
+            for (size_t i = 0; i < N_POLLUTANT_FIELDS; i++)
+            {
+                const PollutantField &field = pollutant_fields[i];
+                if (key_len != field.key_len || key[0] != field.key[0] || memcmp(key, field.key, key_len) != 0)
+                    continue;
+                if (!f.pollutants[i] || (f.feed && f.pollutants[i] < f.feed))
+                    f.pollutants[i] = v;
+                if (field.history && f.pollutants[i] == v && v[1] == '{')
+                {
+                    const char *next = parse_hourly_means(v, end, hourly->points[i], &hourly->n_points[i]);
+                    // Nothing else in an hourly event is read, so the rest of
+                    // it is left unscanned once every history is in
+                    f.hourly_read |= 1u << i;
+                    if (f.hourly_read == pollutant_history_mask() && f.type && sse_string_is(f.type, end, "hourly"))
+                        return end;
+                    return next;
+                }
+                // Other pollutant values are [time, value] pairs or lists of
+                // them, numbers only, so the scan goes on inside them rather
+                // than looking for their end
+                if (v[1] != '{')
+                    return v + 1;
+                break;
+            }
+            return json_skip_value(v, end);
+        default:
+            return v; // Scalars hold no quote, the next key is found past them
+        }
+    });
+}
+
+// Reads the value of a [time, value, ...] pair, or of the first pair in a
+// list of them, scaled back from the feed's integer encoding
+static bool sse_read_scaled(const char *array, const char *end, const PollutantField &field, double *out)
+{
+    const char *comma = array < end ? (const char *)memchr(array, ',', (size_t)(end - array)) : NULL;
+    if (!comma)
+        return false;
+    *out = json_parse_double(comma + 1, end) / field.scale;
+    return true;
+}
+
+WAQIEventType waqi_decode_event(WAQIStationData &station, const char *json_data, size_t len, WAQIHourlyMeans *hourly)
+{
+    SseEventFields f = {};
+    for (size_t i = 0; i < N_POLLUTANT_FIELDS; i++)
+        hourly->n_points[i] = 0;
+    sse_event_scan(json_data, len, f, hourly);
+    if (!f.type)
+        return WAQI_EVENT_OTHER;
+
+    const char *end = json_data + len;
+
+    if (sse_string_is(f.type, end, "meta"))
+    {
+        if (f.name)
+            station.station_name = json_parse_string(f.name, end);
+
+        if (f.geo)
+        {
+            const char *geo_pos = f.geo + 1;
+            station.latitude = json_parse_double(geo_pos, end);
+            const char *comma = geo_pos < end ? (const char *)memchr(geo_pos, ',', (size_t)(end - geo_pos)) : NULL;
+            if (comma)
+                station.longitude = json_parse_double(comma + 1, end);
+        }
+
+        if (f.feed)
+        {
+            for (size_t i = 0; i < N_POLLUTANT_FIELDS; i++)
+            {
+                const char *array = f.pollutants[i];
+                if (array && array > f.feed)
+                    sse_read_scaled(array + 1, end, pollutant_fields[i], &(station.*pollutant_fields[i].value));
+            }
+        }
+
+        if (station.pm25 > 0)
+        {
+            station.aqi = calculate_aqi_from_pm25(station.pm25);
+        }
+
+        station.has_data = true;
+        return WAQI_EVENT_META;
+    }
+    else if (sse_string_is(f.type, end, "instant"))
+    {
+        for (size_t i = 0; i < N_POLLUTANT_FIELDS; i++)
+        {
+            const PollutantField &field = pollutant_fields[i];
+            const char *array = f.pollutants[i];
+            double value;
+            if (!array || end - array < 2 || array[1] != '[' || !sse_read_scaled(array + 2, end, field, &value))
+                continue;
+            if (field.drives_aqi && value != station.*field.value)
+                station.aqi = calculate_aqi_from_pm25(value);
+            station.*field.value = value;
+        }
+        return WAQI_EVENT_INSTANT;
+    }
+    else if (sse_string_is(f.type, end, "cwop"))
+    {
+        if (f.cwop_t)
+        {
+            station.temperature = json_parse_double(f.cwop_t, end);
+
+            if (f.cwop_dew)
+            {
+                double dew = json_parse_double(f.cwop_dew, end);
+                double t = station.temperature;
+                double dew_denom = 243.04 + dew;
+                double t_denom = 243.04 + t;
+                if (fabs(dew_denom) > 0.01 && fabs(t_denom) > 0.01)
+                {
+                    double alpha_dew = (17.625 * dew) / dew_denom;
+                    double alpha_t = (17.625 * t) / t_denom;
+                    station.humidity = 100.0 * exp(alpha_dew - alpha_t);
+                    if (station.humidity > 100)
+                        station.humidity = 100;
+                    if (station.humidity < 0)
+                        station.humidity = 0;
+                }
+            }
+
+            if (f.cwop_w)
+            {
+                station.wind_speed = json_parse_double(f.cwop_w, end);
+            }
+
+            if (f.cwop_wd)
+            {
+                station.wind_direction = json_parse_int(f.cwop_wd, end);
+            }
+        }
+        return WAQI_EVENT_CWOP;
+    }
+    else if (sse_string_is(f.type, end, "hourly"))
+    {
+        return WAQI_EVENT_HOURLY;
+    }
+    return WAQI_EVENT_OTHER;
+}
+
+// --- Chart Geometry ---
+
+double chart_graph_width(int width)
+{
+    return width - 40.0 - 20.0;
+}
+
+ChartGeometry chart_compute_geometry(const std::vector<ChartPoint> &points, size_t n_samples, int width, int height)
+{
+    ChartGeometry geo;
+    geo.margin_x = 40.0;
+    geo.margin_y = 20.0;
+    geo.graph_w = chart_graph_width(width);
+    geo.graph_h = height - 2 * geo.margin_y;
+    geo.step_x = n_samples > 1 ? geo.graph_w / (n_samples - 1) : geo.graph_w;
+
+    // Decimation keeps each column's maximum, so this is the series maximum
+    geo.max_val = 0;
+    for (const ChartPoint &p : points)
+    {
+        if (p.value > geo.max_val)
+            geo.max_val = (int)ceil(p.value);
+    }
+    if (geo.max_val < 100)
+        geo.max_val = 100;
+    return geo;
+}
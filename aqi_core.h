@@ -0,0 +1,638 @@
+// Platform-independent core of the dashboard: tracing, the WAQI search
+// and SSE parsers, time series storage and chart decimation. Nothing here
+// touches GTK or the network, so it builds as a static library that the
+// app links and that can be exercised on its own.
+
+#ifndef AQI_CORE_H
+#define AQI_CORE_H
+
+#include <glib.h>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// --- Tracing ---
+// Hot paths are wrapped in TRACE_SPAN scopes. Each thread records finished
+// spans into its own fixed ring, so recording takes no lock: each slot is
+// a seqlock the owning thread bumps around its write. Readers copy slots
+// without blocking it and drop any that changed while they copied.
+// Rings are registered once per thread and kept for the life of the
+// process. Nothing is recorded while trace_enabled is off; with
+// sysprof-capture available every span is also emitted as a sysprof mark.
+
+typedef struct
+{
+    const char *name; // Static string
+    gint64 start_us;  // Monotonic
+    gint64 duration_us;
+} TraceEvent;
+
+extern std::atomic<bool> trace_enabled;
+
+void trace_record(const char *name, gint64 start_us, gint64 end_us);
+
+// Appends the recorded spans of every thread that started at or after
+// since_us; `tids` receives the recording thread of each.
+void trace_collect(gint64 since_us, std::vector<TraceEvent> &out, std::vector<guint> *tids);
+
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name)
+        : name_(name), start_us_(trace_enabled.load(std::memory_order_relaxed) ? g_get_monotonic_time() : 0)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        if (start_us_)
+            trace_record(name_, start_us_, g_get_monotonic_time());
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *name_;
+    gint64 start_us_;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+// --- JSON Helpers ---
+// Lenient readers for a value at a position found with json_scan_keys.
+// They stop at `end`, so a payload need not be NUL-terminated.
+
+int json_parse_int(const char *pos, const char *end);
+double json_parse_double(const char *pos, const char *end);
+std::string json_parse_string(const char *pos, const char *end, size_t max_len = 256);
+
+const char *json_skip_long_string(const char *p, const char *end);
+
+// Returns the position after the string whose opening quote is at `p`, or
+// `end` if it is not terminated. Keys and most values are a few bytes long
+// and are read inline; longer strings and escapes are crossed with memchr
+// jumps from quote to quote.
+inline const char *json_skip_string(const char *p, const char *end)
+{
+    const char *q = p + 1;
+    for (ptrdiff_t n = std::min<ptrdiff_t>(end - q, 16); n > 0; n--, q++)
+    {
+        if (*q == '"')
+            return q + 1;
+        if (*q == '\\')
+            break;
+    }
+    return json_skip_long_string(p, end);
+}
+
+// Returns the position after the value at `p`: a string, a whole array or
+// object, or a scalar. Short containers are stepped through byte by byte;
+// longer ones are classified 64 bytes at a time into masks of their quotes
+// and brackets, and only the brackets are visited.
+const char *json_skip_value(const char *p, const char *end);
+
+// Calls visit(key, key_len, value) for each object member of [p, end) in
+// document order, in a single forward pass; `value` points at the first
+// non-blank byte after the colon. visit returns where the scan resumes:
+// `value` to descend into it, or json_skip_value(value, end) to step over
+// it. A string value the visitor does not skip is not taken for a key. The
+// key is not unescaped.
+template <typename F>
+void json_scan_keys(const char *p, const char *end, F visit)
+{
+    while (p < end)
+    {
+        // Keys mostly follow a separator directly, but the gaps before
+        // them can be long
+        const char *key = p;
+        while (key < end && key < p + 4 && *key != '"')
+            key++;
+        if (key < end && *key != '"')
+            key = (const char *)memchr(key, '"', (size_t)(end - key));
+        if (!key || key >= end)
+            return;
+        p = json_skip_string(key, end);
+        if (p >= end)
+            return;
+
+        const char *v = p;
+        while (v < end && (*v == ' ' || *v == '\t' || *v == '\n' || *v == '\r'))
+            v++;
+        if (v >= end || *v != ':')
+            continue;
+        v++;
+        while (v < end && (*v == ' ' || *v == '\t' || *v == '\n' || *v == '\r'))
+            v++;
+        p = visit(key + 1, (size_t)(p - 1 - (key + 1)), v);
+    }
+}
+
+// --- WAQI Search Response Parser ---
+
+// Search result item. The strings are NUL-terminated, never NULL, and
+// owned by the WAQISearchBatch the result belongs to.
+typedef struct
+{
+    const char *station_id;
+    const char *station_name;
+    const char *full_address;
+    const char *url;
+    const char *country;
+    const char *source;
+    int aqi;
+    bool has_aqi;
+} WAQISearchResult;
+
+// The results of one search response. Their strings are copied into a
+// single string chunk sized to the response, so parsing a response costs a
+// fixed handful of allocations whatever the number of stations. Whoever
+// shows results (the dropdown rows, the station index) keeps a reference
+// to their batch for as long as it does.
+typedef struct
+{
+    gint ref_count;
+    GStringChunk *strings;
+    std::vector<WAQISearchResult> results;
+} WAQISearchBatch;
+
+WAQISearchBatch *waqi_search_batch_new(gsize string_space);
+WAQISearchBatch *waqi_search_batch_ref(WAQISearchBatch *batch);
+void waqi_search_batch_unref(WAQISearchBatch *batch);
+const char *waqi_search_batch_intern(WAQISearchBatch *batch, const char *s, size_t len);
+
+// Appends a copy of `result` with its strings moved into `batch`
+void waqi_search_batch_append(WAQISearchBatch *batch, const WAQISearchResult &result);
+
+// Single pass over {"results":[{...},...]} that never reads past `size`.
+// A malformed entry is skipped as a whole rather than ending the parse.
+// Always returns a batch, empty if nothing could be parsed.
+WAQISearchBatch *waqi_parse_search_response(const char *data, gsize size);
+
+// --- SSE Framing ---
+// The read buffer doubles as the framing buffer: chunks are read straight
+// into its free tail, complete events are decoded in place and their data
+// is handed on as a view into it. It only reallocates when a single event
+// outgrows the current capacity, so steady-state framing never allocates.
+
+#define SSE_INITIAL_CAPACITY 16384
+#define SSE_MIN_READ 4096
+#define SSE_MAX_EVENT_SIZE (4 * 1024 * 1024)
+
+typedef void (*SseEventFunc)(const char *data, size_t len, gpointer user_data);
+
+typedef struct
+{
+    char *data;
+    size_t capacity;
+    size_t len;   // Bytes of valid data
+    size_t start; // Start of the event being assembled
+    size_t line;  // Start of the line being scanned
+    size_t scan;  // Next byte to examine
+    bool bom_checked;
+
+    // An event outgrew SSE_MAX_EVENT_SIZE: its remaining bytes are dropped
+    // up to the blank line that ends it, then framing resumes
+    bool discarding;
+    bool discard_line_empty; // Nothing but the terminator seen on the current line
+
+    char last_event_id[256];
+    guint retry_ms; // Reconnection time requested by the server, 0 if none
+
+    SseEventFunc on_event;
+    gpointer user_data;
+} SseFramer;
+
+void sse_framer_init(SseFramer *f, SseEventFunc on_event, gpointer user_data);
+
+// Drops buffered bytes for a new connection but keeps the allocation and
+// the last event id / retry time, which carry over to a reconnect.
+void sse_framer_reset(SseFramer *f);
+
+// Returns the free tail to read the next chunk into, compacting consumed
+// bytes away or growing the buffer first if less than SSE_MIN_READ is left.
+// An event that would need more than SSE_MAX_EVENT_SIZE is dropped whole.
+char *sse_framer_reserve(SseFramer *f, size_t *avail);
+
+// Accounts for `n` bytes just read into the reserved tail and dispatches
+// every event they complete. Accepts \n, \r\n and \r line endings.
+void sse_framer_feed(SseFramer *f, size_t n);
+
+// --- WAQI Feed Decoding ---
+// Decodes the JSON events of a station's SSE feed (meta, instant, cwop and
+// hourly) into a WAQIStationData in one forward scan per event. It keeps
+// no state and touches no globals, so the decode pool runs it on any
+// thread; storing the hourly means is left to the caller.
+
+// Extended data from WAQI feed
+typedef struct
+{
+    std::string station_id;
+    std::string station_name;
+    std::string station_url;
+    std::string attribution;
+    double latitude;
+    double longitude;
+
+    // Current values (scaled from raw * 100)
+    int aqi;
+    double pm25;
+    double pm10;
+    double o3;
+    double no2;
+    double co;
+    double so2;
+
+    // Weather data
+    double temperature;
+    double humidity;
+    double wind_speed;
+    int wind_direction;
+
+    // Hourly history (last 24 hours)
+    std::vector<double> pm25_history;
+    std::vector<double> pm10_history;
+    std::vector<double> o3_history;
+    std::vector<double> no2_history;
+
+    bool has_data;
+    bool stale; // Last-known values from the snapshot cache, feed not yet heard from
+} WAQIStationData;
+
+// One row per pollutant of the SSE feed; decoding, history loading and the
+// charted series all iterate this table, so a new pollutant is a row here
+// plus its WAQIStationData members.
+typedef struct
+{
+    const char *key; // JSON key in the feed
+    size_t key_len;
+    double scale;        // The feed sends instant and meta values multiplied by this
+    bool drives_aqi;     // The AQI is derived from this pollutant
+    const char *history; // History store series, NULL if the feed has no hourly means
+    double WAQIStationData::*value;
+    std::vector<double> WAQIStationData::*series;
+} PollutantField;
+
+static constexpr PollutantField pollutant_fields[] = {
+    {"pm25", 4, 100.0, true, "pm25", &WAQIStationData::pm25, &WAQIStationData::pm25_history},
+    {"pm10", 4, 100.0, false, "pm10", &WAQIStationData::pm10, &WAQIStationData::pm10_history},
+    {"o3", 2, 100.0, false, "o3", &WAQIStationData::o3, &WAQIStationData::o3_history},
+    {"no2", 3, 100.0, false, "no2", &WAQIStationData::no2, &WAQIStationData::no2_history},
+    {"co", 2, 100.0, false, NULL, &WAQIStationData::co, NULL},
+    {"so2", 3, 100.0, false, NULL, &WAQIStationData::so2, NULL},
+};
+
+#define N_POLLUTANT_FIELDS G_N_ELEMENTS(pollutant_fields)
+
+static constexpr bool pollutant_fields_valid()
+{
+    for (const PollutantField &f : pollutant_fields)
+    {
+        size_t n = 0;
+        while (f.key[n])
+            n++;
+        if (n != f.key_len || (f.history == NULL) != (f.series == NULL))
+            return false;
+    }
+    return true;
+}
+static_assert(pollutant_fields_valid(), "pollutant_fields: key_len must match key, history needs a series");
+
+int calculate_aqi_from_pm25(double pm);
+
+typedef struct
+{
+    guint32 time; // Unix seconds, start of the hour
+    float value;
+} HistoryRecord;
+
+#define WAQI_HOURLY_MAX 24 // Hourly means read per pollutant and event
+
+typedef enum
+{
+    WAQI_EVENT_OTHER,
+    WAQI_EVENT_META,
+    WAQI_EVENT_INSTANT,
+    WAQI_EVENT_CWOP,
+    WAQI_EVENT_HOURLY,
+} WAQIEventType;
+
+// The means of an `hourly` event, oldest first, for the pollutants with a
+// history series. Each point has the hour of its entry's own "t", epoch
+// seconds or an ISO 8601 date; when any entry of a pollutant lacks one, all
+// of its times are 0 and placing them is left to the caller. Fixed-size, so
+// decoding an event does not allocate.
+typedef struct
+{
+    HistoryRecord points[N_POLLUTANT_FIELDS][WAQI_HOURLY_MAX];
+    size_t n_points[N_POLLUTANT_FIELDS];
+} WAQIHourlyMeans;
+
+// Decodes one NUL-terminated event of `len` bytes into `station`. The
+// means of an hourly event go to `hourly`, not into the station's series.
+WAQIEventType waqi_decode_event(WAQIStationData &station, const char *json, size_t len, WAQIHourlyMeans *hourly);
+
+// --- Time Series Storage ---
+// Live metrics are kept in fixed-capacity ring buffers with the values and
+// timestamps in separate arrays, so pushing a sample never shifts memory.
+// Each metric also keeps coarser rollup tiers (min/max/mean per bucket)
+// that are folded incrementally as raw samples arrive.
+
+template <typename T>
+class RingSeries
+{
+public:
+    explicit RingSeries(size_t capacity) : values_(capacity), timestamps_(capacity), head_(0), count_(0) {}
+
+    void push(gint64 timestamp_us, T value)
+    {
+        values_[head_] = value;
+        timestamps_[head_] = timestamp_us;
+        head_ = (head_ + 1) % values_.size();
+        if (count_ < values_.size())
+            count_++;
+    }
+
+    size_t size() const { return count_; }
+    size_t capacity() const { return values_.size(); }
+    bool empty() const { return count_ == 0; }
+
+    // Index 0 is the oldest retained sample
+    T operator[](size_t i) const { return values_[physical(i)]; }
+    gint64 timestamp(size_t i) const { return timestamps_[physical(i)]; }
+    T back() const { return (*this)[count_ - 1]; }
+
+    // Calls fn(const T *values, size_t n) for samples [begin, end) as at most
+    // two contiguous runs, oldest first, so reductions can work on raw memory
+    template <typename F>
+    void for_each_span(size_t begin, size_t end, F fn) const
+    {
+        while (begin < end)
+        {
+            size_t p = physical(begin);
+            size_t n = std::min(end - begin, values_.size() - p);
+            fn(values_.data() + p, n);
+            begin += n;
+        }
+    }
+
+private:
+    size_t physical(size_t i) const { return (head_ + values_.size() - count_ + i) % values_.size(); }
+
+    std::vector<T> values_;
+    std::vector<gint64> timestamps_;
+    size_t head_; // Next write position
+    size_t count_;
+};
+
+template <typename T, typename F>
+void series_for_each_span(const std::vector<T> &series, size_t begin, size_t end, F fn)
+{
+    if (begin < end)
+        fn(series.data() + begin, end - begin);
+}
+
+template <typename T, typename F>
+void series_for_each_span(const RingSeries<T> &series, size_t begin, size_t end, F fn)
+{
+    series.for_each_span(begin, end, fn);
+}
+
+// Read-only view of the newest samples of a ring, indexed oldest-first
+template <typename Series>
+class SeriesWindow
+{
+public:
+    SeriesWindow(const Series &series, size_t max_len)
+        : series_(series), offset_(series.size() > max_len ? series.size() - max_len : 0),
+          count_(series.size() - offset_)
+    {
+    }
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    double operator[](size_t i) const { return series_[offset_ + i]; }
+    double back() const { return (*this)[count_ - 1]; }
+
+    template <typename F>
+    void for_each_span(size_t begin, size_t end, F fn) const
+    {
+        series_for_each_span(series_, offset_ + begin, offset_ + end, fn);
+    }
+
+private:
+    const Series &series_;
+    size_t offset_;
+    size_t count_;
+};
+
+template <typename Series, typename F>
+void series_for_each_span(const SeriesWindow<Series> &series, size_t begin, size_t end, F fn)
+{
+    series.for_each_span(begin, end, fn);
+}
+
+// One downsampled tier: a ring of closed buckets plus the open accumulator
+template <typename T>
+class RollupSeries
+{
+public:
+    RollupSeries(gint64 bucket_us, size_t capacity)
+        : min(capacity), max(capacity), mean(capacity), bucket_us_(bucket_us), open_bucket_(-1), open_count_(0),
+          open_sum_(0), open_min_(0), open_max_(0)
+    {
+    }
+
+    void add(gint64 timestamp_us, T value)
+    {
+        gint64 bucket = timestamp_us / bucket_us_;
+        if (bucket != open_bucket_)
+        {
+            flush();
+            open_bucket_ = bucket;
+        }
+
+        if (open_count_ == 0)
+        {
+            open_min_ = value;
+            open_max_ = value;
+        }
+        else
+        {
+            open_min_ = std::min(open_min_, value);
+            open_max_ = std::max(open_max_, value);
+        }
+        open_sum_ += value;
+        open_count_++;
+    }
+
+    // Closed buckets, stamped with each bucket's start time
+    RingSeries<T> min;
+    RingSeries<T> max;
+    RingSeries<T> mean;
+
+private:
+    void flush()
+    {
+        if (open_count_ == 0)
+            return;
+        gint64 start = open_bucket_ * bucket_us_;
+        min.push(start, open_min_);
+        max.push(start, open_max_);
+        mean.push(start, (T)(open_sum_ / open_count_));
+        open_count_ = 0;
+        open_sum_ = 0;
+    }
+
+    gint64 bucket_us_;
+    gint64 open_bucket_;
+    guint open_count_;
+    double open_sum_;
+    T open_min_;
+    T open_max_;
+};
+
+#define SERIES_RAW_CAPACITY 600     // 1 s samples for 10 minutes
+#define SERIES_MINUTE_CAPACITY 1440 // 1 min buckets for 24 hours
+#define SERIES_HOUR_CAPACITY 720    // 1 h buckets for 30 days
+
+template <typename T>
+class MetricSeries
+{
+public:
+    MetricSeries()
+        : raw(SERIES_RAW_CAPACITY), minutes(60 * G_USEC_PER_SEC, SERIES_MINUTE_CAPACITY),
+          hours((gint64)3600 * G_USEC_PER_SEC, SERIES_HOUR_CAPACITY)
+    {
+    }
+
+    void push(gint64 timestamp_us, T value)
+    {
+        raw.push(timestamp_us, value);
+        minutes.add(timestamp_us, value);
+        hours.add(timestamp_us, value);
+    }
+
+    RingSeries<T> raw;
+    RollupSeries<T> minutes;
+    RollupSeries<T> hours;
+};
+
+// --- Chart Decimation ---
+
+// A vertex of the plotted line; index is in samples and may be fractional
+typedef struct
+{
+    double index;
+    double value;
+} ChartPoint;
+
+// Plot area and value scale shared by the static layers and the hover overlay
+typedef struct
+{
+    double margin_x;
+    double margin_y;
+    double graph_w;
+    double graph_h;
+    double step_x;
+    int max_val;
+} ChartGeometry;
+
+// Series longer than twice the plot width in pixels are decimated to the
+// min and max of each pixel column before they are stroked, which keeps
+// every spike visible while the path stays at about 2 vertices per pixel.
+// The reductions run over contiguous runs of the underlying storage.
+
+// Min and max of a contiguous run. The four independent lanes break the
+// compare dependency chain, so the loop maps onto one SIMD register
+// (SSE/NEON) when the compiler vectorizes it.
+template <typename T>
+void span_min_max(const T *values, size_t n, double &lo, double &hi)
+{
+    if (n == 0)
+        return;
+
+    T mn[4] = {values[0], values[0], values[0], values[0]};
+    T mx[4] = {values[0], values[0], values[0], values[0]};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            T v = values[i + k];
+            mn[k] = v < mn[k] ? v : mn[k];
+            mx[k] = v > mx[k] ? v : mx[k];
+        }
+    }
+    for (; i < n; i++)
+    {
+        mn[0] = values[i] < mn[0] ? values[i] : mn[0];
+        mx[0] = values[i] > mx[0] ? values[i] : mx[0];
+    }
+
+    for (int k = 0; k < 4; k++)
+    {
+        lo = std::min(lo, (double)mn[k]);
+        hi = std::max(hi, (double)mx[k]);
+    }
+}
+
+template <typename Series>
+void series_min_max(const Series &series, size_t begin, size_t end, double &lo, double &hi)
+{
+    series_for_each_span(series, begin, end,
+                         [&](const auto *values, size_t n) { span_min_max(values, n, lo, hi); });
+}
+
+// Fills `out` with the samples to plot across `columns` pixel columns
+template <typename Series>
+void chart_downsample(const Series &history, int columns, std::vector<ChartPoint> &out)
+{
+    out.clear();
+    size_t n = history.size();
+    if (columns < 1 || n <= (size_t)columns * 2)
+    {
+        for (size_t i = 0; i < n; i++)
+            out.push_back({(double)i, (double)history[i]});
+        return;
+    }
+
+    double prev = history[0];
+    for (int c = 0; c < columns; c++)
+    {
+        size_t begin = n * (size_t)c / (size_t)columns;
+        size_t end = n * (size_t)(c + 1) / (size_t)columns;
+        double lo = INFINITY, hi = -INFINITY;
+        series_min_max(history, begin, end, lo, hi);
+
+        // Both extremes sit on the column centre; enter the column from the
+        // side nearer the previous vertex so the joins stay short.
+        double x = (begin + end - 1) / 2.0;
+        if (fabs(prev - lo) < fabs(prev - hi))
+        {
+            out.push_back({x, lo});
+            out.push_back({x, hi});
+            prev = hi;
+        }
+        else
+        {
+            out.push_back({x, hi});
+            out.push_back({x, lo});
+            prev = lo;
+        }
+    }
+}
+
+// Plot width in pixels of a chart `width` pixels wide
+double chart_graph_width(int width);
+
+// Plot area and value scale for `points` laid out over `n_samples` samples
+ChartGeometry chart_compute_geometry(const std::vector<ChartPoint> &points, size_t n_samples, int width, int height);
+
+#endif // AQI_CORE_H
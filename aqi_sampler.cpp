@@ -0,0 +1,567 @@
+// Platform backends for the system samplers; see aqi_sampler.h.
+
+#include "aqi_sampler.h"
+
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <windows.h>
+#include <iphlpapi.h>
+#include <netioapi.h>
+#pragma comment(lib, "iphlpapi.lib")
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/sysctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <net/route.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#endif
+
+// --- Counters ---
+
+typedef struct
+{
+    unsigned long long busy;
+    unsigned long long total;
+} CpuTicks;
+
+typedef struct
+{
+    unsigned long long bytes;
+    gint64 time_us;
+} NetCounter;
+
+// Busy share of the ticks elapsed since the previous call; 0 on the first one
+static double cpu_ticks_percent(CpuTicks *prev, unsigned long long busy, unsigned long long total)
+{
+    bool first = prev->total == 0;
+    unsigned long long d_total = total - prev->total;
+    unsigned long long d_busy = busy - prev->busy;
+    prev->busy = busy;
+    prev->total = total;
+
+    if (first || total < d_total || d_total == 0 || d_busy > d_total)
+        return 0.0;
+    return d_busy * 100.0 / d_total;
+}
+
+// Byte counter rate in Mbps since the previous call; counter resets read as 0
+static double net_counter_mbps(NetCounter *prev, unsigned long long bytes)
+{
+    gint64 now = g_get_monotonic_time();
+    double mbps = 0.0;
+
+    if (prev->time_us != 0 && now > prev->time_us && bytes >= prev->bytes)
+    {
+        double seconds = (now - prev->time_us) / (double)G_USEC_PER_SEC;
+        mbps = (bytes - prev->bytes) * 8.0 / (1024.0 * 1024.0) / seconds;
+    }
+
+    prev->bytes = bytes;
+    prev->time_us = now;
+    return mbps;
+}
+
+typedef struct
+{
+    char name[64];
+    NetCounter counter;
+} NetInterfaceState;
+
+// Per-interface rate keyed by name; interfaces past the table size are
+// still counted in the total but not listed individually
+static void sample_interface_rate(SystemSample *sample, NetInterfaceState *states, int *n_states, const char *name,
+                                  unsigned long long bytes)
+{
+    NetInterfaceState *state = NULL;
+    for (int i = 0; i < *n_states; i++)
+    {
+        if (strcmp(states[i].name, name) == 0)
+        {
+            state = &states[i];
+            break;
+        }
+    }
+    if (!state)
+    {
+        if (*n_states >= SAMPLER_MAX_INTERFACES)
+            return;
+        state = &states[(*n_states)++];
+        g_strlcpy(state->name, name, sizeof(state->name));
+        state->counter.bytes = 0;
+        state->counter.time_us = 0;
+    }
+
+    double mbps = net_counter_mbps(&state->counter, bytes);
+    if (sample->n_net_if < SAMPLER_MAX_INTERFACES)
+    {
+        InterfaceRate *rate = &sample->net_if[sample->n_net_if++];
+        g_strlcpy(rate->name, name, sizeof(rate->name));
+        rate->mbps = mbps;
+    }
+}
+
+// --- Platform Backends ---
+
+#ifdef _WIN32
+static unsigned long long FileTimeToInt64(const FILETIME &ft)
+{
+    return (((unsigned long long)(ft.dwHighDateTime)) << 32) | ((unsigned long long)ft.dwLowDateTime);
+}
+
+static double GetCPULoad()
+{
+    static FILETIME preIdleTime = {0}, preKernelTime = {0}, preUserTime = {0};
+    FILETIME idleTime, kernelTime, userTime;
+
+    if (!GetSystemTimes(&idleTime, &kernelTime, &userTime))
+        return 0.0;
+
+    unsigned long long idle = FileTimeToInt64(idleTime) - FileTimeToInt64(preIdleTime);
+    unsigned long long kernel = FileTimeToInt64(kernelTime) - FileTimeToInt64(preKernelTime);
+    unsigned long long user = FileTimeToInt64(userTime) - FileTimeToInt64(preUserTime);
+
+    preIdleTime = idleTime;
+    preKernelTime = kernelTime;
+    preUserTime = userTime;
+
+    if (kernel + user == 0)
+        return 0.0;
+
+    return (double)(kernel + user - idle) * 100.0 / (kernel + user);
+}
+
+// Per-core times come from NtQuerySystemInformation, looked up in ntdll at
+// run time as it is not in the import libraries. The layout is declared
+// here because winternl.h hides most of its fields. It covers the
+// processor group the process runs in, at most 64 cores.
+typedef LONG(WINAPI *NtQuerySystemInformationFn)(ULONG info_class, PVOID info, ULONG length, PULONG return_length);
+
+#define WIN_SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION 8
+
+typedef struct
+{
+    LARGE_INTEGER idle_time;
+    LARGE_INTEGER kernel_time; // Includes idle_time
+    LARGE_INTEGER user_time;
+    LARGE_INTEGER dpc_time;
+    LARGE_INTEGER interrupt_time;
+    ULONG interrupt_count;
+} WinProcessorTimes;
+
+static void GetCoreLoads(SystemSample *sample)
+{
+    static NtQuerySystemInformationFn query = NULL;
+    static bool query_resolved = false;
+    static WinProcessorTimes times[SAMPLER_MAX_CORES];
+    static CpuTicks core_prev[SAMPLER_MAX_CORES];
+
+    sample->n_cores = 0;
+    if (!query_resolved)
+    {
+        HMODULE ntdll = GetModuleHandleW(L"ntdll.dll");
+        if (ntdll)
+            query = (NtQuerySystemInformationFn)(void *)GetProcAddress(ntdll, "NtQuerySystemInformation");
+        query_resolved = true;
+    }
+    if (!query)
+        return;
+
+    ULONG length = 0;
+    if (query(WIN_SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION, times, sizeof(times), &length) < 0)
+        return;
+
+    sample->n_cores = (int)MIN(length / sizeof(WinProcessorTimes), (ULONG)SAMPLER_MAX_CORES);
+    for (int i = 0; i < sample->n_cores; i++)
+    {
+        unsigned long long idle = (unsigned long long)times[i].idle_time.QuadPart;
+        unsigned long long total =
+            (unsigned long long)times[i].kernel_time.QuadPart + (unsigned long long)times[i].user_time.QuadPart;
+        sample->cpu_core[i] = cpu_ticks_percent(&core_prev[i], total - idle, total);
+    }
+}
+
+static double GetMemoryUsage()
+{
+    MEMORYSTATUSEX memInfo;
+    memInfo.dwLength = sizeof(MEMORYSTATUSEX);
+    GlobalMemoryStatusEx(&memInfo);
+    return (double)memInfo.dwMemoryLoad;
+}
+
+// Interface rows are listed with GetIfTable2 only on refresh; each tick
+// re-queries the retained rows in place with GetIfEntry2, so sampling does
+// not allocate and uses the 64-bit octet counters.
+typedef struct
+{
+    MIB_IF_ROW2 row;
+    NetCounter counter;
+} WinInterface;
+
+#define WIN_INTERFACE_REFRESH_US (30 * G_USEC_PER_SEC)
+
+static std::vector<WinInterface> win_interfaces;
+static std::vector<WinInterface> win_interfaces_scratch; // Swapped on refresh to keep both capacities
+static gint64 win_interfaces_refreshed = 0;
+
+static void win_refresh_interfaces()
+{
+    MIB_IF_TABLE2 *table = NULL;
+    if (GetIfTable2(&table) != NO_ERROR)
+        return;
+
+    win_interfaces_scratch.clear();
+    for (ULONG i = 0; i < table->NumEntries; i++)
+    {
+        const MIB_IF_ROW2 &row = table->Table[i];
+        // Filter drivers mirror their parent adapter's counters
+        if (row.Type == IF_TYPE_SOFTWARE_LOOPBACK || row.InterfaceAndOperStatusFlags.FilterInterface)
+            continue;
+
+        WinInterface iface;
+        iface.row = row;
+        iface.counter.bytes = 0;
+        iface.counter.time_us = 0;
+
+        // Carry the previous counters over so the rate stays continuous
+        for (const WinInterface &old : win_interfaces)
+        {
+            if (old.row.InterfaceLuid.Value == row.InterfaceLuid.Value)
+            {
+                iface.counter = old.counter;
+                break;
+            }
+        }
+        win_interfaces_scratch.push_back(iface);
+    }
+    FreeMibTable(table);
+
+    win_interfaces.swap(win_interfaces_scratch);
+    win_interfaces_refreshed = g_get_monotonic_time();
+}
+
+static double GetNetworkUsage(SystemSample *sample)
+{
+    if (win_interfaces_refreshed == 0 || g_get_monotonic_time() - win_interfaces_refreshed > WIN_INTERFACE_REFRESH_US)
+        win_refresh_interfaces();
+
+    double total = 0.0;
+    sample->n_net_if = 0;
+    for (WinInterface &iface : win_interfaces)
+    {
+        if (GetIfEntry2(&iface.row) != NO_ERROR)
+        {
+            // Interface went away; rebuild the list on the next tick
+            win_interfaces_refreshed = 0;
+            continue;
+        }
+
+        double mbps = net_counter_mbps(&iface.counter, iface.row.InOctets + iface.row.OutOctets);
+        total += mbps;
+
+        if (sample->n_net_if < SAMPLER_MAX_INTERFACES)
+        {
+            InterfaceRate *rate = &sample->net_if[sample->n_net_if++];
+            if (WideCharToMultiByte(CP_UTF8, 0, iface.row.Alias, -1, rate->name, sizeof(rate->name), NULL, NULL) == 0)
+                rate->name[0] = '\0';
+            rate->mbps = mbps;
+        }
+    }
+    return total;
+}
+
+void system_sampler_read(SystemSample *sample)
+{
+    sample->cpu_total = GetCPULoad();
+    GetCoreLoads(sample);
+    sample->mem_used = GetMemoryUsage();
+    sample->net_mbps = GetNetworkUsage(sample);
+}
+#elif defined(__APPLE__)
+static mach_port_t sampler_host = MACH_PORT_NULL;
+
+void system_sampler_read(SystemSample *sample)
+{
+    static CpuTicks total_prev;
+    static CpuTicks core_prev[SAMPLER_MAX_CORES];
+    static unsigned long long mem_total = 0;
+    static vm_size_t page_size = 0;
+    static std::vector<char> iflist; // Grown once, reused every tick
+    static NetCounter net_prev;
+    static NetInterfaceState if_states[SAMPLER_MAX_INTERFACES];
+    static int n_if_states = 0;
+
+    if (sampler_host == MACH_PORT_NULL)
+    {
+        sampler_host = mach_host_self();
+        size_t len = sizeof(mem_total);
+        sysctlbyname("hw.memsize", &mem_total, &len, NULL, 0);
+        host_page_size(sampler_host, &page_size);
+    }
+
+    sample->cpu_total = 0.0;
+    host_cpu_load_info_data_t load;
+    mach_msg_type_number_t count = HOST_CPU_LOAD_INFO_COUNT;
+    if (host_statistics(sampler_host, HOST_CPU_LOAD_INFO, (host_info_t)&load, &count) == KERN_SUCCESS)
+    {
+        unsigned long long idle = load.cpu_ticks[CPU_STATE_IDLE];
+        unsigned long long total = load.cpu_ticks[CPU_STATE_USER] + load.cpu_ticks[CPU_STATE_SYSTEM] +
+                                   load.cpu_ticks[CPU_STATE_NICE] + idle;
+        sample->cpu_total = cpu_ticks_percent(&total_prev, total - idle, total);
+    }
+
+    sample->n_cores = 0;
+    natural_t n_cpu = 0;
+    processor_info_array_t info;
+    mach_msg_type_number_t info_count;
+    if (host_processor_info(sampler_host, PROCESSOR_CPU_LOAD_INFO, &n_cpu, &info, &info_count) == KERN_SUCCESS)
+    {
+        processor_cpu_load_info_t cores = (processor_cpu_load_info_t)info;
+        sample->n_cores = (int)MIN(n_cpu, (natural_t)SAMPLER_MAX_CORES);
+        for (int i = 0; i < sample->n_cores; i++)
+        {
+            unsigned long long idle = cores[i].cpu_ticks[CPU_STATE_IDLE];
+            unsigned long long total = cores[i].cpu_ticks[CPU_STATE_USER] + cores[i].cpu_ticks[CPU_STATE_SYSTEM] +
+                                       cores[i].cpu_ticks[CPU_STATE_NICE] + idle;
+            sample->cpu_core[i] = cpu_ticks_percent(&core_prev[i], total - idle, total);
+        }
+        vm_deallocate(mach_task_self(), (vm_address_t)info, info_count * sizeof(integer_t));
+    }
+
+    sample->mem_used = 0.0;
+    vm_statistics64_data_t vm;
+    count = HOST_VM_INFO64_COUNT;
+    if (mem_total > 0 &&
+        host_statistics64(sampler_host, HOST_VM_INFO64, (host_info64_t)&vm, &count) == KERN_SUCCESS)
+    {
+        unsigned long long used =
+            ((unsigned long long)vm.active_count + vm.wire_count + vm.compressor_page_count) * page_size;
+        sample->mem_used = used * 100.0 / mem_total;
+    }
+
+    sample->net_mbps = 0.0;
+    sample->n_net_if = 0;
+    int mib[6] = {CTL_NET, PF_ROUTE, 0, 0, NET_RT_IFLIST2, 0};
+    size_t len = 0;
+    if (sysctl(mib, 6, NULL, &len, NULL, 0) == 0)
+    {
+        if (len > iflist.size())
+            iflist.resize(len + len / 4); // Headroom for interfaces appearing later
+        len = iflist.size();
+        if (sysctl(mib, 6, iflist.data(), &len, NULL, 0) == 0)
+        {
+            unsigned long long bytes = 0;
+            for (char *p = iflist.data(); p < iflist.data() + len;)
+            {
+                struct if_msghdr *ifm = (struct if_msghdr *)p;
+                if (ifm->ifm_msglen == 0)
+                    break;
+                if (ifm->ifm_type == RTM_IFINFO2 && !(ifm->ifm_flags & IFF_LOOPBACK))
+                {
+                    struct if_msghdr2 *if2 = (struct if_msghdr2 *)p;
+                    unsigned long long if_bytes = if2->ifm_data.ifi_ibytes + if2->ifm_data.ifi_obytes;
+                    bytes += if_bytes;
+
+                    char name[IF_NAMESIZE];
+                    if (if_indextoname(if2->ifm_index, name))
+                        sample_interface_rate(sample, if_states, &n_if_states, name, if_bytes);
+                }
+                p += ifm->ifm_msglen;
+            }
+            sample->net_mbps = net_counter_mbps(&net_prev, bytes);
+        }
+    }
+}
+#elif defined(__linux__)
+// /proc files are kept open and re-read with pread at offset 0, which makes
+// the kernel regenerate them without a fresh open/close per tick.
+#define PROC_UNAVAILABLE -2
+
+static int proc_stat_fd = -1;
+static int proc_meminfo_fd = -1;
+static int proc_net_dev_fd = -1;
+static char proc_buf[32768]; // Only the sampler touches this
+
+static ssize_t proc_read(int *fd, const char *path)
+{
+    if (*fd == PROC_UNAVAILABLE)
+        return -1;
+    if (*fd < 0)
+    {
+        *fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (*fd < 0)
+        {
+            // Android 8+ denies /proc/stat to apps; don't retry every tick
+            *fd = PROC_UNAVAILABLE;
+            return -1;
+        }
+    }
+
+    ssize_t n = pread(*fd, proc_buf, sizeof(proc_buf) - 1, 0);
+    if (n < 0)
+        return -1;
+    proc_buf[n] = '\0';
+    return n;
+}
+
+static unsigned long long proc_next_u64(const char **p)
+{
+    const char *s = *p;
+    while (*s == ' ' || *s == '\t')
+        s++;
+    unsigned long long v = 0;
+    while (*s >= '0' && *s <= '9')
+        v = v * 10 + (unsigned long long)(*s++ - '0');
+    *p = s;
+    return v;
+}
+
+static const char *proc_next_line(const char *p)
+{
+    const char *nl = strchr(p, '\n');
+    return nl ? nl + 1 : NULL;
+}
+
+// Fields: user nice system idle iowait irq softirq steal
+static void proc_cpu_ticks(const char *p, unsigned long long *busy, unsigned long long *total)
+{
+    unsigned long long fields[8];
+    for (int i = 0; i < 8; i++)
+        fields[i] = proc_next_u64(&p);
+
+    unsigned long long idle = fields[3] + fields[4];
+    *total = 0;
+    for (int i = 0; i < 8; i++)
+        *total += fields[i];
+    *busy = *total - idle;
+}
+
+static void proc_sample_cpu(SystemSample *sample)
+{
+    static CpuTicks total_prev;
+    static CpuTicks core_prev[SAMPLER_MAX_CORES];
+
+    sample->cpu_total = 0.0;
+    sample->n_cores = 0;
+
+    if (proc_read(&proc_stat_fd, "/proc/stat") < 0)
+    {
+        // Fall back to this process's share of the machine
+        struct timespec cpu_ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_ts);
+        unsigned long long busy = (unsigned long long)cpu_ts.tv_sec * 1000000000ULL + cpu_ts.tv_nsec;
+        unsigned long long total = (unsigned long long)g_get_monotonic_time() * 1000ULL * g_get_num_processors();
+        sample->cpu_total = cpu_ticks_percent(&total_prev, busy, total);
+        return;
+    }
+
+    for (const char *line = proc_buf; line && strncmp(line, "cpu", 3) == 0; line = proc_next_line(line))
+    {
+        const char *p = line + 3;
+        unsigned long long busy, total;
+
+        if (*p == ' ')
+        {
+            proc_cpu_ticks(p, &busy, &total);
+            sample->cpu_total = cpu_ticks_percent(&total_prev, busy, total);
+            continue;
+        }
+
+        unsigned long long core = proc_next_u64(&p);
+        if (core >= SAMPLER_MAX_CORES)
+            continue;
+        proc_cpu_ticks(p, &busy, &total);
+        sample->cpu_core[core] = cpu_ticks_percent(&core_prev[core], busy, total);
+        if ((int)core >= sample->n_cores)
+            sample->n_cores = (int)core + 1;
+    }
+}
+
+static void proc_sample_memory(SystemSample *sample)
+{
+    sample->mem_used = 0.0;
+    if (proc_read(&proc_meminfo_fd, "/proc/meminfo") < 0)
+        return;
+
+    const char *total_line = strstr(proc_buf, "MemTotal:");
+    const char *avail_line = strstr(proc_buf, "MemAvailable:");
+    if (!total_line || !avail_line)
+        return;
+
+    const char *p = total_line + strlen("MemTotal:");
+    unsigned long long total = proc_next_u64(&p);
+    p = avail_line + strlen("MemAvailable:");
+    unsigned long long avail = proc_next_u64(&p);
+    if (total > 0 && avail <= total)
+        sample->mem_used = (total - avail) * 100.0 / total;
+}
+
+static void proc_sample_network(SystemSample *sample)
+{
+    static NetCounter net_prev;
+    static NetInterfaceState if_states[SAMPLER_MAX_INTERFACES];
+    static int n_if_states = 0;
+
+    sample->net_mbps = 0.0;
+    sample->n_net_if = 0;
+    if (proc_read(&proc_net_dev_fd, "/proc/net/dev") < 0)
+        return;
+
+    // Two header lines, then "iface: rx_bytes <7 fields> tx_bytes ..."
+    const char *line = proc_next_line(proc_buf);
+    line = line ? proc_next_line(line) : NULL;
+
+    unsigned long long bytes = 0;
+    for (; line && *line; line = proc_next_line(line))
+    {
+        const char *name = line;
+        while (*name == ' ')
+            name++;
+        const char *colon = strchr(name, ':');
+        if (!colon)
+            break;
+        if (colon - name == 2 && strncmp(name, "lo", 2) == 0)
+            continue;
+
+        const char *p = colon + 1;
+        unsigned long long rx = proc_next_u64(&p);
+        for (int i = 0; i < 7; i++)
+            proc_next_u64(&p);
+        unsigned long long tx = proc_next_u64(&p);
+        bytes += rx + tx;
+
+        char if_name[64];
+        size_t name_len = MIN((size_t)(colon - name), sizeof(if_name) - 1);
+        memcpy(if_name, name, name_len);
+        if_name[name_len] = '\0';
+        sample_interface_rate(sample, if_states, &n_if_states, if_name, rx + tx);
+    }
+
+    sample->net_mbps = net_counter_mbps(&net_prev, bytes);
+}
+
+void system_sampler_read(SystemSample *sample)
+{
+    proc_sample_cpu(sample);
+    proc_sample_memory(sample);
+    proc_sample_network(sample);
+}
+#else
+void system_sampler_read(SystemSample *sample)
+{
+    sample->cpu_total = 0.0;
+    sample->n_cores = 0;
+    sample->mem_used = 0.0;
+    sample->net_mbps = 0.0;
+    sample->n_net_if = 0;
+}
+#endif
@@ -0,0 +1,35 @@
+// System samplers behind the live charts: CPU load in total and per core,
+// memory use and network throughput, read from the platform's counters.
+// They only need GLib, so the benchmarks can time a real read.
+
+#ifndef AQI_SAMPLER_H
+#define AQI_SAMPLER_H
+
+#include <glib.h>
+
+#define SAMPLER_MAX_CORES 256
+#define SAMPLER_MAX_INTERFACES 32
+
+typedef struct
+{
+    char name[64];
+    double mbps; // Receive + transmit rate of this interface
+} InterfaceRate;
+
+typedef struct
+{
+    double cpu_total;                   // Percent busy across all cores
+    double cpu_core[SAMPLER_MAX_CORES]; // Percent busy per core
+    int n_cores;                        // Valid entries in cpu_core (0 if unsupported)
+    double mem_used;                    // Percent of physical memory in use
+    double net_mbps;                    // Combined receive + transmit rate
+    InterfaceRate net_if[SAMPLER_MAX_INTERFACES];
+    int n_net_if; // Valid entries in net_if, excluding loopback
+} SystemSample;
+
+// Fills one sample from the platform backend. Backends keep their previous
+// counters so every figure is a rate over the last interval, and none of
+// them allocate per sample. Not thread-safe: call from one thread only.
+void system_sampler_read(SystemSample *sample);
+
+#endif // AQI_SAMPLER_H
@@ -0,0 +1,191 @@
+// Harness for the benchmarks in this directory: option parsing, allocation
+// counting and the report lines.
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <new>
+
+BenchOptions bench_options = {1.0, 0.0, NULL, NULL, NULL};
+
+std::atomic<size_t> bench_allocs(0);
+
+// --- Allocation Counting ---
+// With glibc the C allocator itself is interposed, so GLib's g_malloc and
+// g_slice and C++'s operator new are all seen. Elsewhere, and under the
+// sanitizers, which interpose malloc themselves, only operator new is.
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define BENCH_SANITIZED 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+#define BENCH_SANITIZED 1
+#endif
+#endif
+
+#if defined(__GLIBC__) && !defined(BENCH_SANITIZED)
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+
+extern "C" void *malloc(size_t size) __THROW
+{
+    bench_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size) __THROW
+{
+    bench_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) __THROW
+{
+    bench_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void *memalign(size_t alignment, size_t size) __THROW
+{
+    bench_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+const bool bench_allocs_counted = true;
+
+#else
+
+void *operator new(size_t size)
+{
+    bench_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+// GLib's allocations are not seen, so allocs/op is a lower bound
+const bool bench_allocs_counted = false;
+
+#endif
+
+// --- Reports ---
+
+bool bench_selected(const std::string &name)
+{
+    return !bench_options.filter || name.find(bench_options.filter) != std::string::npos;
+}
+
+static gint64 bench_percentile(std::vector<gint64> &sorted, double q)
+{
+    if (sorted.empty())
+        return 0;
+    size_t i = (size_t)(q * (double)(sorted.size() - 1) + 0.5);
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+void bench_report(const std::string &name, BenchResult &r)
+{
+    double ops = r.ops ? (double)r.ops : 1.0;
+    double seconds = r.elapsed_ns / 1e9;
+    double ns_per_op = (double)r.busy_ns / ops;
+    double mb_per_s = seconds > 0 ? r.bytes / seconds / 1e6 : 0.0;
+
+    printf("%-36s %12.1f ns/op %9.2f allocs/op%s", name.c_str(), ns_per_op, r.allocs / ops,
+           bench_allocs_counted ? " " : "+");
+    if (r.bytes)
+        printf(" %10.1f MB/s", bench_options.rate > 0 ? r.bytes / (r.busy_ns / 1e9) / 1e6 : mb_per_s);
+
+    if (bench_options.rate > 0)
+    {
+        std::sort(r.latencies_ns.begin(), r.latencies_ns.end());
+        printf("  %8.1f op/s  p50 %.1f us  p99 %.1f us  max %.1f us  busy %.2f%%", r.ops / seconds,
+               bench_percentile(r.latencies_ns, 0.50) / 1e3, bench_percentile(r.latencies_ns, 0.99) / 1e3,
+               r.latencies_ns.empty() ? 0.0 : r.latencies_ns.back() / 1e3, 100.0 * r.busy_ns / r.elapsed_ns);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+void bench_skip(const std::string &name, const char *reason)
+{
+    if (!bench_selected(name))
+        return;
+    printf("%-36s skipped: %s\n", name.c_str(), reason);
+    fflush(stdout);
+}
+
+std::string bench_load_file(const char *path)
+{
+    char *contents = NULL;
+    gsize length = 0;
+    GError *error = NULL;
+    if (!g_file_get_contents(path, &contents, &length, &error))
+    {
+        g_printerr("aqi-bench: %s\n", error->message);
+        g_clear_error(&error);
+        exit(1);
+    }
+    std::string s(contents, length);
+    g_free(contents);
+    return s;
+}
+
+// --- Main ---
+
+int main(int argc, char *argv[])
+{
+    char *filter = NULL;
+    char *search_file = NULL;
+    char *sse_file = NULL;
+    GOptionEntry entries[] = {
+        {"time", 't', 0, G_OPTION_ARG_DOUBLE, &bench_options.time, "Seconds to run each case (default 1)", "SECONDS"},
+        {"rate", 'r', 0, G_OPTION_ARG_DOUBLE, &bench_options.rate,
+         "Pace operations to RATE per second instead of running flat out", "RATE"},
+        {"filter", 'f', 0, G_OPTION_ARG_STRING, &filter, "Only run cases whose name contains TEXT", "TEXT"},
+        {"search-file", 0, 0, G_OPTION_ARG_FILENAME, &search_file, "Replay a recorded search response", "FILE"},
+        {"sse-file", 0, 0, G_OPTION_ARG_FILENAME, &sse_file, "Replay a recorded event stream", "FILE"},
+        {NULL},
+    };
+
+    GOptionContext *context = g_option_context_new("- benchmark the AQI dashboard's hot paths");
+    g_option_context_add_main_entries(context, entries, NULL);
+    GError *error = NULL;
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("aqi-bench: %s\n", error->message);
+        g_clear_error(&error);
+        g_option_context_free(context);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    bench_options.filter = filter;
+    bench_options.search_file = search_file;
+    bench_options.sse_file = sse_file;
+
+    if (!bench_allocs_counted)
+        printf("# allocs/op marked + count operator new only\n");
+    bench_core();
+    bench_chart();
+    bench_sampler();
+
+    g_free(filter);
+    g_free(search_file);
+    g_free(sse_file);
+    return 0;
+}
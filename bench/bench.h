@@ -0,0 +1,108 @@
+// Micro-benchmarks for the parsers, the SSE framer, the chart renderer and
+// the system samplers, run by `meson test --benchmark` or directly as
+// `aqi-bench [OPTION...]`.
+//
+// Each case calls one operation repeatedly for --time seconds and reports
+// ns/op, allocations/op and throughput. With --rate the operations are
+// paced to that many per second instead, as a live feed or a typing user
+// would issue them, and the report adds the achieved rate, the latency
+// percentiles and the fraction of the time spent busy.
+
+#ifndef AQI_BENCH_H
+#define AQI_BENCH_H
+
+#include <glib.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef struct
+{
+    double time;             // Seconds per case
+    double rate;             // Operations per second, 0 to run flat out
+    const char *filter;      // Substring a case name must contain, or NULL
+    const char *search_file; // Recorded search response, or NULL for the built-in one
+    const char *sse_file;    // Recorded event stream, or NULL for the built-in one
+} BenchOptions;
+
+extern BenchOptions bench_options;
+
+// Allocator calls made so far by the process; see bench.cpp for what is counted
+extern std::atomic<size_t> bench_allocs;
+extern const bool bench_allocs_counted;
+
+typedef struct
+{
+    guint64 ops;
+    guint64 bytes;
+    size_t allocs;
+    gint64 elapsed_ns; // Wall time of the whole run
+    gint64 busy_ns;    // Time spent inside the operation
+    std::vector<gint64> latencies_ns;
+} BenchResult;
+
+bool bench_selected(const std::string &name);
+void bench_report(const std::string &name, BenchResult &result);
+// Reports a selected case that cannot run on this input or system
+void bench_skip(const std::string &name, const char *reason);
+
+// Reads a recorded payload; exits with a message when it cannot
+std::string bench_load_file(const char *path);
+
+// The case groups, one per source file
+void bench_core();
+void bench_chart();
+void bench_sampler();
+
+inline gint64 bench_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Runs `op`, which returns the number of input bytes it consumed. Only the
+// allocations made inside it are counted, so the harness's own bookkeeping
+// does not show up in allocs/op.
+template <typename F>
+void bench_run(const std::string &name, F op)
+{
+    if (!bench_selected(name))
+        return;
+
+    op(); // Warm caches and let lazily built state settle
+
+    BenchResult r = {};
+    r.latencies_ns.reserve(1 << 20);
+    gint64 period_ns = bench_options.rate > 0 ? (gint64)(1e9 / bench_options.rate) : 0;
+    gint64 start = bench_now_ns();
+    gint64 deadline = start + (gint64)(bench_options.time * 1e9);
+    gint64 now = start;
+
+    while (now < deadline)
+    {
+        if (period_ns)
+        {
+            // Late operations start at once rather than bunching up later
+            gint64 due = start + (gint64)r.ops * period_ns;
+            if (due > now)
+                std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+        }
+
+        size_t allocs_before = bench_allocs.load(std::memory_order_relaxed);
+        gint64 op_start = bench_now_ns();
+        r.bytes += op();
+        now = bench_now_ns();
+        r.allocs += bench_allocs.load(std::memory_order_relaxed) - allocs_before;
+
+        r.busy_ns += now - op_start;
+        if (r.latencies_ns.size() < r.latencies_ns.capacity())
+            r.latencies_ns.push_back(now - op_start);
+        r.ops++;
+    }
+    r.elapsed_ns = now - start;
+    bench_report(name, r);
+}
+
+#endif // AQI_BENCH_H
@@ -0,0 +1,127 @@
+// Benchmarks for the chart: decimation and layout, building the static
+// layers, and rendering them offscreen through a GskRenderer, at the sizes
+// the chart is shown at on phones, laptops and large displays.
+
+#include "bench.h"
+
+#include "aqi_chart.h"
+
+#include <pango/pangocairo.h>
+#include <stdio.h>
+
+typedef struct
+{
+    int width;
+    int height;
+    int scale;
+} BenchChartSize;
+
+static const BenchChartSize bench_chart_sizes[] = {
+    {360, 200, 3},
+    {800, 300, 1},
+    {800, 300, 2},
+    {1600, 600, 2},
+};
+
+// A live ring as the samplers fill it, and a station history of hourly means
+static void bench_fill_series(RingSeries<float> &live, std::vector<double> &history)
+{
+    for (size_t i = 0; i < live.capacity(); i++)
+        live.push((gint64)i * G_USEC_PER_SEC, (float)(50 + 30 * sin(i / 20.0) + (i * 7919 % 13)));
+    for (int i = 0; i < SERIES_HOUR_CAPACITY; i++)
+        history.push_back(80 + 60 * sin(i / 36.0) + (i * 104729 % 17));
+}
+
+static std::string bench_chart_name(const char *stage, const char *series, const BenchChartSize &size)
+{
+    char name[96];
+    snprintf(name, sizeof(name), "%s/%s/%dx%d@%d", stage, series, size.width, size.height, size.scale);
+    return name;
+}
+
+template <typename Series>
+static void bench_chart_series(GskRenderer *renderer, const char *renderer_name, PangoContext *pango,
+                               const char *series_name, const Series &series)
+{
+    std::vector<ChartPoint> points;
+    std::vector<guchar> pixels;
+
+    for (const BenchChartSize &size : bench_chart_sizes)
+    {
+        bench_run(bench_chart_name("chart-layout", series_name, size), [&]() {
+            chart_layout(series, size.width, size.height, size.scale, points);
+            return (size_t)0;
+        });
+
+        bench_run(bench_chart_name("chart-node", series_name, size), [&]() {
+            ChartGeometry geo = chart_layout(series, size.width, size.height, size.scale, points);
+            GskRenderNode *node = chart_build_static_node(pango, points, NULL, geo, size.width, size.height, "42");
+            gsk_render_node_unref(node);
+            return (size_t)0;
+        });
+
+        // Downloading the texture waits for the renderer to finish, which
+        // for GL means the GPU work is included
+        std::string stage = std::string("chart-render-") + renderer_name;
+        pixels.resize((size_t)size.width * size.scale * size.height * size.scale * 4);
+        bench_run(bench_chart_name(stage.c_str(), series_name, size), [&]() {
+            GdkTexture *texture = chart_render_offscreen(renderer, pango, series, size.width, size.height,
+                                                         size.scale, CHART_UNIT_AQI, points);
+            gdk_texture_download(texture, pixels.data(), (gsize)size.width * size.scale * 4);
+            g_object_unref(texture);
+            return (size_t)0;
+        });
+    }
+}
+
+static void bench_chart_renderer(GskRenderer *renderer, const char *renderer_name, PangoContext *pango)
+{
+    RingSeries<float> live(SERIES_RAW_CAPACITY);
+    std::vector<double> history;
+    bench_fill_series(live, history);
+
+    bench_chart_series(renderer, renderer_name, pango, "live", SeriesWindow<RingSeries<float>>(live, live.size()));
+    bench_chart_series(renderer, renderer_name, pango, "history", history);
+}
+
+void bench_chart()
+{
+    // Pango only needs a font map; a display is needed for GL alone
+    PangoContext *pango = pango_font_map_create_context(pango_cairo_font_map_get_default());
+    bool have_display = gtk_init_check();
+
+    GskRenderer *cairo_renderer = gsk_cairo_renderer_new();
+    GError *error = NULL;
+    if (gsk_renderer_realize(cairo_renderer, NULL, &error))
+    {
+        bench_chart_renderer(cairo_renderer, "cairo", pango);
+        gsk_renderer_unrealize(cairo_renderer);
+    }
+    else
+    {
+        g_printerr("aqi-bench: cairo renderer: %s\n", error->message);
+        g_clear_error(&error);
+    }
+    g_object_unref(cairo_renderer);
+
+#if GTK_CHECK_VERSION(4, 14, 0)
+    if (have_display)
+    {
+        GskRenderer *gl_renderer = gsk_gl_renderer_new();
+        if (gsk_renderer_realize_for_display(gl_renderer, gdk_display_get_default(), &error))
+        {
+            bench_chart_renderer(gl_renderer, "gl", pango);
+            gsk_renderer_unrealize(gl_renderer);
+        }
+        else
+        {
+            g_printerr("aqi-bench: GL renderer: %s\n", error->message);
+            g_clear_error(&error);
+        }
+        g_object_unref(gl_renderer);
+    }
+#endif
+    (void)have_display;
+
+    g_object_unref(pango);
+}
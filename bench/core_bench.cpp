@@ -0,0 +1,233 @@
+// Benchmarks for aqi-core: the search response parser, the SSE framer and
+// the feed decoder, replaying a recorded payload or a built-in one shaped
+// like the WAQI feeds.
+
+#include "bench.h"
+
+#include "aqi_core.h"
+
+#include <string.h>
+#include <algorithm>
+
+// --- Payloads ---
+
+// A search response as the WAQI search endpoint returns it, with the
+// escapes and non-ASCII names real results carry
+static std::string bench_search_response(int n_results)
+{
+    std::string json = "{\"status\":\"ok\",\"results\":[";
+    for (int i = 0; i < n_results; i++)
+    {
+        std::string id = std::to_string(1000 + i);
+        if (i)
+            json += ',';
+        json += "{\"x\":" + id + ",\"s\":{\"a\":\"" + std::to_string(20 + i * 7 % 180) + "\",\"n\":[\"Station " + id +
+                " \\u2013 S\\u00e3o Paulo, Brasil\",\"\"],\"u\":\"brazil/sao-paulo/station-" + id +
+                "\",\"c\":\"BR\",\"$\":\"cetesb\\/sp\",\"t\":[1700000000,\"2023-11-14 22:00:00\",\"-03:00\"]},"
+                "\"n\":[\"Station " +
+                id + "\",\"S\\u00e3o Paulo\",\"Brasil\"]}";
+    }
+    json += "]}";
+    return json;
+}
+
+static void bench_append_event(std::string &stream, const std::string &data)
+{
+    stream += "data: " + data + "\n\n";
+}
+
+// A station feed: its meta and hourly events, then a run of instant updates
+// and keep-alive comments
+static std::string bench_sse_stream()
+{
+    std::string stream;
+    bench_append_event(stream, "{\"type\":\"meta\",\"name\":\"Some Station, City, Country\",\"url\":"
+                               "\"https://aqicn.org/city/x\",\"geo\":[12.5,77.25],\"attributions\":[{\"name\":"
+                               "\"Agency\",\"url\":\"https://x\"}],\"feed\":{\"pm25\":[1700000000,4550],\"pm10\":[1,"
+                               "8000],\"o3\":[1,1200],\"no2\":[1,900],\"co\":[1,30],\"so2\":[1,250],\"t\":[1,20],"
+                               "\"h\":[1,60]}}");
+
+    std::string hourly = "{\"type\":\"hourly\"";
+    for (const char *key : {"pm25", "pm10", "o3", "no2", "co", "so2", "t", "h"})
+    {
+        hourly += std::string(",\"") + key + "\":[";
+        for (int i = 0; i < 24; i++)
+        {
+            if (i)
+                hourly += ',';
+            hourly += "{\"t\":" + std::to_string(1700000000 - (23 - i) * 3600) +
+                      ",\"min\":12,\"max\":40,\"avg\":23.5,\"mean\":" + std::to_string(20 + i) + ",\"n\":12}";
+        }
+        hourly += "]";
+    }
+    bench_append_event(stream, hourly + "}");
+
+    for (int i = 0; i < 60; i++)
+    {
+        std::string t = std::to_string(1700000000 + i * 60);
+        bench_append_event(stream, "{\"type\":\"instant\",\"data\":{\"t\":[[" + t + ",20]],\"pm25\":[[" + t + "," +
+                                       std::to_string(4000 + i * 13) + "]],\"pm10\":[[" + t +
+                                       ",7011]],\"o3\":[[" + t + ",1111]],\"no2\":[[" + t + ",222]],\"co\":[[" + t +
+                                       ",33]],\"so2\":[[" + t + ",44]]}}");
+        if (i % 15 == 14)
+            stream += ": keep-alive\n\n";
+        if (i % 10 == 9)
+        {
+            std::string cwop = "{\"type\":\"cwop\",\"data\":{\"x\":[";
+            for (int j = 0; j < 6; j++)
+            {
+                if (j)
+                    cwop += ',';
+                cwop += "{\"id\":\"CW" + std::to_string(1000 + j) + "\",\"t\":" + std::to_string(18 + j) +
+                        ".5,\"dew\":" + std::to_string(9 + j) + ".25,\"w\":3.5,\"wd\":" + std::to_string(45 * j) +
+                        ",\"p\":1013.2}";
+            }
+            bench_append_event(stream, cwop + "]}}");
+        }
+    }
+    return stream;
+}
+
+// Splits a stream after each blank line, as the server flushes its writes,
+// so that one operation feeds the framer what one read would return
+static std::vector<std::string> bench_split_events(const std::string &stream)
+{
+    std::vector<std::string> writes;
+    size_t start = 0;
+    while (start < stream.size())
+    {
+        size_t end = stream.find("\n\n", start);
+        end = end == std::string::npos ? stream.size() : end + 2;
+        writes.push_back(stream.substr(start, end - start));
+        start = end;
+    }
+    return writes;
+}
+
+// --- Cases ---
+
+static void bench_search()
+{
+    std::string json = bench_options.search_file ? bench_load_file(bench_options.search_file)
+                                                 : bench_search_response(20);
+    bench_run("search-parse", [&json]() {
+        WAQISearchBatch *batch = waqi_parse_search_response(json.data(), json.size());
+        waqi_search_batch_unref(batch);
+        return json.size();
+    });
+}
+
+static void bench_count_event(const char *data, size_t len, gpointer user_data)
+{
+    (*(guint64 *)user_data)++;
+}
+
+static void bench_sse_framing()
+{
+    std::string stream = bench_options.sse_file ? bench_load_file(bench_options.sse_file) : bench_sse_stream();
+    std::vector<std::string> writes = bench_split_events(stream);
+
+    guint64 events = 0;
+    SseFramer framer;
+    sse_framer_init(&framer, bench_count_event, &events);
+
+    size_t next = 0;
+    bench_run("sse-frame", [&]() {
+        const std::string &w = writes[next];
+        next = (next + 1) % writes.size();
+
+        size_t off = 0;
+        while (off < w.size())
+        {
+            size_t avail;
+            char *tail = sse_framer_reserve(&framer, &avail);
+            size_t n = std::min(avail, w.size() - off);
+            memcpy(tail, w.data() + off, n);
+            sse_framer_feed(&framer, n);
+            off += n;
+        }
+        return w.size();
+    });
+    g_free(framer.data);
+}
+
+static void bench_collect_event(const char *data, size_t len, gpointer user_data)
+{
+    ((std::vector<std::string> *)user_data)->push_back(std::string(data, len));
+}
+
+// Decodes the stream's events in order, then each event type on its own
+static void bench_sse_decoding()
+{
+    std::string stream = bench_options.sse_file ? bench_load_file(bench_options.sse_file) : bench_sse_stream();
+    std::vector<std::string> events;
+    SseFramer framer;
+    sse_framer_init(&framer, bench_collect_event, &events);
+    for (const std::string &w : bench_split_events(stream))
+    {
+        size_t off = 0;
+        while (off < w.size())
+        {
+            size_t avail;
+            char *tail = sse_framer_reserve(&framer, &avail);
+            size_t n = std::min(avail, w.size() - off);
+            memcpy(tail, w.data() + off, n);
+            sse_framer_feed(&framer, n);
+            off += n;
+        }
+    }
+    g_free(framer.data);
+    if (events.empty())
+    {
+        bench_skip("sse-decode", "no events in the stream");
+        return;
+    }
+
+    WAQIStationData station = {};
+    WAQIHourlyMeans hourly;
+    size_t next = 0;
+    bench_run("sse-decode", [&]() {
+        const std::string &e = events[next];
+        next = (next + 1) % events.size();
+        waqi_decode_event(station, e.c_str(), e.size(), &hourly);
+        return e.size();
+    });
+
+    static const struct
+    {
+        WAQIEventType type;
+        const char *name;
+    } types[] = {
+        {WAQI_EVENT_META, "sse-decode/meta"},
+        {WAQI_EVENT_INSTANT, "sse-decode/instant"},
+        {WAQI_EVENT_CWOP, "sse-decode/cwop"},
+        {WAQI_EVENT_HOURLY, "sse-decode/hourly"},
+    };
+    for (const auto &t : types)
+    {
+        std::vector<const std::string *> of_type;
+        for (const std::string &e : events)
+            if (waqi_decode_event(station, e.c_str(), e.size(), &hourly) == t.type)
+                of_type.push_back(&e);
+        if (of_type.empty())
+        {
+            bench_skip(t.name, "no events of this type in the stream");
+            continue;
+        }
+
+        next = 0;
+        bench_run(t.name, [&]() {
+            const std::string &e = *of_type[next];
+            next = (next + 1) % of_type.size();
+            waqi_decode_event(station, e.c_str(), e.size(), &hourly);
+            return e.size();
+        });
+    }
+}
+
+void bench_core()
+{
+    bench_search();
+    bench_sse_framing();
+    bench_sse_decoding();
+}
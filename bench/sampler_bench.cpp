@@ -0,0 +1,16 @@
+// Benchmarks for the system samplers: one full read of the platform
+// counters, as the live sampler thread takes it every tick.
+
+#include "bench.h"
+
+#include "aqi_sampler.h"
+
+void bench_sampler()
+{
+    static SystemSample sample; // Reused across reads, as the sampler thread does
+
+    bench_run("sampler-read", []() {
+        system_sampler_read(&sample);
+        return (size_t)0;
+    });
+}
@@ -16,23 +16,25 @@
 #include <vector>
 #include <math.h>
 #include <map>
+#include <list>
+#include <algorithm>
+#include <atomic>
 #include <string>
 #include <gmodule.h>
+#include <glib/gstdio.h>
+#ifdef __ANDROID__
+#include <dlfcn.h>
+#endif
+
+#include "aqi_core.h"
+#include "aqi_chart.h"
+#include "aqi_sampler.h"
 
 // Declare the GResource function (generated by glib-compile-resources)
 #ifdef __ANDROID__
 extern "C" GResource *resources_get_resource(void);
 #endif
 
-#ifdef _WIN32
-#ifndef NOMINMAX
-#define NOMINMAX
-#endif
-#include <windows.h>
-#include <iphlpapi.h>
-#pragma comment(lib, "iphlpapi.lib")
-#endif
-
 // --- Data Structures ---
 
 typedef struct
@@ -45,80 +47,14 @@ typedef struct
     std::vector<int> history; // 24-hour history
 } AirQualityData;
 
-// Extended data from WAQI feed
-typedef struct
-{
-    std::string station_id;
-    std::string station_name;
-    std::string station_url;
-    std::string attribution;
-    double latitude;
-    double longitude;
-
-    // Current values (scaled from raw * 100)
-    int aqi;
-    double pm25;
-    double pm10;
-    double o3;
-    double no2;
-    double co;
-    double so2;
-
-    // Weather data
-    double temperature;
-    double humidity;
-    double wind_speed;
-    int wind_direction;
-
-    // Hourly history (last 24 hours)
-    std::vector<double> pm25_history;
-    std::vector<double> pm10_history;
-    std::vector<double> o3_history;
-    std::vector<double> no2_history;
-
-    bool has_data;
-} WAQIStationData;
-
-// Search result item
-typedef struct
-{
-    std::string station_id;
-    std::string station_name;
-    std::string full_address;
-    std::string url;
-    std::string country;
-    std::string source;
-    int aqi;
-    bool has_aqi;
-} WAQISearchResult;
-
 // Global state
 static AirQualityData current_aqi_data;
 static WAQIStationData current_station_data;
-static std::vector<WAQISearchResult> search_results;
+static WAQISearchBatch *search_results = NULL; // Last presented search
 static GtkBuilder *g_current_builder = NULL;
 static char *g_api_city_name = NULL;
 static guint search_timeout_id = 0;
 
-static int calculate_aqi_from_pm25(double pm)
-{
-    if (pm <= 0.0)
-        return 0;
-    if (pm <= 12.0)
-        return (int)(pm * 50.0 / 12.0);
-    if (pm <= 35.4)
-        return (int)(50 + (pm - 12.0) * 50.0 / 23.4);
-    if (pm <= 55.4)
-        return (int)(100 + (pm - 35.4) * 50.0 / 20.0);
-    if (pm <= 150.4)
-        return (int)(150 + (pm - 55.4) * 50.0 / 95.0);
-    if (pm <= 250.4)
-        return (int)(200 + (pm - 150.4) * 100.0 / 100.0);
-    if (pm <= 350.4)
-        return (int)(300 + (pm - 250.4) * 100.0 / 100.0);
-    return (int)(400 + (pm - 350.4) * 100.0 / 150.0);
-}
-
 static void set_aqi_status(AirQualityData &data)
 {
     int aqi = data.aqi;
@@ -141,23 +77,31 @@ static void set_aqi_status(AirQualityData &data)
 
 #ifndef __ANDROID__
 // SSE streaming state
-static SoupSession *sse_session = NULL;
-static GCancellable *sse_cancellable = NULL;
-static GInputStream *sse_stream = NULL;
-static std::string sse_buffer;
-static std::string current_sse_station_id;
+static std::string current_sse_station_id; // Station shown on the dashboard
 
 // WAQI search async state
-static SoupSession *search_session = NULL;
 static GCancellable *search_cancellable = NULL;
 static guint64 search_generation = 0;
 #endif
 
 // Mock Data Generator
-static AirQualityData get_mock_data(const char *city)
+// Mock series are deterministic per city, so each one is generated once and
+// memoized; charts borrow the stored history instead of regenerating it.
+#define MOCK_DATA_MEMO_CAPACITY 64
+static std::map<std::string, AirQualityData> mock_data_memo;
+
+static const AirQualityData &get_mock_series(const char *city)
 {
-    AirQualityData data;
-    data.city = city;
+    auto it = mock_data_memo.find(city);
+    if (it != mock_data_memo.end())
+        return it->second;
+
+    // Borrowers only hold a series for the duration of one draw
+    if (mock_data_memo.size() >= MOCK_DATA_MEMO_CAPACITY)
+        mock_data_memo.clear();
+
+    AirQualityData &data = mock_data_memo[city];
+    data.city = NULL;
 
     // Simple hash-based randomization for consistent "mock" data per city
     unsigned int hash = 0;
@@ -179,250 +123,499 @@ static AirQualityData get_mock_data(const char *city)
     data.pm25 = (double)(data.aqi) * 0.6;
     data.pm10 = (double)(data.aqi) * 1.2;
 
-    // Generate mock history (24 points)
-    data.history.clear();
+    // Generate mock history (24 points), newest sample generated first
+    data.history.assign(24, 0);
     int current = data.aqi;
-    for (int i = 0; i < 24; i++)
+    for (int i = 23; i >= 0; i--)
     {
         // Add some random fluctuation
         int fluctuation = (my_rand() % 41) - 20; // -20 to +20
         int val = current + fluctuation;
         if (val < 0)
             val = 0;
-        data.history.insert(data.history.begin(), val);
+        data.history[i] = val;
         current = val;
     }
 
     return data;
 }
 
-// --- WAQI Live Search API Functions ---
+static AirQualityData get_mock_data(const char *city)
+{
+    AirQualityData data = get_mock_series(city);
+    data.city = city;
+    return data;
+}
 
-#ifndef __ANDROID__
-// Simple JSON helper to find a value after a key
-static const char *json_find_value(const char *json, const char *key)
+// --- HTTP Client ---
+// All libsoup traffic (search, SSE feeds, the network test page) goes through
+// one SoupSession, so requests to a host reuse its kept-alive connections
+// instead of paying a TCP + TLS handshake each time. glib-networking resumes
+// TLS sessions per server identity on its own once the session is shared.
+// Lookups go through a caching resolver, since GResolver does not cache.
+
+#define HTTP_MAX_CONNS 80
+#define HTTP_MAX_CONNS_PER_HOST 64 // SSE holds one connection per live feed
+#define HTTP_IDLE_TIMEOUT_S 90
+#define DNS_CACHE_TTL_US (300 * G_USEC_PER_SEC)
+
+typedef struct
 {
-    char search_key[256];
-    snprintf(search_key, sizeof(search_key), "\"%s\":", key);
-    const char *pos = strstr(json, search_key);
-    if (pos)
-    {
-        pos += strlen(search_key);
-        while (*pos == ' ' || *pos == '\t')
-            pos++;
-        return pos;
-    }
-    return NULL;
+    GList *addresses; // GInetAddress, owned
+    gint64 expires;
+} DnsCacheEntry;
+
+#define AQI_TYPE_CACHING_RESOLVER (aqi_caching_resolver_get_type())
+G_DECLARE_FINAL_TYPE(AqiCachingResolver, aqi_caching_resolver, AQI, CACHING_RESOLVER, GResolver)
+
+struct _AqiCachingResolver
+{
+    GResolver parent_instance;
+
+    GResolver *inner; // Resolver that was the default before us
+    GMutex lock;
+    std::map<std::string, DnsCacheEntry> *cache; // Keyed by flags + hostname
+};
+
+G_DEFINE_TYPE(AqiCachingResolver, aqi_caching_resolver, G_TYPE_RESOLVER)
+
+static GList *dns_addresses_copy(GList *addresses)
+{
+    return g_list_copy_deep(addresses, (GCopyFunc)g_object_ref, NULL);
 }
 
-// Parse integer from JSON position
-static int json_parse_int(const char *pos)
+static std::string dns_cache_key(const char *hostname, GResolverNameLookupFlags flags)
 {
-    if (!pos)
-        return 0;
-    if (*pos == '"')
-        pos++; // Skip opening quote if string
-    return atoi(pos);
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "%u:", (unsigned)flags);
+    return std::string(prefix) + hostname;
 }
 
-// Parse double from JSON position
-static double json_parse_double(const char *pos)
+static void dns_cache_clear(AqiCachingResolver *self)
 {
-    if (!pos)
-        return 0.0;
-    if (*pos == '"')
-        pos++;
-    return atof(pos);
+    g_mutex_lock(&self->lock);
+    for (auto &entry : *self->cache)
+        g_resolver_free_addresses(entry.second.addresses);
+    self->cache->clear();
+    g_mutex_unlock(&self->lock);
 }
 
-// Extract string value from JSON (up to delimiter)
-static std::string json_parse_string(const char *pos, size_t max_len = 256)
+// Returns a new copy of the cached addresses, or NULL on a miss
+static GList *dns_cache_lookup(AqiCachingResolver *self, const std::string &key)
 {
-    if (!pos)
-        return "";
-    std::string result;
-    if (*pos == '"')
-        pos++;
-    while (*pos && *pos != '"' && *pos != ',' && *pos != '}' && result.length() < max_len)
+    GList *result = NULL;
+    g_mutex_lock(&self->lock);
+    auto it = self->cache->find(key);
+    if (it != self->cache->end())
     {
-        if (*pos == '\\' && *(pos + 1))
+        if (it->second.expires > g_get_monotonic_time())
         {
-            pos++; // Skip escape
+            result = dns_addresses_copy(it->second.addresses);
+        }
+        else
+        {
+            g_resolver_free_addresses(it->second.addresses);
+            self->cache->erase(it);
         }
-        result += *pos++;
     }
+    g_mutex_unlock(&self->lock);
     return result;
 }
 
-static void waqi_parse_search_response(const char *data, gsize size, std::vector<WAQISearchResult> &results)
+static void dns_cache_store(AqiCachingResolver *self, const std::string &key, GList *addresses)
 {
-    results.clear();
-    if (!data || size == 0)
-        return;
+    g_mutex_lock(&self->lock);
+    DnsCacheEntry &entry = (*self->cache)[key];
+    if (entry.addresses)
+        g_resolver_free_addresses(entry.addresses);
+    entry.addresses = dns_addresses_copy(addresses);
+    entry.expires = g_get_monotonic_time() + DNS_CACHE_TTL_US;
+    g_mutex_unlock(&self->lock);
+}
+
+static GList *caching_resolver_lookup_by_name_with_flags(GResolver *resolver, const gchar *hostname,
+                                                         GResolverNameLookupFlags flags,
+                                                         GCancellable *cancellable, GError **error)
+{
+    AqiCachingResolver *self = AQI_CACHING_RESOLVER(resolver);
+    std::string key = dns_cache_key(hostname, flags);
+    GList *addresses = dns_cache_lookup(self, key);
+    if (addresses)
+        return addresses;
+
+    addresses = g_resolver_lookup_by_name_with_flags(self->inner, hostname, flags, cancellable, error);
+    if (addresses)
+        dns_cache_store(self, key, addresses);
+    return addresses;
+}
+
+typedef struct
+{
+    AqiCachingResolver *resolver;
+    std::string key;
+} DnsLookupContext;
+
+static void dns_lookup_context_free(gpointer data)
+{
+    DnsLookupContext *ctx = (DnsLookupContext *)data;
+    g_object_unref(ctx->resolver);
+    delete ctx;
+}
+
+static void on_inner_lookup_by_name_complete(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GTask *task = G_TASK(user_data);
+    DnsLookupContext *ctx = (DnsLookupContext *)g_task_get_task_data(task);
+
+    GError *error = NULL;
+    GList *addresses = g_resolver_lookup_by_name_with_flags_finish(G_RESOLVER(source), result, &error);
+    if (addresses)
+    {
+        dns_cache_store(ctx->resolver, ctx->key, addresses);
+        g_task_return_pointer(task, addresses, (GDestroyNotify)g_resolver_free_addresses);
+    }
+    else
+    {
+        g_task_return_error(task, error);
+    }
+    g_object_unref(task);
+}
 
-    const char *results_start = strstr(data, "\"results\":[");
-    if (!results_start)
+static void caching_resolver_lookup_by_name_with_flags_async(GResolver *resolver, const gchar *hostname,
+                                                             GResolverNameLookupFlags flags,
+                                                             GCancellable *cancellable,
+                                                             GAsyncReadyCallback callback, gpointer user_data)
+{
+    AqiCachingResolver *self = AQI_CACHING_RESOLVER(resolver);
+    GTask *task = g_task_new(resolver, cancellable, callback, user_data);
+
+    DnsLookupContext *ctx = new DnsLookupContext();
+    ctx->resolver = (AqiCachingResolver *)g_object_ref(self);
+    ctx->key = dns_cache_key(hostname, flags);
+    g_task_set_task_data(task, ctx, dns_lookup_context_free);
+
+    GList *addresses = dns_cache_lookup(self, ctx->key);
+    if (addresses)
+    {
+        g_task_return_pointer(task, addresses, (GDestroyNotify)g_resolver_free_addresses);
+        g_object_unref(task);
         return;
-    results_start += 11; // Skip "results":[
+    }
+
+    g_resolver_lookup_by_name_with_flags_async(self->inner, hostname, flags, cancellable,
+                                               on_inner_lookup_by_name_complete, task);
+}
+
+static GList *caching_resolver_lookup_by_name_with_flags_finish(GResolver *resolver, GAsyncResult *result,
+                                                                GError **error)
+{
+    return (GList *)g_task_propagate_pointer(G_TASK(result), error);
+}
+
+static GList *caching_resolver_lookup_by_name(GResolver *resolver, const gchar *hostname,
+                                              GCancellable *cancellable, GError **error)
+{
+    return caching_resolver_lookup_by_name_with_flags(resolver, hostname, G_RESOLVER_NAME_LOOKUP_FLAGS_DEFAULT,
+                                                      cancellable, error);
+}
+
+static void caching_resolver_lookup_by_name_async(GResolver *resolver, const gchar *hostname,
+                                                  GCancellable *cancellable, GAsyncReadyCallback callback,
+                                                  gpointer user_data)
+{
+    caching_resolver_lookup_by_name_with_flags_async(resolver, hostname, G_RESOLVER_NAME_LOOKUP_FLAGS_DEFAULT,
+                                                     cancellable, callback, user_data);
+}
+
+// Reverse, SRV and record lookups are not cached and go straight to the
+// inner resolver. The results are handed back through a GTask so they are
+// reported with this resolver as the source object.
+
+static void on_inner_lookup_by_address_complete(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GTask *task = G_TASK(user_data);
+    GError *error = NULL;
+    gchar *name = g_resolver_lookup_by_address_finish(G_RESOLVER(source), result, &error);
+    if (name)
+        g_task_return_pointer(task, name, g_free);
+    else
+        g_task_return_error(task, error);
+    g_object_unref(task);
+}
+
+static gchar *caching_resolver_lookup_by_address(GResolver *resolver, GInetAddress *address,
+                                                 GCancellable *cancellable, GError **error)
+{
+    return g_resolver_lookup_by_address(AQI_CACHING_RESOLVER(resolver)->inner, address, cancellable, error);
+}
+
+static void caching_resolver_lookup_by_address_async(GResolver *resolver, GInetAddress *address,
+                                                     GCancellable *cancellable, GAsyncReadyCallback callback,
+                                                     gpointer user_data)
+{
+    GTask *task = g_task_new(resolver, cancellable, callback, user_data);
+    g_resolver_lookup_by_address_async(AQI_CACHING_RESOLVER(resolver)->inner, address, cancellable,
+                                       on_inner_lookup_by_address_complete, task);
+}
+
+static gchar *caching_resolver_lookup_by_address_finish(GResolver *resolver, GAsyncResult *result, GError **error)
+{
+    return (gchar *)g_task_propagate_pointer(G_TASK(result), error);
+}
+
+static void dns_records_free(gpointer records)
+{
+    g_list_free_full((GList *)records, (GDestroyNotify)g_variant_unref);
+}
+
+static void on_inner_lookup_records_complete(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GTask *task = G_TASK(user_data);
+    GError *error = NULL;
+    GList *records = g_resolver_lookup_records_finish(G_RESOLVER(source), result, &error);
+    if (records)
+        g_task_return_pointer(task, records, dns_records_free);
+    else
+        g_task_return_error(task, error);
+    g_object_unref(task);
+}
+
+static GList *caching_resolver_lookup_records(GResolver *resolver, const gchar *rrname, GResolverRecordType type,
+                                              GCancellable *cancellable, GError **error)
+{
+    return g_resolver_lookup_records(AQI_CACHING_RESOLVER(resolver)->inner, rrname, type, cancellable, error);
+}
+
+static void caching_resolver_lookup_records_async(GResolver *resolver, const gchar *rrname,
+                                                  GResolverRecordType type, GCancellable *cancellable,
+                                                  GAsyncReadyCallback callback, gpointer user_data)
+{
+    GTask *task = g_task_new(resolver, cancellable, callback, user_data);
+    g_resolver_lookup_records_async(AQI_CACHING_RESOLVER(resolver)->inner, rrname, type, cancellable,
+                                    on_inner_lookup_records_complete, task);
+}
+
+static GList *caching_resolver_lookup_records_finish(GResolver *resolver, GAsyncResult *result, GError **error)
+{
+    return (GList *)g_task_propagate_pointer(G_TASK(result), error);
+}
 
-    const char *pos = results_start;
-    while (pos && *pos)
+// GResolver passes lookup_service an already built "_service._proto.domain"
+// name, which the public API only accepts as an SRV record query.
+static GList *dns_srv_targets_from_records(GList *records)
+{
+    GList *targets = NULL;
+    for (GList *l = records; l; l = l->next)
     {
-        const char *obj_start = strchr(pos, '{');
-        if (!obj_start)
-            break;
+        guint16 priority, weight, port;
+        const gchar *target;
+        g_variant_get((GVariant *)l->data, "(qqq&s)", &priority, &weight, &port, &target);
+        targets = g_list_prepend(targets, g_srv_target_new(target, port, priority, weight));
+    }
+    dns_records_free(records);
+    return g_srv_target_list_sort(targets);
+}
 
-        const char *obj_end = obj_start + 1;
-        int brace_count = 1;
-        while (*obj_end && brace_count > 0)
-        {
-            if (*obj_end == '{')
-                brace_count++;
-            else if (*obj_end == '}')
-                brace_count--;
-            obj_end++;
-        }
-        if (brace_count != 0)
-            break;
+static void srv_targets_free(gpointer targets)
+{
+    g_list_free_full((GList *)targets, (GDestroyNotify)g_srv_target_free);
+}
 
-        WAQISearchResult result;
+static void on_inner_lookup_service_complete(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GTask *task = G_TASK(user_data);
+    GError *error = NULL;
+    GList *records = g_resolver_lookup_records_finish(G_RESOLVER(source), result, &error);
+    if (records)
+        g_task_return_pointer(task, dns_srv_targets_from_records(records), srv_targets_free);
+    else
+        g_task_return_error(task, error);
+    g_object_unref(task);
+}
 
-        const char *x_pos = json_find_value(obj_start, "x");
-        int x_val = 0;
-        if (x_pos)
-            x_val = json_parse_int(x_pos);
+static GList *caching_resolver_lookup_service(GResolver *resolver, const gchar *rrname,
+                                              GCancellable *cancellable, GError **error)
+{
+    GList *records = g_resolver_lookup_records(AQI_CACHING_RESOLVER(resolver)->inner, rrname,
+                                               G_RESOLVER_RECORD_SRV, cancellable, error);
+    return records ? dns_srv_targets_from_records(records) : NULL;
+}
 
-        const char *s_pos = strstr(obj_start, "\"s\":{");
-        if (s_pos && s_pos < obj_end)
-        {
-            const char *a_pos = strstr(s_pos, "\"a\":\"");
-            if (a_pos && a_pos < obj_end)
-            {
-                a_pos += 5;
-                result.aqi = atoi(a_pos);
-                result.has_aqi = (result.aqi > 0 || *a_pos == '0');
-                if (*a_pos == '-')
-                    result.has_aqi = false;
-            }
+static void caching_resolver_lookup_service_async(GResolver *resolver, const gchar *rrname,
+                                                  GCancellable *cancellable, GAsyncReadyCallback callback,
+                                                  gpointer user_data)
+{
+    GTask *task = g_task_new(resolver, cancellable, callback, user_data);
+    g_resolver_lookup_records_async(AQI_CACHING_RESOLVER(resolver)->inner, rrname, G_RESOLVER_RECORD_SRV,
+                                    cancellable, on_inner_lookup_service_complete, task);
+}
 
-            const char *n_pos = strstr(s_pos, "\"n\":[\"");
-            if (n_pos && n_pos < obj_end)
-            {
-                n_pos += 6;
-                result.station_name = json_parse_string(n_pos);
-            }
+static GList *caching_resolver_lookup_service_finish(GResolver *resolver, GAsyncResult *result, GError **error)
+{
+    return (GList *)g_task_propagate_pointer(G_TASK(result), error);
+}
 
-            const char *u_pos = strstr(s_pos, "\"u\":\"");
-            if (u_pos && u_pos < obj_end)
-            {
-                u_pos += 5;
-                result.url = json_parse_string(u_pos);
-
-                const char *at_pos = strstr(result.url.c_str(), "@");
-                if (at_pos)
-                {
-                    result.station_id = at_pos + 1;
-                }
-                else if (x_val != 0)
-                {
-                    result.station_id = std::to_string(x_val > 0 ? x_val : -x_val);
-                }
-                else
-                {
-                    result.station_id = result.url;
-                }
-            }
-            else if (x_val != 0)
-            {
-                result.station_id = std::to_string(x_val > 0 ? x_val : -x_val);
-            }
-        }
+static void on_caching_resolver_reload(GResolver *resolver, gpointer user_data)
+{
+    dns_cache_clear(AQI_CACHING_RESOLVER(resolver));
+}
 
-        if (s_pos)
-        {
-            const char *after_s = strchr(s_pos + 5, '}');
-            if (after_s && after_s < obj_end)
-            {
-                const char *n_arr = strstr(after_s, "\"n\":[");
-                if (n_arr && n_arr < obj_end)
-                {
-                    const char *p = n_arr + 5;
-                    std::string address;
-                    int parts = 0;
-
-                    while (p && p < obj_end && *p)
-                    {
-                        while (p < obj_end && *p && *p != '"' && *p != ']')
-                            p++;
-                        if (p >= obj_end || !*p || *p == ']')
-                            break;
-                        if (*p == '"')
-                        {
-                            std::string part = json_parse_string(p, 512);
-                            if (!part.empty())
-                            {
-                                if (parts++ > 0)
-                                    address += " > ";
-                                address += part;
-                            }
-                            p++;
-                            while (p < obj_end && *p)
-                            {
-                                if (*p == '\\' && *(p + 1))
-                                {
-                                    p += 2;
-                                    continue;
-                                }
-                                if (*p == '"')
-                                {
-                                    p++;
-                                    break;
-                                }
-                                p++;
-                            }
-                        }
-                    }
-                    if (!address.empty())
-                        result.full_address = address;
-                }
-            }
-        }
+static void on_network_changed(GNetworkMonitor *monitor, gboolean network_available, gpointer user_data)
+{
+    dns_cache_clear(AQI_CACHING_RESOLVER(user_data));
+}
 
-        const char *c_pos = json_find_value(obj_start, "c");
-        if (c_pos && c_pos < obj_end)
-            result.country = json_parse_string(c_pos);
+static void aqi_caching_resolver_finalize(GObject *object)
+{
+    AqiCachingResolver *self = AQI_CACHING_RESOLVER(object);
+    dns_cache_clear(self);
+    delete self->cache;
+    g_mutex_clear(&self->lock);
+    g_clear_object(&self->inner);
+    G_OBJECT_CLASS(aqi_caching_resolver_parent_class)->finalize(object);
+}
 
-        const char *src_pos = json_find_value(obj_start, "$");
-        if (src_pos && src_pos < obj_end)
-            result.source = json_parse_string(src_pos);
+static void aqi_caching_resolver_class_init(AqiCachingResolverClass *klass)
+{
+    GResolverClass *resolver_class = G_RESOLVER_CLASS(klass);
+    resolver_class->lookup_by_name = caching_resolver_lookup_by_name;
+    resolver_class->lookup_by_name_async = caching_resolver_lookup_by_name_async;
+    resolver_class->lookup_by_name_finish = caching_resolver_lookup_by_name_with_flags_finish;
+    resolver_class->lookup_by_name_with_flags = caching_resolver_lookup_by_name_with_flags;
+    resolver_class->lookup_by_name_with_flags_async = caching_resolver_lookup_by_name_with_flags_async;
+    resolver_class->lookup_by_name_with_flags_finish = caching_resolver_lookup_by_name_with_flags_finish;
+    resolver_class->lookup_by_address = caching_resolver_lookup_by_address;
+    resolver_class->lookup_by_address_async = caching_resolver_lookup_by_address_async;
+    resolver_class->lookup_by_address_finish = caching_resolver_lookup_by_address_finish;
+    resolver_class->lookup_service = caching_resolver_lookup_service;
+    resolver_class->lookup_service_async = caching_resolver_lookup_service_async;
+    resolver_class->lookup_service_finish = caching_resolver_lookup_service_finish;
+    resolver_class->lookup_records = caching_resolver_lookup_records;
+    resolver_class->lookup_records_async = caching_resolver_lookup_records_async;
+    resolver_class->lookup_records_finish = caching_resolver_lookup_records_finish;
+
+    G_OBJECT_CLASS(klass)->finalize = aqi_caching_resolver_finalize;
+}
 
-        if (!result.station_id.empty() && !result.station_name.empty())
-        {
-            results.push_back(result);
-        }
+static void aqi_caching_resolver_init(AqiCachingResolver *self)
+{
+    self->inner = NULL;
+    g_mutex_init(&self->lock);
+    self->cache = new std::map<std::string, DnsCacheEntry>();
+}
+
+// Which traffic wins when requests queue for a connection slot
+typedef enum
+{
+    HTTP_PRIORITY_INTERACTIVE, // Search as you type
+    HTTP_PRIORITY_STREAM,      // Live SSE feeds
+    HTTP_PRIORITY_BACKGROUND,  // Diagnostics, prefetch
+} HttpPriority;
+
+static SoupSession *http_session = NULL;
+#ifdef __ANDROID__
+static void android_tls_preload_wait();
+#endif
+
+static void http_client_install_resolver()
+{
+    GResolver *inner = g_resolver_get_default();
+    if (AQI_IS_CACHING_RESOLVER(inner))
+    {
+        g_object_unref(inner);
+        return;
+    }
+
+    AqiCachingResolver *resolver = AQI_CACHING_RESOLVER(g_object_new(AQI_TYPE_CACHING_RESOLVER, NULL));
+    resolver->inner = inner;
+    g_signal_connect(resolver, "reload", G_CALLBACK(on_caching_resolver_reload), NULL);
+    g_signal_connect_object(g_network_monitor_get_default(), "network-changed", G_CALLBACK(on_network_changed),
+                            resolver, (GConnectFlags)0);
+    g_resolver_set_default(G_RESOLVER(resolver));
+    g_object_unref(resolver);
+}
+
+static SoupSession *http_client_session()
+{
+    if (!http_session)
+    {
+#ifdef __ANDROID__
+        android_tls_preload_wait();
+#endif
+        http_client_install_resolver();
+
+        // No I/O "timeout": SSE streams legitimately sit idle between events.
+        // Idle keep-alive connections are closed after HTTP_IDLE_TIMEOUT_S.
+        http_session = soup_session_new_with_options(
+            "max-conns", HTTP_MAX_CONNS,
+            "max-conns-per-host", HTTP_MAX_CONNS_PER_HOST,
+            "idle-timeout", HTTP_IDLE_TIMEOUT_S,
+            "user-agent", "mygtk4app ",
+            NULL);
+    }
+    return http_session;
+}
+
+// Creates a request whose message priority decides its place in the
+// session's queue; use http_client_io_priority for the matching I/O priority.
+static SoupMessage *http_client_message_new(const char *method, const char *url, HttpPriority priority)
+{
+    SoupMessage *msg = soup_message_new(method, url);
+    if (!msg)
+        return NULL;
 
-        pos = obj_end;
+    switch (priority)
+    {
+    case HTTP_PRIORITY_INTERACTIVE:
+        soup_message_set_priority(msg, SOUP_MESSAGE_PRIORITY_HIGH);
+        break;
+    case HTTP_PRIORITY_STREAM:
+        soup_message_set_priority(msg, SOUP_MESSAGE_PRIORITY_NORMAL);
+        break;
+    case HTTP_PRIORITY_BACKGROUND:
+        soup_message_set_priority(msg, SOUP_MESSAGE_PRIORITY_LOW);
+        break;
+    }
+    return msg;
+}
+
+static int http_client_io_priority(HttpPriority priority)
+{
+    switch (priority)
+    {
+    case HTTP_PRIORITY_INTERACTIVE:
+        return G_PRIORITY_HIGH;
+    case HTTP_PRIORITY_BACKGROUND:
+        return G_PRIORITY_LOW;
+    default:
+        return G_PRIORITY_DEFAULT;
     }
 }
 
+// --- WAQI Live Search API Functions ---
+
+#ifndef __ANDROID__
 static void update_aqi_display(GtkBuilder *builder);
 static void populate_search_dropdown(GtkBuilder *builder);
 static void waqi_fetch_station_data(const std::string &station_id, WAQIStationData &station_data);
+static bool waqi_station_is_current(const std::string &station_id);
+static void on_city_entry_changed(GtkEditable *editable, gpointer user_data);
 
-static void select_search_result_by_index(GtkBuilder *builder, int idx)
+// `result` must outlive the call; its batch is not referenced here
+static void select_search_result(GtkBuilder *builder, const WAQISearchResult &result)
 {
     if (!builder)
         return;
-    if (idx < 0 || idx >= (int)search_results.size())
-        return;
 
-    const WAQISearchResult &result = search_results[idx];
-    g_print("Selected station: %s (ID: %s)\n", result.station_name.c_str(), result.station_id.c_str());
+    g_print("Selected station: %s (ID: %s)\n", result.station_name, result.station_id);
 
+    // Filling in the entry is not typing; don't let it schedule a search
     GObject *entry_obj = gtk_builder_get_object(builder, "city_entry");
     if (entry_obj)
     {
-        gtk_editable_set_text(GTK_EDITABLE(entry_obj), result.station_name.c_str());
+        g_signal_handlers_block_by_func(entry_obj, (gpointer)on_city_entry_changed, builder);
+        gtk_editable_set_text(GTK_EDITABLE(entry_obj), result.station_name);
+        g_signal_handlers_unblock_by_func(entry_obj, (gpointer)on_city_entry_changed, builder);
     }
 
     GObject *dropdown_obj = gtk_builder_get_object(builder, "search_dropdown");
@@ -433,8 +626,12 @@ static void select_search_result_by_index(GtkBuilder *builder, int idx)
 
     g_current_builder = builder;
 
+    // Reselecting the station already on the dashboard keeps its live data
+    if (waqi_station_is_current(result.station_id))
+        return;
+
     g_free(g_api_city_name);
-    g_api_city_name = g_strdup(result.station_name.c_str());
+    g_api_city_name = g_strdup(result.station_name);
     current_aqi_data.city = g_api_city_name;
     current_aqi_data.aqi = result.has_aqi ? result.aqi : 0;
     current_aqi_data.pm25 = current_aqi_data.aqi * 0.6;
@@ -452,1553 +649,4602 @@ static void select_search_result_by_index(GtkBuilder *builder, int idx)
     waqi_fetch_station_data(result.station_id, current_station_data);
 }
 
+static void select_search_result_by_index(GtkBuilder *builder, int idx)
+{
+    if (!search_results || idx < 0 || idx >= (int)search_results->results.size())
+        return;
+    select_search_result(builder, search_results->results[idx]);
+}
+
 typedef enum
 {
     SEARCH_MODE_DROPDOWN = 0,
     SEARCH_MODE_AUTO_SELECT_FIRST = 1,
 } WAQISearchMode;
 
+// --- WAQI Search Cache ---
+// Responses are cached by normalized query: an LRU in memory, persisted to
+// a small key file under the user cache dir. Fresh entries are served
+// without touching the network; stale ones are shown immediately and
+// revalidated in the background with If-None-Match / If-Modified-Since.
+
+#define SEARCH_CACHE_CAPACITY 64
+#define SEARCH_CACHE_TTL_USEC (10 * G_TIME_SPAN_MINUTE)
+#define SEARCH_CACHE_MAX_AGE_USEC (7 * G_TIME_SPAN_DAY)
+
 typedef struct
 {
-    GtkBuilder *builder;
-    SoupMessage *msg;
-    guint64 generation;
-    WAQISearchMode mode;
-    gchar *query;
-} WAQISearchContext;
-
-static void waqi_search_context_free(WAQISearchContext *ctx)
+    std::string key;
+    GBytes *body;
+    gint64 fetched_at; // g_get_real_time()
+    std::string etag;
+    std::string last_modified;
+} WAQISearchCacheEntry;
+
+// Most recently used first
+static std::list<WAQISearchCacheEntry> search_cache;
+static std::map<std::string, std::list<WAQISearchCacheEntry>::iterator> search_cache_index;
+static bool search_cache_loaded = false;
+static guint search_cache_save_id = 0;
+
+// Case-folded, NFC-normalized, with whitespace trimmed and collapsed, so
+// "Delhi", "delhi " and "DELHI" share an entry.
+static std::string search_cache_normalize(const char *query)
 {
-    if (!ctx)
-        return;
-    if (ctx->msg)
-        g_object_unref(ctx->msg);
-    if (ctx->builder)
-        g_object_unref(ctx->builder);
-    g_free(ctx->query);
-    g_free(ctx);
+    std::string key;
+    if (!query)
+        return key;
+
+    char *folded = g_utf8_casefold(query, -1);
+    char *normalized = g_utf8_normalize(folded, -1, G_NORMALIZE_DEFAULT_COMPOSE);
+    g_free(folded);
+    if (!normalized)
+        return key;
+
+    bool pending_space = false;
+    for (const char *p = normalized; *p; p++)
+    {
+        if (g_ascii_isspace(*p))
+        {
+            pending_space = !key.empty();
+            continue;
+        }
+        if (pending_space)
+            key += ' ';
+        pending_space = false;
+        key += *p;
+    }
+    g_free(normalized);
+    return key;
 }
 
-static void on_waqi_search_complete(GObject *source, GAsyncResult *result, gpointer user_data)
+static char *search_cache_path()
 {
-    WAQISearchContext *ctx = (WAQISearchContext *)user_data;
-    GError *error = NULL;
-    GBytes *response = soup_session_send_and_read_finish(SOUP_SESSION(source), result, &error);
+    return g_build_filename(g_get_user_cache_dir(), "aqi-dashboard", "search-cache.ini", NULL);
+}
 
-    if (!ctx || ctx->generation != search_generation)
+static void search_cache_evict()
+{
+    while (search_cache.size() > SEARCH_CACHE_CAPACITY)
     {
-        if (response)
-            g_bytes_unref(response);
-        if (error)
-            g_clear_error(&error);
-        waqi_search_context_free(ctx);
-        return;
+        WAQISearchCacheEntry &oldest = search_cache.back();
+        search_cache_index.erase(oldest.key);
+        g_bytes_unref(oldest.body);
+        search_cache.pop_back();
     }
+}
 
-    if (error)
+// Inserts or replaces an entry as the most recently used. Takes ownership of body.
+static void search_cache_store(const std::string &key, GBytes *body, gint64 fetched_at,
+                               const char *etag, const char *last_modified)
+{
+    auto it = search_cache_index.find(key);
+    if (it != search_cache_index.end())
     {
-        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-        {
-            g_printerr("WAQI search failed: %s\n", error->message);
-        }
-        g_clear_error(&error);
-        if (response)
-            g_bytes_unref(response);
+        g_bytes_unref(it->second->body);
+        search_cache.erase(it->second);
+        search_cache_index.erase(it);
+    }
 
-        if (ctx->mode == SEARCH_MODE_AUTO_SELECT_FIRST && ctx->query && *ctx->query)
-        {
-            current_aqi_data = get_mock_data(ctx->query);
-            update_aqi_display(ctx->builder);
-        }
-        waqi_search_context_free(ctx);
+    WAQISearchCacheEntry entry;
+    entry.key = key;
+    entry.body = body;
+    entry.fetched_at = fetched_at;
+    entry.etag = etag ? etag : "";
+    entry.last_modified = last_modified ? last_modified : "";
+    search_cache.push_front(std::move(entry));
+    search_cache_index[key] = search_cache.begin();
+
+    search_cache_evict();
+}
+
+static void search_cache_load()
+{
+    search_cache_loaded = true;
+
+    char *path = search_cache_path();
+    GKeyFile *kf = g_key_file_new();
+    if (!g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, NULL))
+    {
+        g_key_file_free(kf);
+        g_free(path);
         return;
     }
 
-    gsize size = 0;
-    const char *data = (const char *)g_bytes_get_data(response, &size);
-    waqi_parse_search_response(data, size, search_results);
-    g_bytes_unref(response);
+    gint64 now = g_get_real_time();
+    gsize n_groups = 0;
+    char **groups = g_key_file_get_groups(kf, &n_groups);
 
-    if (ctx->mode == SEARCH_MODE_AUTO_SELECT_FIRST)
+    // Groups are written least recently used first
+    for (gsize i = 0; i < n_groups; i++)
     {
-        if (!search_results.empty())
-        {
-            select_search_result_by_index(ctx->builder, 0);
-        }
-        else if (ctx->query && *ctx->query)
+        char *query = g_key_file_get_string(kf, groups[i], "query", NULL);
+        char *body = g_key_file_get_string(kf, groups[i], "body", NULL);
+        gint64 fetched_at = g_key_file_get_int64(kf, groups[i], "fetched", NULL);
+        char *etag = g_key_file_get_string(kf, groups[i], "etag", NULL);
+        char *last_modified = g_key_file_get_string(kf, groups[i], "last_modified", NULL);
+
+        if (query && body && now - fetched_at < SEARCH_CACHE_MAX_AGE_USEC)
         {
-            current_aqi_data = get_mock_data(ctx->query);
-            update_aqi_display(ctx->builder);
+            size_t len = strlen(body);
+            search_cache_store(query, g_bytes_new_take(body, len), fetched_at, etag, last_modified);
+            body = NULL;
         }
-    }
-    else
-    {
-        populate_search_dropdown(ctx->builder);
+
+        g_free(query);
+        g_free(body);
+        g_free(etag);
+        g_free(last_modified);
     }
 
-    waqi_search_context_free(ctx);
+    g_strfreev(groups);
+    g_key_file_free(kf);
+    g_free(path);
 }
 
-static void waqi_search_cities_async(const char *query, GtkBuilder *builder, WAQISearchMode mode)
+static void on_cache_file_saved(GObject *source, GAsyncResult *result, gpointer user_data)
 {
-    if (!builder)
-        return;
-
-    if (!query || strlen(query) < 2)
+    GError *error = NULL;
+    if (!g_file_replace_contents_finish(G_FILE(source), result, NULL, &error))
     {
-        search_results.clear();
-        populate_search_dropdown(builder);
-        return;
+        g_printerr("Failed to write %s: %s\n", g_file_peek_path(G_FILE(source)), error->message);
+        g_clear_error(&error);
     }
+}
 
-    if (search_cancellable)
-    {
-        g_cancellable_cancel(search_cancellable);
-        g_clear_object(&search_cancellable);
-    }
+static gboolean search_cache_save(gpointer user_data)
+{
+    search_cache_save_id = 0;
 
-    if (!search_session)
+    GKeyFile *kf = g_key_file_new();
+    int n = 0;
+    for (auto it = search_cache.rbegin(); it != search_cache.rend(); ++it)
     {
-        search_session = soup_session_new();
+        gsize size = 0;
+        const char *data = (const char *)g_bytes_get_data(it->body, &size);
+        // Key file values are strings; skip anything that is not plain UTF-8 text
+        if (!g_utf8_validate(data, size, NULL) || memchr(data, '\0', size))
+            continue;
+
+        char group[32];
+        snprintf(group, sizeof(group), "entry%d", n++);
+        std::string body(data, size);
+        g_key_file_set_string(kf, group, "query", it->key.c_str());
+        g_key_file_set_int64(kf, group, "fetched", it->fetched_at);
+        g_key_file_set_string(kf, group, "etag", it->etag.c_str());
+        g_key_file_set_string(kf, group, "last_modified", it->last_modified.c_str());
+        g_key_file_set_string(kf, group, "body", body.c_str());
     }
 
-    search_generation++;
-    search_cancellable = g_cancellable_new();
-
-    char *encoded_query = g_uri_escape_string(query, NULL, TRUE);
-    char url[512];
-    snprintf(url, sizeof(url), "https://search.waqi.info/nsearch/world/%s?n=10", encoded_query);
-    g_free(encoded_query);
-
-    SoupMessage *msg = soup_message_new("GET", url);
-    if (!msg)
-        return;
-
-    WAQISearchContext *ctx = (WAQISearchContext *)g_malloc0(sizeof(WAQISearchContext));
-    ctx->builder = (GtkBuilder *)g_object_ref(builder);
-    ctx->msg = (SoupMessage *)g_object_ref(msg);
-    ctx->generation = search_generation;
-    ctx->mode = mode;
-    ctx->query = g_strdup(query);
-
-    soup_session_send_and_read_async(
-        search_session,
-        msg,
-        G_PRIORITY_DEFAULT,
-        search_cancellable,
-        on_waqi_search_complete,
-        ctx);
-
-    g_object_unref(msg);
+    gsize length = 0;
+    char *contents = g_key_file_to_data(kf, &length, NULL);
+    g_key_file_free(kf);
+
+    char *path = search_cache_path();
+    char *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+
+    GFile *file = g_file_new_for_path(path);
+    GBytes *bytes = g_bytes_new_take(contents, length);
+    g_file_replace_contents_bytes_async(file, bytes, NULL, FALSE, G_FILE_CREATE_PRIVATE, NULL,
+                                        on_cache_file_saved, NULL);
+    g_bytes_unref(bytes);
+    g_object_unref(file);
+    g_free(dir);
+    g_free(path);
+    return G_SOURCE_REMOVE;
 }
 
-static void sse_read_next_chunk(GInputStream *stream);
+static void search_cache_schedule_save()
+{
+    if (search_cache_save_id == 0)
+        search_cache_save_id = g_timeout_add_seconds(2, search_cache_save, NULL);
+}
 
-static void parse_sse_event(const char *json_data, size_t len)
+// Returns the entry for key (promoting it to most recently used) or NULL.
+static WAQISearchCacheEntry *search_cache_lookup(const std::string &key)
 {
-    const char *type_pos = strstr(json_data, "\"type\":\"");
-    if (!type_pos)
-        return;
+    if (!search_cache_loaded)
+        search_cache_load();
 
-    type_pos += 8;
+    auto it = search_cache_index.find(key);
+    if (it == search_cache_index.end())
+        return NULL;
 
-    if (strncmp(type_pos, "meta\"", 5) == 0)
-    {
-        const char *name_pos = strstr(json_data, "\"name\":\"");
-        if (name_pos)
-        {
-            name_pos += 8;
-            current_station_data.station_name = json_parse_string(name_pos);
-        }
+    search_cache.splice(search_cache.begin(), search_cache, it->second);
+    return &search_cache.front();
+}
 
-        const char *geo_pos = strstr(json_data, "\"geo\":[");
-        if (geo_pos)
-        {
-            geo_pos += 7;
-            current_station_data.latitude = atof(geo_pos);
-            const char *comma = strchr(geo_pos, ',');
-            if (comma)
-                current_station_data.longitude = atof(comma + 1);
-        }
+static bool search_cache_is_fresh(const WAQISearchCacheEntry *entry)
+{
+    return g_get_real_time() - entry->fetched_at < SEARCH_CACHE_TTL_USEC;
+}
 
-        const char *feed_pos = strstr(json_data, "\"feed\":{");
-        if (feed_pos)
-        {
-            const char *pm25_pos = strstr(feed_pos, "\"pm25\":[");
-            if (pm25_pos)
-            {
-                const char *comma = strchr(pm25_pos + 8, ',');
-                if (comma)
-                    current_station_data.pm25 = atof(comma + 1) / 100.0;
-            }
+// True if a search for query can be answered from the cache without waiting
+// on the network, i.e. it is worth skipping the typing debounce.
+static bool waqi_search_is_cached(const char *query)
+{
+    if (!query || strlen(query) < 2)
+        return false;
+    return search_cache_lookup(search_cache_normalize(query)) != NULL;
+}
 
-            const char *pm10_pos = strstr(feed_pos, "\"pm10\":[");
-            if (pm10_pos)
-            {
-                const char *comma = strchr(pm10_pos + 8, ',');
-                if (comma)
-                    current_station_data.pm10 = atof(comma + 1) / 100.0;
-            }
+// --- Station Prefix Index ---
+// Every station seen in a search response is remembered in a compact
+// on-disk index: records sorted by station id, a sorted array of normalized
+// prefix keys (name, each word of the name, each address part) and one
+// string arena. The file is mmapped at startup and queried in place with
+// binary search; stations seen since the last rebuild live in a small
+// in-memory table until the index is rewritten.
 
-            const char *o3_pos = strstr(feed_pos, "\"o3\":[");
-            if (o3_pos)
-            {
-                const char *comma = strchr(o3_pos + 6, ',');
-                if (comma)
-                    current_station_data.o3 = atof(comma + 1) / 100.0;
-            }
+#define STATION_INDEX_MAGIC 0x58494141 // "AAIX"
+#define STATION_INDEX_VERSION 1
+#define STATION_INDEX_MIN_HITS 5
+#define STATION_INDEX_HAS_AQI 1u
 
-            const char *no2_pos = strstr(feed_pos, "\"no2\":[");
-            if (no2_pos)
-            {
-                const char *comma = strchr(no2_pos + 7, ',');
-                if (comma)
-                    current_station_data.no2 = atof(comma + 1) / 100.0;
-            }
+typedef struct
+{
+    guint32 magic;
+    guint32 version;
+    guint32 n_records;
+    guint32 n_keys;
+    guint32 arena_size;
+} StationIndexHeader;
+
+// String fields are offsets of NUL-terminated strings in the arena
+typedef struct
+{
+    guint32 station_id;
+    guint32 station_name;
+    guint32 full_address;
+    guint32 url;
+    guint32 country;
+    guint32 source;
+    gint32 aqi;
+    guint32 flags;
+    guint32 rank; // Position in the response the station was last seen in
+} StationIndexRecord;
 
-            const char *co_pos = strstr(feed_pos, "\"co\":[");
-            if (co_pos)
-            {
-                const char *comma = strchr(co_pos + 6, ',');
-                if (comma)
-                    current_station_data.co = atof(comma + 1) / 100.0;
-            }
+typedef struct
+{
+    guint32 key;
+    guint32 record;
+} StationIndexKey;
 
-            const char *so2_pos = strstr(feed_pos, "\"so2\":[");
-            if (so2_pos)
-            {
-                const char *comma = strchr(so2_pos + 7, ',');
-                if (comma)
-                    current_station_data.so2 = atof(comma + 1) / 100.0;
-            }
-        }
+// Pending results point into a search batch held in station_index_batches
+typedef struct
+{
+    WAQISearchResult result;
+    guint32 rank;
+    std::vector<std::string> keys;
+} StationIndexPending;
 
-        if (current_station_data.pm25 > 0)
-        {
-            current_station_data.aqi = calculate_aqi_from_pm25(current_station_data.pm25);
-        }
+typedef struct
+{
+    WAQISearchResult result;
+    guint32 rank;
+    bool name_match; // Matched on the start of the station name
+} StationIndexHit;
+
+static GBytes *station_index_data = NULL; // Mapped file or last rebuilt buffer
+static const StationIndexHeader *station_index_header = NULL;
+static const StationIndexRecord *station_index_records = NULL;
+static const StationIndexKey *station_index_keys = NULL;
+static const char *station_index_arena = NULL;
+static std::map<std::string, StationIndexPending> station_index_pending; // By station id
+static std::vector<WAQISearchBatch *> station_index_batches;             // Owning the pending strings
+static guint station_index_save_id = 0;
+
+static char *station_index_path()
+{
+    return g_build_filename(g_get_user_cache_dir(), "aqi-dashboard", "stations.idx", NULL);
+}
 
-        current_station_data.has_data = true;
-    }
-    else if (strncmp(type_pos, "instant\"", 8) == 0)
+// Points the index at `data` if its header, size and arena terminator are
+// well-formed; takes ownership. Nothing else is read, so attaching costs the
+// same whatever the index holds: the offsets in keys and records are checked
+// by the accessors below when a query reaches them.
+static bool station_index_attach(GBytes *data)
+{
+    gsize size = 0;
+    const char *base = (const char *)g_bytes_get_data(data, &size);
+    const StationIndexHeader *h = (const StationIndexHeader *)base;
+
+    bool valid = size >= sizeof(StationIndexHeader) && h->magic == STATION_INDEX_MAGIC &&
+                 h->version == STATION_INDEX_VERSION && h->arena_size > 0 &&
+                 size == sizeof(StationIndexHeader) + (gsize)h->n_records * sizeof(StationIndexRecord) +
+                             (gsize)h->n_keys * sizeof(StationIndexKey) + h->arena_size &&
+                 base[size - 1] == '\0';
+    if (!valid)
     {
+        g_bytes_unref(data);
+        return false;
+    }
 
-        const char *pm25_pos = strstr(json_data, "\"pm25\":[[");
-        if (pm25_pos)
-        {
-            const char *comma = strchr(pm25_pos + 9, ',');
-            if (comma)
-            {
-                double new_pm25 = atof(comma + 1) / 100.0;
-                if (new_pm25 != current_station_data.pm25)
-                {
-                    current_station_data.pm25 = new_pm25;
-                    current_station_data.aqi = calculate_aqi_from_pm25(new_pm25);
-                }
-            }
-        }
+    station_index_records = (const StationIndexRecord *)(base + sizeof(StationIndexHeader));
+    station_index_keys = (const StationIndexKey *)(station_index_records + h->n_records);
+    station_index_arena = (const char *)(station_index_keys + h->n_keys);
+    if (station_index_data)
+        g_bytes_unref(station_index_data);
+    station_index_data = data;
+    station_index_header = h;
+    return true;
+}
 
-        const char *pm10_pos = strstr(json_data, "\"pm10\":[[");
-        if (pm10_pos)
-        {
-            const char *comma = strchr(pm10_pos + 9, ',');
-            if (comma)
-                current_station_data.pm10 = atof(comma + 1) / 100.0;
-        }
+// The arena string at `offset`. The arena ends in a NUL, so any offset
+// inside it reads a terminated string; one past it, from a damaged file,
+// reads as empty.
+static const char *station_index_string(guint32 offset)
+{
+    return offset < station_index_header->arena_size ? station_index_arena + offset : "";
+}
 
-        const char *o3_pos = strstr(json_data, "\"o3\":[[");
-        if (o3_pos)
-        {
-            const char *comma = strchr(o3_pos + 7, ',');
-            if (comma)
-                current_station_data.o3 = atof(comma + 1) / 100.0;
-        }
+// The record key `i` points at, or NULL if it points past the records
+static const StationIndexRecord *station_index_key_record(guint32 i)
+{
+    guint32 record = station_index_keys[i].record;
+    return record < station_index_header->n_records ? &station_index_records[record] : NULL;
+}
 
-        const char *no2_pos = strstr(json_data, "\"no2\":[[");
-        if (no2_pos)
-        {
-            const char *comma = strchr(no2_pos + 8, ',');
-            if (comma)
-                current_station_data.no2 = atof(comma + 1) / 100.0;
-        }
+static void station_index_load()
+{
+    char *path = station_index_path();
+    GMappedFile *mapped = g_mapped_file_new(path, FALSE, NULL);
+    g_free(path);
+    if (!mapped)
+        return;
 
-        const char *co_pos = strstr(json_data, "\"co\":[[");
-        if (co_pos)
-        {
-            const char *comma = strchr(co_pos + 7, ',');
-            if (comma)
-                current_station_data.co = atof(comma + 1) / 100.0;
-        }
+    if (g_mapped_file_get_length(mapped) > 0 && !station_index_attach(g_mapped_file_get_bytes(mapped)))
+        g_printerr("Ignoring invalid station index\n");
+    g_mapped_file_unref(mapped);
+}
 
-        const char *so2_pos = strstr(json_data, "\"so2\":[[");
-        if (so2_pos)
-        {
-            const char *comma = strchr(so2_pos + 8, ',');
-            if (comma)
-                current_station_data.so2 = atof(comma + 1) / 100.0;
-        }
-    }
-    else if (strncmp(type_pos, "cwop\"", 5) == 0)
+static void station_index_add_key(std::vector<std::string> &keys, const std::string &key)
+{
+    if (key.size() < 2)
+        return;
+    for (const auto &k : keys)
     {
+        if (k == key)
+            return;
+    }
+    keys.push_back(key);
+}
 
-        const char *data_pos = strstr(json_data, "\"data\":{");
-        if (data_pos)
-        {
-            const char *last_t = NULL;
-            const char *search = data_pos;
-            while ((search = strstr(search, "\"t\":")) != NULL)
-            {
-                if (search > data_pos && *(search - 1) == ',')
-                {
-                    last_t = search;
-                }
-                search += 4;
-            }
-
-            if (last_t)
-            {
-                current_station_data.temperature = json_parse_double(last_t + 4);
-
-                const char *entry_start = last_t;
-                while (entry_start > data_pos && *entry_start != '{')
-                    entry_start--;
-                const char *entry_end = strchr(last_t, '}');
-
-                if (entry_end)
-                {
-                    const char *dew_pos = strstr(entry_start, "\"dew\":");
-                    if (dew_pos && dew_pos < entry_end)
-                    {
-                        double dew = json_parse_double(dew_pos + 6);
-                        double t = current_station_data.temperature;
-                        double dew_denom = 243.04 + dew;
-                        double t_denom = 243.04 + t;
-                        if (fabs(dew_denom) > 0.01 && fabs(t_denom) > 0.01)
-                        {
-                            double alpha_dew = (17.625 * dew) / dew_denom;
-                            double alpha_t = (17.625 * t) / t_denom;
-                            current_station_data.humidity = 100.0 * exp(alpha_dew - alpha_t);
-                            if (current_station_data.humidity > 100)
-                                current_station_data.humidity = 100;
-                            if (current_station_data.humidity < 0)
-                                current_station_data.humidity = 0;
-                        }
-                    }
-
-                    const char *w_pos = strstr(entry_start, "\"w\":");
-                    if (w_pos && w_pos < entry_end)
-                    {
-                        current_station_data.wind_speed = json_parse_double(w_pos + 4);
-                    }
-
-                    const char *wd_pos = strstr(entry_start, "\"wd\":");
-                    if (wd_pos && wd_pos < entry_end)
-                    {
-                        current_station_data.wind_direction = json_parse_int(wd_pos + 5);
-                    }
-                }
-            }
-        }
+// Normalized keys a station can be found under: its name, every word
+// boundary within the name, and each part of its address.
+static std::vector<std::string> station_index_keys_for(const WAQISearchResult &result)
+{
+    std::vector<std::string> keys;
+    std::string name = search_cache_normalize(result.station_name);
+    station_index_add_key(keys, name);
+    for (size_t i = 1; i < name.size(); i++)
+    {
+        char prev = name[i - 1];
+        if ((prev == ' ' || prev == ',' || prev == '(' || prev == '-' || prev == '/') && name[i] != ' ')
+            station_index_add_key(keys, name.substr(i));
     }
-    else if (strncmp(type_pos, "hourly\"", 7) == 0)
+
+    const char *part = result.full_address;
+    while (*part)
     {
+        const char *end = strstr(part, " > ");
+        size_t len = end ? (size_t)(end - part) : strlen(part);
+        station_index_add_key(keys, search_cache_normalize(std::string(part, len).c_str()));
+        if (!end)
+            break;
+        part = end + 3;
+    }
+    return keys;
+}
 
-        const char *pm25_hourly = strstr(json_data, "\"pm25\":[{");
-        if (pm25_hourly)
-        {
-            current_station_data.pm25_history.clear();
-            const char *pos = pm25_hourly + 9;
-            int count = 0;
-            while (pos && count < 24)
-            {
-                const char *mean_pos = strstr(pos, "\"mean\":");
-                if (!mean_pos)
-                    break;
-                double val = json_parse_double(mean_pos + 7);
-                current_station_data.pm25_history.push_back(val);
-                pos = strchr(mean_pos, '}');
-                if (pos)
-                    pos++;
-                count++;
-            }
-        }
+static void station_index_record_to_result(const StationIndexRecord &r, WAQISearchResult &out)
+{
+    out.station_id = station_index_string(r.station_id);
+    out.station_name = station_index_string(r.station_name);
+    out.full_address = station_index_string(r.full_address);
+    out.url = station_index_string(r.url);
+    out.country = station_index_string(r.country);
+    out.source = station_index_string(r.source);
+    out.aqi = r.aqi;
+    out.has_aqi = (r.flags & STATION_INDEX_HAS_AQI) != 0;
+}
 
-        const char *pm10_hourly = strstr(json_data, "\"pm10\":[{");
-        if (pm10_hourly)
-        {
-            current_station_data.pm10_history.clear();
-            const char *pos = pm10_hourly + 9;
-            int count = 0;
-            while (pos && count < 24)
-            {
-                const char *mean_pos = strstr(pos, "\"mean\":");
-                if (!mean_pos)
-                    break;
-                double val = json_parse_double(mean_pos + 7);
-                current_station_data.pm10_history.push_back(val);
-                pos = strchr(mean_pos, '}');
-                if (pos)
-                    pos++;
-                count++;
-            }
-        }
+static bool station_index_hit_before(const StationIndexHit &a, const StationIndexHit &b)
+{
+    if (a.result.has_aqi != b.result.has_aqi)
+        return a.result.has_aqi;
+    if (a.name_match != b.name_match)
+        return a.name_match;
+    if (a.rank != b.rank)
+        return a.rank < b.rank;
+    int by_country = strcmp(a.result.country, b.result.country);
+    if (by_country != 0)
+        return by_country < 0;
+    return strcmp(a.result.station_name, b.result.station_name) < 0;
+}
+
+// Collects up to `limit` stations with a key starting with the normalized
+// query `prefix`, best first: stations with a reading, then name matches,
+// then their original response order, then by country. The results are
+// copied into a batch of their own.
+static WAQISearchBatch *station_index_query(const std::string &prefix, size_t limit)
+{
+    WAQISearchBatch *out = waqi_search_batch_new(4096);
+    if (prefix.size() < 2)
+        return out;
+
+    std::vector<StationIndexHit> hits;
+    std::map<std::string, size_t> hit_by_id;
 
-        const char *o3_hourly = strstr(json_data, "\"o3\":[{");
-        if (o3_hourly)
+    if (station_index_header)
+    {
+        // Lower bound of prefix in the sorted key array
+        guint32 lo = 0, hi = station_index_header->n_keys;
+        while (lo < hi)
         {
-            current_station_data.o3_history.clear();
-            const char *pos = o3_hourly + 7;
-            int count = 0;
-            while (pos && count < 24)
-            {
-                const char *mean_pos = strstr(pos, "\"mean\":");
-                if (!mean_pos)
-                    break;
-                double val = json_parse_double(mean_pos + 7);
-                current_station_data.o3_history.push_back(val);
-                pos = strchr(mean_pos, '}');
-                if (pos)
-                    pos++;
-                count++;
-            }
+            guint32 mid = lo + (hi - lo) / 2;
+            if (strcmp(station_index_string(station_index_keys[mid].key), prefix.c_str()) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
         }
 
-        const char *no2_hourly = strstr(json_data, "\"no2\":[{");
-        if (no2_hourly)
+        for (guint32 i = lo; i < station_index_header->n_keys; i++)
         {
-            current_station_data.no2_history.clear();
-            const char *pos = no2_hourly + 8;
-            int count = 0;
-            while (pos && count < 24)
+            const char *key = station_index_string(station_index_keys[i].key);
+            if (strncmp(key, prefix.c_str(), prefix.size()) != 0)
+                break;
+
+            const StationIndexRecord *record = station_index_key_record(i);
+            if (!record)
+                continue;
+            const StationIndexRecord &r = *record;
+            const char *id = station_index_string(r.station_id);
+            if (station_index_pending.count(id))
+                continue; // Superseded by a newer sighting
+
+            std::string name = search_cache_normalize(station_index_string(r.station_name));
+            bool name_match = name.compare(0, prefix.size(), prefix) == 0;
+            auto seen = hit_by_id.find(id);
+            if (seen != hit_by_id.end())
             {
-                const char *mean_pos = strstr(pos, "\"mean\":");
-                if (!mean_pos)
-                    break;
-                double val = json_parse_double(mean_pos + 7);
-                current_station_data.no2_history.push_back(val);
-                pos = strchr(mean_pos, '}');
-                if (pos)
-                    pos++;
-                count++;
+                hits[seen->second].name_match |= name_match;
+                continue;
             }
+
+            StationIndexHit hit;
+            station_index_record_to_result(r, hit.result);
+            hit.rank = r.rank;
+            hit.name_match = name_match;
+            hit_by_id[hit.result.station_id] = hits.size();
+            hits.push_back(std::move(hit));
         }
     }
 
-    if (g_current_builder && current_station_data.has_data)
+    for (const auto &it : station_index_pending)
     {
-        current_aqi_data.aqi = current_station_data.aqi;
-        current_aqi_data.pm25 = current_station_data.pm25;
-        current_aqi_data.pm10 = current_station_data.pm10;
-
-        set_aqi_status(current_aqi_data);
-
-        if (!current_station_data.pm25_history.empty())
+        const StationIndexPending &p = it.second;
+        bool matched = false;
+        for (const auto &key : p.keys)
         {
-            current_aqi_data.history.clear();
-            for (double val : current_station_data.pm25_history)
+            if (key.compare(0, prefix.size(), prefix) == 0)
             {
-                current_aqi_data.history.push_back((int)val);
+                matched = true;
+                break;
             }
         }
-        while (current_aqi_data.history.size() < 24)
-        {
-            current_aqi_data.history.insert(current_aqi_data.history.begin(), current_aqi_data.aqi);
-        }
-
-        update_aqi_display(g_current_builder);
+        if (!matched)
+            continue;
+
+        StationIndexHit hit;
+        hit.result = p.result;
+        hit.rank = p.rank;
+        hit.name_match = !p.keys.empty() && p.keys[0].compare(0, prefix.size(), prefix) == 0;
+        hits.push_back(std::move(hit));
     }
+
+    std::sort(hits.begin(), hits.end(), station_index_hit_before);
+    for (size_t i = 0; i < hits.size() && i < limit; i++)
+        waqi_search_batch_append(out, hits[i].result);
+    return out;
 }
 
-static void process_sse_buffer()
+static guint32 station_index_intern(std::string &arena, std::map<std::string, guint32> &interned, const std::string &s)
 {
-    size_t pos = 0;
-    while (pos < sse_buffer.size())
-    {
-        size_t end = sse_buffer.find("\n\n", pos);
-        if (end == std::string::npos)
-            break;
+    auto it = interned.find(s);
+    if (it != interned.end())
+        return it->second;
+    guint32 offset = (guint32)arena.size();
+    arena.append(s);
+    arena.push_back('\0');
+    interned[s] = offset;
+    return offset;
+}
 
-        std::string message = sse_buffer.substr(pos, end - pos);
-        pos = end + 2;
+// Merges pending stations into a fresh index buffer, attaches it, and
+// writes it out. The previous mapping is dropped before the file is
+// replaced so this also works where mapped files cannot be overwritten.
+static gboolean station_index_save(gpointer user_data)
+{
+    station_index_save_id = 0;
+    if (station_index_pending.empty())
+        return G_SOURCE_REMOVE;
 
-        size_t data_pos = message.find("data: ");
-        if (data_pos != std::string::npos)
+    std::map<std::string, StationIndexPending> all;
+    if (station_index_header)
+    {
+        for (guint32 i = 0; i < station_index_header->n_records; i++)
         {
-            std::string json_data = message.substr(data_pos + 6);
-            while (!json_data.empty() && (json_data.back() == '\n' || json_data.back() == '\r'))
-            {
-                json_data.pop_back();
-            }
-
-            if (!json_data.empty())
-            {
-                parse_sse_event(json_data.c_str(), json_data.size());
-            }
+            const StationIndexRecord &r = station_index_records[i];
+            if (station_index_pending.count(station_index_string(r.station_id)))
+                continue;
+            StationIndexPending entry;
+            station_index_record_to_result(r, entry.result);
+            entry.rank = r.rank;
+            entry.keys = station_index_keys_for(entry.result);
+            all[entry.result.station_id] = std::move(entry);
         }
     }
-
-    if (pos > 0)
+    for (auto &it : station_index_pending)
+        all[it.first] = std::move(it.second);
+    station_index_pending.clear();
+
+    std::string arena;
+    std::map<std::string, guint32> interned;
+    std::vector<StationIndexRecord> records;
+    std::vector<std::pair<std::string, guint32>> keys;
+    records.reserve(all.size());
+
+    // std::map iterates by station id, which is the record order
+    for (const auto &it : all)
     {
-        sse_buffer = sse_buffer.substr(pos);
+        const WAQISearchResult &res = it.second.result;
+        StationIndexRecord r;
+        r.station_id = station_index_intern(arena, interned, res.station_id);
+        r.station_name = station_index_intern(arena, interned, res.station_name);
+        r.full_address = station_index_intern(arena, interned, res.full_address);
+        r.url = station_index_intern(arena, interned, res.url);
+        r.country = station_index_intern(arena, interned, res.country);
+        r.source = station_index_intern(arena, interned, res.source);
+        r.aqi = res.aqi;
+        r.flags = res.has_aqi ? STATION_INDEX_HAS_AQI : 0;
+        r.rank = it.second.rank;
+        for (const auto &key : it.second.keys)
+            keys.push_back(std::make_pair(key, (guint32)records.size()));
+        records.push_back(r);
     }
-}
-
-static void on_sse_read_complete(GObject *source, GAsyncResult *result, gpointer user_data)
-{
-    GInputStream *stream = G_INPUT_STREAM(source);
-    GError *error = NULL;
+    std::sort(keys.begin(), keys.end());
 
-    gssize bytes_read = g_input_stream_read_finish(stream, result, &error);
+    // Everything pending has been copied into the arena
+    for (WAQISearchBatch *batch : station_index_batches)
+        waqi_search_batch_unref(batch);
+    station_index_batches.clear();
 
-    if (error)
+    std::vector<StationIndexKey> key_table;
+    key_table.reserve(keys.size());
+    for (const auto &k : keys)
     {
-        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-        {
-            g_printerr("SSE read error: %s\n", error->message);
-        }
-        g_clear_error(&error);
-        return;
+        StationIndexKey entry;
+        entry.key = station_index_intern(arena, interned, k.first);
+        entry.record = k.second;
+        key_table.push_back(entry);
     }
-
-    if (bytes_read <= 0)
+    if (arena.empty())
+        arena.push_back('\0');
+
+    StationIndexHeader header;
+    header.magic = STATION_INDEX_MAGIC;
+    header.version = STATION_INDEX_VERSION;
+    header.n_records = (guint32)records.size();
+    header.n_keys = (guint32)key_table.size();
+    header.arena_size = (guint32)arena.size();
+
+    gsize size = sizeof(header) + records.size() * sizeof(StationIndexRecord) +
+                 key_table.size() * sizeof(StationIndexKey) + arena.size();
+    char *buffer = (char *)g_malloc(size);
+    char *p = buffer;
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    memcpy(p, records.data(), records.size() * sizeof(StationIndexRecord));
+    p += records.size() * sizeof(StationIndexRecord);
+    memcpy(p, key_table.data(), key_table.size() * sizeof(StationIndexKey));
+    p += key_table.size() * sizeof(StationIndexKey);
+    memcpy(p, arena.data(), arena.size());
+
+    GBytes *bytes = g_bytes_new_take(buffer, size);
+    if (!station_index_attach(g_bytes_ref(bytes)))
     {
-        g_print("SSE stream ended\n");
-        return;
+        g_bytes_unref(bytes);
+        return G_SOURCE_REMOVE;
     }
 
-    char *buffer = (char *)user_data;
-    buffer[bytes_read] = '\0';
-    sse_buffer += buffer;
-
-    process_sse_buffer();
-
-    sse_read_next_chunk(stream);
+    char *path = station_index_path();
+    char *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+
+    GFile *file = g_file_new_for_path(path);
+    g_file_replace_contents_bytes_async(file, bytes, NULL, FALSE, G_FILE_CREATE_PRIVATE, NULL,
+                                        on_cache_file_saved, NULL);
+    g_object_unref(file);
+    g_bytes_unref(bytes);
+    g_free(dir);
+    g_free(path);
+    return G_SOURCE_REMOVE;
 }
 
-static void on_sse_send_complete(GObject *source, GAsyncResult *result, gpointer user_data)
+// Remembers every station of a search response, keeping its position in
+// the response as its rank.
+static void station_index_add(WAQISearchBatch *batch)
 {
-    SoupSession *session = SOUP_SESSION(source);
-    GError *error = NULL;
-
-    GInputStream *stream = soup_session_send_finish(session, result, &error);
+    const std::vector<WAQISearchResult> &results = batch->results;
+    if (results.empty())
+        return;
 
-    if (error)
+    for (size_t i = 0; i < results.size(); i++)
     {
-        g_printerr("SSE connection failed: %s\n", error->message);
-        g_clear_error(&error);
-        return;
+        StationIndexPending entry;
+        entry.result = results[i];
+        entry.rank = (guint32)i;
+        entry.keys = station_index_keys_for(results[i]);
+        station_index_pending[results[i].station_id] = std::move(entry);
     }
+    station_index_batches.push_back(waqi_search_batch_ref(batch));
 
-    g_print("SSE stream connected!\n");
-    sse_stream = stream;
-    sse_buffer.clear();
-
-    sse_read_next_chunk(stream);
+    if (station_index_save_id == 0)
+        station_index_save_id = g_timeout_add_seconds(5, station_index_save, NULL);
 }
 
-static void stop_sse_stream()
+// Replaces the presented results; takes ownership of `batch`
+static void search_results_set(WAQISearchBatch *batch)
 {
-    if (sse_cancellable)
-    {
-        g_cancellable_cancel(sse_cancellable);
-        g_clear_object(&sse_cancellable);
-    }
-
-    if (sse_stream)
-    {
-        g_input_stream_close(sse_stream, NULL, NULL);
-        g_clear_object(&sse_stream);
-    }
-
-    sse_buffer.clear();
-    current_sse_station_id.clear();
+    waqi_search_batch_unref(search_results);
+    search_results = batch;
 }
 
-static void start_sse_stream(const std::string &station_id)
+typedef struct
 {
-    stop_sse_stream();
-
-    current_sse_station_id = station_id;
-
-    if (!sse_session)
-    {
-        sse_session = soup_session_new();
-    }
+    GtkBuilder *builder;
+    SoupMessage *msg;
+    guint64 generation;
+    WAQISearchMode mode;
+    gchar *query;
+    gchar *cache_key;
+    bool revalidating; // Results were already shown from a stale cache entry
+} WAQISearchContext;
 
-    char url[256];
-    snprintf(url, sizeof(url), "https://airnet.waqi.info/airnet/sse/feed/%s", station_id.c_str());
+// The one search request on the network, if any. Owned by its callback.
+static WAQISearchContext *search_in_flight = NULL;
 
-    g_print("Starting SSE stream: %s\n", url);
-
-    SoupMessage *msg = soup_message_new("GET", url);
-    if (!msg)
-    {
-        g_printerr("Failed to create SSE request\n");
-        return;
-    }
-
-    soup_message_headers_append(soup_message_get_request_headers(msg), "Accept", "text/event-stream");
-
-    sse_cancellable = g_cancellable_new();
-
-    soup_session_send_async(
-        sse_session,
-        msg,
-        G_PRIORITY_DEFAULT,
-        sse_cancellable,
-        on_sse_send_complete,
-        NULL);
-
-    g_object_unref(msg);
-}
-
-static void waqi_fetch_station_data(const std::string &station_id, WAQIStationData &station_data)
+static void waqi_search_context_free(WAQISearchContext *ctx)
 {
-    station_data.has_data = false;
-    station_data.station_id = station_id;
-    start_sse_stream(station_id);
-    g_print("SSE stream started for station %s\n", station_id.c_str());
+    if (!ctx)
+        return;
+    if (ctx->msg)
+        g_object_unref(ctx->msg);
+    if (ctx->builder)
+        g_object_unref(ctx->builder);
+    g_free(ctx->query);
+    g_free(ctx->cache_key);
+    g_free(ctx);
 }
-#endif
-
-// --- Live Data State & Helpers ---
 
-static std::vector<int> history_cpu(24, 0);
-static std::vector<int> history_mem(24, 0);
-static std::vector<int> history_net(24, 0);
-static int live_tick = 0;
-
-#ifdef _WIN32
-static unsigned long long FileTimeToInt64(const FILETIME &ft)
+// Presents search_results for mode: fills the dropdown or selects the
+// first station. Falls back to mock data if an explicit fetch found nothing.
+static void waqi_present_search_results(GtkBuilder *builder, WAQISearchMode mode, const char *query)
 {
-    return (((unsigned long long)(ft.dwHighDateTime)) << 32) | ((unsigned long long)ft.dwLowDateTime);
+    if (mode == SEARCH_MODE_AUTO_SELECT_FIRST)
+    {
+        if (search_results && !search_results->results.empty())
+        {
+            select_search_result_by_index(builder, 0);
+        }
+        else if (query && *query)
+        {
+            current_aqi_data = get_mock_data(query);
+            update_aqi_display(builder);
+        }
+    }
+    else
+    {
+        populate_search_dropdown(builder);
+    }
 }
 
-static double GetCPULoad()
+// Parses a response body into search_results, remembers its stations in
+// the prefix index and presents it for mode.
+static void waqi_show_search_results(GBytes *body, GtkBuilder *builder, WAQISearchMode mode, const char *query)
 {
-    static FILETIME preIdleTime = {0}, preKernelTime = {0}, preUserTime = {0};
-    FILETIME idleTime, kernelTime, userTime;
-
-    if (!GetSystemTimes(&idleTime, &kernelTime, &userTime))
-        return 0.0;
-
-    unsigned long long idle = FileTimeToInt64(idleTime) - FileTimeToInt64(preIdleTime);
-    unsigned long long kernel = FileTimeToInt64(kernelTime) - FileTimeToInt64(preKernelTime);
-    unsigned long long user = FileTimeToInt64(userTime) - FileTimeToInt64(preUserTime);
-
-    preIdleTime = idleTime;
-    preKernelTime = kernelTime;
-    preUserTime = userTime;
-
-    if (kernel + user == 0)
-        return 0.0;
-
-    return (double)(kernel + user - idle) * 100.0 / (kernel + user);
-}
+    gsize size = 0;
+    const char *data = (const char *)g_bytes_get_data(body, &size);
+    search_results_set(waqi_parse_search_response(data, size));
+    station_index_add(search_results);
 
-static double GetMemoryUsage()
-{
-    MEMORYSTATUSEX memInfo;
-    memInfo.dwLength = sizeof(MEMORYSTATUSEX);
-    GlobalMemoryStatusEx(&memInfo);
-    return (double)memInfo.dwMemoryLoad;
+    waqi_present_search_results(builder, mode, query);
 }
 
-static double GetNetworkUsage()
+static void on_waqi_search_complete(GObject *source, GAsyncResult *result, gpointer user_data)
 {
-    static DWORD last_bytes_in = 0;
-    static DWORD last_bytes_out = 0;
-    static DWORD last_time = 0;
-
-    MIB_IFTABLE *pIfTable;
-    ULONG dwSize = 0;
-
-    if (GetIfTable(NULL, &dwSize, FALSE) == ERROR_INSUFFICIENT_BUFFER)
-    {
-        pIfTable = (MIB_IFTABLE *)malloc(dwSize);
-    }
-    else
-    {
-        return 0.0;
-    }
+    WAQISearchContext *ctx = (WAQISearchContext *)user_data;
+    GError *error = NULL;
+    GBytes *response = soup_session_send_and_read_finish(SOUP_SESSION(source), result, &error);
+    guint status = error ? 0 : soup_message_get_status(ctx->msg);
+    if (search_in_flight == ctx)
+        search_in_flight = NULL;
 
-    if (GetIfTable(pIfTable, &dwSize, FALSE) == NO_ERROR)
+    // Keep the cache current even if the user has typed on since
+    if (!error && ctx->cache_key)
     {
-        DWORD total_in = 0;
-        DWORD total_out = 0;
-
-        for (int i = 0; i < pIfTable->dwNumEntries; i++)
+        SoupMessageHeaders *headers = soup_message_get_response_headers(ctx->msg);
+        if (status == SOUP_STATUS_NOT_MODIFIED)
         {
-            if (pIfTable->table[i].dwType != MIB_IF_TYPE_LOOPBACK)
+            WAQISearchCacheEntry *entry = search_cache_lookup(ctx->cache_key);
+            if (entry)
             {
-                total_in += pIfTable->table[i].dwInOctets;
-                total_out += pIfTable->table[i].dwOutOctets;
+                entry->fetched_at = g_get_real_time();
+                search_cache_schedule_save();
             }
         }
-
-        DWORD current_time = GetTickCount();
-        double speed = 0.0;
-
-        if (last_time != 0)
+        else if (status == SOUP_STATUS_OK && response)
         {
-            double time_diff = (current_time - last_time) / 1000.0;
-            if (time_diff > 0)
-            {
-                long long diff_in = (long long)total_in - last_bytes_in;
-                if (diff_in < 0)
-                    diff_in += 0xFFFFFFFF;
-                long long diff_out = (long long)total_out - last_bytes_out;
-                if (diff_out < 0)
-                    diff_out += 0xFFFFFFFF;
-
-                double bytes_diff = (double)(diff_in + diff_out);
-                speed = (bytes_diff * 8) / (1024.0 * 1024.0); // Mbps
-                speed = speed / time_diff;
-            }
+            search_cache_store(ctx->cache_key, g_bytes_ref(response), g_get_real_time(),
+                               soup_message_headers_get_one(headers, "ETag"),
+                               soup_message_headers_get_one(headers, "Last-Modified"));
+            search_cache_schedule_save();
         }
-
-        last_bytes_in = total_in;
-        last_bytes_out = total_out;
-        last_time = current_time;
-
-        free(pIfTable);
-        return speed;
     }
 
-    free(pIfTable);
-    return 0.0;
-}
-#else
-static double GetCPULoad() { return (rand() % 100); }
-static double GetMemoryUsage() { return 50.0; }
-static double GetNetworkUsage() { return (rand() % 100); }
-#endif
-
-static AirQualityData get_live_data(const char *type)
-{
-    AirQualityData data;
-    data.city = type;
-    data.status = "Live";
-
-    if (strstr(type, "CPU"))
+    if (ctx->generation != search_generation)
     {
-        data.history = history_cpu;
-        data.aqi = history_cpu.empty() ? 0 : history_cpu.back();
+        if (response)
+            g_bytes_unref(response);
+        if (error)
+            g_clear_error(&error);
+        waqi_search_context_free(ctx);
+        return;
     }
-    else if (strstr(type, "Mem"))
+
+    if (error || (status != SOUP_STATUS_OK && status != SOUP_STATUS_NOT_MODIFIED))
     {
-        data.history = history_mem;
-        data.aqi = history_mem.empty() ? 0 : history_mem.back();
+        if (error && !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_printerr("WAQI search failed: %s\n", error->message);
+        }
+        else if (!error)
+        {
+            g_printerr("WAQI search failed: HTTP %u\n", status);
+        }
+        g_clear_error(&error);
+        if (response)
+            g_bytes_unref(response);
+
+        if (!ctx->revalidating && ctx->mode == SEARCH_MODE_AUTO_SELECT_FIRST && ctx->query && *ctx->query)
+        {
+            current_aqi_data = get_mock_data(ctx->query);
+            update_aqi_display(ctx->builder);
+        }
+        waqi_search_context_free(ctx);
+        return;
     }
-    else
+
+    // A revalidated auto-select already picked its station from the cache;
+    // only a dropdown is refreshed with changed results.
+    if (status == SOUP_STATUS_OK && !(ctx->revalidating && ctx->mode == SEARCH_MODE_AUTO_SELECT_FIRST))
     {
-        data.history = history_net;
-        data.aqi = history_net.empty() ? 0 : history_net.back();
+        waqi_show_search_results(response, ctx->builder, ctx->mode, ctx->query);
     }
 
-    data.pm25 = data.aqi * 0.5;
-    data.pm10 = data.aqi * 1.1;
-
-    return data;
-}
-
-// --- Interaction Callbacks ---
-
-static void on_chart_motion(GtkEventControllerMotion *controller, double x, double y, gpointer user_data)
-{
-    GtkWidget *widget = GTK_WIDGET(user_data);
-    g_object_set_data(G_OBJECT(widget), "hover_x", (gpointer)(intptr_t)x);
-    g_object_set_data(G_OBJECT(widget), "is_hovering", (gpointer)1);
-    gtk_widget_queue_draw(widget);
-}
-
-static void on_chart_leave(GtkEventControllerMotion *controller, gpointer user_data)
-{
-    GtkWidget *widget = GTK_WIDGET(user_data);
-    g_object_set_data(G_OBJECT(widget), "is_hovering", (gpointer)0);
-    gtk_widget_queue_draw(widget);
+    g_bytes_unref(response);
+    waqi_search_context_free(ctx);
 }
 
-// --- Drawing Callback ---
-
-static void on_draw_chart(GtkDrawingArea *area, cairo_t *cr, int width, int height, gpointer user_data)
+static void waqi_search_cities_async(const char *query, GtkBuilder *builder, WAQISearchMode mode)
 {
-    const char *city_name = (const char *)g_object_get_data(G_OBJECT(area), "city_name");
-    gpointer is_live = g_object_get_data(G_OBJECT(area), "is_live");
-
-    AirQualityData data_to_draw;
+    if (!builder)
+        return;
 
-    if (is_live)
-    {
-        const char *type = (const char *)g_object_get_data(G_OBJECT(area), "live_type");
-        data_to_draw = get_live_data(type ? type : "Unknown");
-    }
-    else if (city_name)
-    {
-        data_to_draw = get_mock_data(city_name);
-    }
-    else
+    if (!query || strlen(query) < 2)
     {
-        if (current_aqi_data.history.empty())
-            return;
-        data_to_draw = current_aqi_data;
-    }
-
-    if (data_to_draw.history.empty())
+        search_results_set(NULL);
+        populate_search_dropdown(builder);
         return;
+    }
 
-    cairo_set_source_rgb(cr, 0.95, 0.95, 0.95);
-    cairo_paint(cr);
-
-    double margin_x = 40.0;
-    double margin_y = 20.0;
-    double graph_w = width - margin_x - 20.0;
-    double graph_h = height - 2 * margin_y;
+    std::string key = search_cache_normalize(query);
 
-    int max_val = 0;
-    for (int val : data_to_draw.history)
+    // The same query is already on the network: let that request answer
+    // this call too instead of cancelling and resending it. An explicit
+    // fetch takes over a dropdown request, selecting from the stale cache
+    // entry right away if that request is only revalidating one.
+    if (search_in_flight && key == search_in_flight->cache_key)
     {
-        if (val > max_val)
-            max_val = val;
+        WAQISearchContext *ctx = search_in_flight;
+        ctx->generation = ++search_generation;
+        g_free(ctx->query);
+        ctx->query = g_strdup(query);
+        if (mode == SEARCH_MODE_AUTO_SELECT_FIRST && ctx->mode != mode)
+        {
+            ctx->mode = mode;
+            WAQISearchCacheEntry *cached = ctx->revalidating ? search_cache_lookup(key) : NULL;
+            if (cached)
+            {
+                GBytes *body = g_bytes_ref(cached->body);
+                waqi_show_search_results(body, builder, mode, query);
+                g_bytes_unref(body);
+            }
+        }
+        return;
     }
-    if (max_val < 100)
-        max_val = 100;
 
-    cairo_set_line_width(cr, 1.0);
-    cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
-    cairo_set_font_size(cr, 10);
-
-    for (int i = 0; i <= 4; i++)
+    if (search_cancellable)
     {
-        double y = margin_y + graph_h - (i * graph_h / 4.0);
-
-        cairo_set_source_rgba(cr, 0.8, 0.8, 0.8, 1.0);
-        cairo_move_to(cr, margin_x, y);
-        cairo_line_to(cr, margin_x + graph_w, y);
-        cairo_stroke(cr);
-
-        char label[16];
-        snprintf(label, sizeof(label), "%d", max_val * i / 4);
-        cairo_text_extents_t extents;
-        cairo_text_extents(cr, label, &extents);
-
-        cairo_set_source_rgb(cr, 0.4, 0.4, 0.4);
-        cairo_move_to(cr, margin_x - extents.width - 5, y + extents.height / 2 - 2);
-        cairo_show_text(cr, label);
+        g_cancellable_cancel(search_cancellable);
+        g_clear_object(&search_cancellable);
     }
+    search_in_flight = NULL; // Its callback still frees it
 
-    cairo_set_source_rgb(cr, 0.2, 0.6, 1.0);
-    cairo_set_line_width(cr, 3.0);
-
-    double step_x = graph_w / (data_to_draw.history.size() - 1);
+    search_generation++;
 
-    for (size_t i = 0; i < data_to_draw.history.size(); i++)
+    WAQISearchCacheEntry *cached = search_cache_lookup(key);
+    bool have_cached = cached != NULL;
+    std::string etag, last_modified;
+    if (have_cached)
     {
-        double x = margin_x + i * step_x;
-        double y = margin_y + graph_h - (data_to_draw.history[i] / (double)max_val * graph_h);
-
-        if (i == 0)
-            cairo_move_to(cr, x, y);
-        else
-            cairo_line_to(cr, x, y);
-    }
-    cairo_stroke_preserve(cr);
+        etag = cached->etag;
+        last_modified = cached->last_modified;
+        bool fresh = search_cache_is_fresh(cached);
 
-    cairo_line_to(cr, margin_x + graph_w, margin_y + graph_h);
-    cairo_line_to(cr, margin_x, margin_y + graph_h);
-    cairo_close_path(cr);
+        // May run a selection that re-enters the cache, so copy out first
+        GBytes *body = g_bytes_ref(cached->body);
+        waqi_show_search_results(body, builder, mode, query);
+        g_bytes_unref(body);
 
-    cairo_pattern_t *pat = cairo_pattern_create_linear(0, margin_y, 0, margin_y + graph_h);
-    cairo_pattern_add_color_stop_rgba(pat, 0, 0.2, 0.6, 1.0, 0.4);
-    cairo_pattern_add_color_stop_rgba(pat, 1, 0.2, 0.6, 1.0, 0.0);
-    cairo_set_source(cr, pat);
-    cairo_fill(cr);
-    cairo_pattern_destroy(pat);
-
-    if (is_live && !data_to_draw.history.empty())
+        if (fresh)
+            return;
+    }
+    else
     {
-        int current_val = data_to_draw.history.back();
-        const char *type = (const char *)g_object_get_data(G_OBJECT(area), "live_type");
-        char label_text[64];
-
-        if (type && (strstr(type, "CPU") || strstr(type, "Memory")))
-        {
-            snprintf(label_text, sizeof(label_text), "%d%%", current_val);
-        }
-        else if (type && strstr(type, "Network"))
+        // Answer from stations seen before; only go to the network when the
+        // index cannot fill the dropdown (or has nothing for a fetch).
+        WAQISearchBatch *local = station_index_query(key, 10);
+        size_t n_local = local->results.size();
+        bool enough = mode == SEARCH_MODE_AUTO_SELECT_FIRST ? n_local > 0 : n_local >= STATION_INDEX_MIN_HITS;
+        if (n_local > 0 && (enough || mode == SEARCH_MODE_DROPDOWN))
         {
-            snprintf(label_text, sizeof(label_text), "%.1f Mbps", (double)current_val);
+            search_results_set(local);
+            waqi_present_search_results(builder, mode, query);
         }
         else
         {
-            snprintf(label_text, sizeof(label_text), "%d", current_val);
+            waqi_search_batch_unref(local);
         }
+        if (enough)
+            return;
+    }
 
-        cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
-        cairo_set_font_size(cr, 24);
-        cairo_text_extents_t extents;
-        cairo_text_extents(cr, label_text, &extents);
+    search_cancellable = g_cancellable_new();
 
-        double x = width - margin_x - extents.width;
-        double y = margin_y + extents.height;
+    char *encoded_query = g_uri_escape_string(query, NULL, TRUE);
+    char url[512];
+    snprintf(url, sizeof(url), "https://search.waqi.info/nsearch/world/%s?n=10", encoded_query);
+    g_free(encoded_query);
 
-        cairo_set_source_rgba(cr, 0.1, 0.1, 0.1, 0.8);
-        cairo_move_to(cr, x, y);
-        cairo_show_text(cr, label_text);
-    }
+    SoupMessage *msg = http_client_message_new("GET", url, HTTP_PRIORITY_INTERACTIVE);
+    if (!msg)
+        return;
 
-    gpointer is_hovering = g_object_get_data(G_OBJECT(area), "is_hovering");
-    if (is_hovering)
+    if (have_cached)
     {
-        int mouse_x = (int)(intptr_t)g_object_get_data(G_OBJECT(area), "hover_x");
+        SoupMessageHeaders *headers = soup_message_get_request_headers(msg);
+        if (!etag.empty())
+            soup_message_headers_append(headers, "If-None-Match", etag.c_str());
+        if (!last_modified.empty())
+            soup_message_headers_append(headers, "If-Modified-Since", last_modified.c_str());
+    }
 
-        int index = -1;
-        double min_dist = 9999;
+    WAQISearchContext *ctx = (WAQISearchContext *)g_malloc0(sizeof(WAQISearchContext));
+    ctx->builder = (GtkBuilder *)g_object_ref(builder);
+    ctx->msg = (SoupMessage *)g_object_ref(msg);
+    ctx->generation = search_generation;
+    ctx->mode = mode;
+    ctx->query = g_strdup(query);
+    ctx->cache_key = g_strdup(key.c_str());
+    ctx->revalidating = have_cached;
+    search_in_flight = ctx;
 
-        for (size_t i = 0; i < data_to_draw.history.size(); i++)
-        {
-            double x = margin_x + i * step_x;
-            double dist = fabs(x - mouse_x);
-            if (dist < min_dist)
-            {
-                min_dist = dist;
-                index = i;
-            }
-        }
+    soup_session_send_and_read_async(
+        http_client_session(),
+        msg,
+        http_client_io_priority(HTTP_PRIORITY_INTERACTIVE),
+        search_cancellable,
+        on_waqi_search_complete,
+        ctx);
 
-        if (index >= 0 && min_dist < step_x / 1.5)
-        {
-            double x = margin_x + index * step_x;
-            double y = margin_y + graph_h - (data_to_draw.history[index] / (double)max_val * graph_h);
-
-            cairo_set_source_rgba(cr, 0.5, 0.5, 0.5, 0.8);
-            cairo_set_line_width(cr, 1.0);
-            double dashes[] = {4.0};
-            cairo_set_dash(cr, dashes, 1, 0);
-            cairo_move_to(cr, x, margin_y);
-            cairo_line_to(cr, x, margin_y + graph_h);
-            cairo_stroke(cr);
-            cairo_set_dash(cr, NULL, 0, 0);
-
-            cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
-            cairo_arc(cr, x, y, 5, 0, 2 * 3.14159);
-            cairo_fill_preserve(cr);
-            cairo_set_source_rgb(cr, 0.2, 0.6, 1.0);
-            cairo_set_line_width(cr, 2.0);
-            cairo_stroke(cr);
-
-            char tooltip[32];
-            const char *unit = "";
-            if (is_live)
-            {
-                const char *type = (const char *)g_object_get_data(G_OBJECT(area), "live_type");
-                if (type && strstr(type, "Network"))
-                    unit = " Mbps";
-                else if (type && (strstr(type, "CPU") || strstr(type, "Memory")))
-                    unit = "%";
-            }
-            snprintf(tooltip, sizeof(tooltip), "%d%s", data_to_draw.history[index], unit);
-
-            cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
-            cairo_set_font_size(cr, 10);
-            cairo_text_extents_t extents;
-            cairo_text_extents(cr, tooltip, &extents);
-
-            double box_w = extents.width + 10;
-            double box_h = extents.height + 10;
-            double box_x = x + 10;
-            double box_y = y - 10 - box_h;
-
-            if (box_x + box_w > width - 20)
-                box_x = x - 10 - box_w;
-            if (box_y < margin_y)
-                box_y = y + 10;
-
-            cairo_set_source_rgba(cr, 0.2, 0.2, 0.2, 0.9);
-            cairo_rectangle(cr, box_x, box_y, box_w, box_h);
-            cairo_fill(cr);
-
-            cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
-            cairo_move_to(cr, box_x + 5, box_y + box_h - 5);
-            cairo_show_text(cr, tooltip);
-        }
-    }
+    g_object_unref(msg);
 }
 
-// --- Callbacks ---
+// --- Station History Store ---
+// Hourly pollutant means are kept on disk, one file per station and
+// pollutant, as a header followed by fixed-width (time, value) records in
+// time order. Files are only ever appended to, and hourly events append just
+// the hours newer than the last stored one, going by the feed's own times.
+// Reads map the file and find the requested range by binary search over the
+// records, so the records are their own index. A file is compacted once more
+// than half of it is older than the retention window. Calls may come from any
+// decode job and are serialized by history_lock.
+
+#define HISTORY_MAGIC 0x48514141 // "AAQH"
+#define HISTORY_VERSION 1
+#define HISTORY_RETENTION_HOURS (90 * 24)
+#define HISTORY_CHART_HOURS 72 // Hours loaded into WAQIStationData histories
 
-#ifndef __ANDROID__
-static gboolean do_search_callback(gpointer user_data)
+typedef struct
 {
-    GtkBuilder *builder = GTK_BUILDER(user_data);
-    search_timeout_id = 0;
+    guint32 magic;
+    guint32 version;
+} HistoryHeader;
 
-    GObject *entry_obj = gtk_builder_get_object(builder, "city_entry");
-    if (!entry_obj)
-        return FALSE;
+typedef struct
+{
+    char *path;
+    GMappedFile *mapped; // NULL while the file is missing or invalid
+    const HistoryRecord *records;
+    size_t n_records;
+} HistorySeries;
 
-    const char *query = gtk_editable_get_text(GTK_EDITABLE(entry_obj));
-    if (query && strlen(query) >= 2)
-    {
-        waqi_search_cities_async(query, builder, SEARCH_MODE_DROPDOWN);
-    }
-    else
+static GMutex history_lock;
+static std::map<std::string, HistorySeries *> history_series; // "station/pollutant"
+
+// Station ids look like "@1234" or "A5678"; keep them filename-safe
+static std::string station_file_name(const std::string &station_id)
+{
+    std::string name = station_id;
+    for (char &c : name)
     {
-        waqi_search_cities_async(query, builder, SEARCH_MODE_DROPDOWN);
+        if (!g_ascii_isalnum(c) && c != '-')
+            c = '_';
     }
+    return name;
+}
 
-    return FALSE;
+static char *history_series_path(const std::string &station_id, const char *pollutant)
+{
+    std::string dir_name = station_file_name(station_id);
+    std::string file_name = std::string(pollutant) + ".ts";
+    return g_build_filename(g_get_user_cache_dir(), "aqi-dashboard", "history", dir_name.c_str(),
+                            file_name.c_str(), NULL);
 }
 
-static void on_city_entry_changed(GtkEditable *editable, gpointer user_data)
+static void history_series_unmap(HistorySeries *s)
 {
-    GtkBuilder *builder = GTK_BUILDER(user_data);
+    if (s->mapped)
+        g_mapped_file_unref(s->mapped);
+    s->mapped = NULL;
+    s->records = NULL;
+    s->n_records = 0;
+}
 
-    if (search_timeout_id > 0)
+static void history_series_map(HistorySeries *s)
+{
+    history_series_unmap(s);
+    GMappedFile *mapped = g_mapped_file_new(s->path, FALSE, NULL);
+    if (!mapped)
+        return;
+
+    gsize size = g_mapped_file_get_length(mapped);
+    const char *base = g_mapped_file_get_contents(mapped);
+    const HistoryHeader *h = (const HistoryHeader *)base;
+    if (size < sizeof(HistoryHeader) || h->magic != HISTORY_MAGIC || h->version != HISTORY_VERSION)
     {
-        g_source_remove(search_timeout_id);
-        search_timeout_id = 0;
+        g_printerr("Ignoring invalid history file %s\n", s->path);
+        g_mapped_file_unref(mapped);
+        return;
     }
 
-    search_timeout_id = g_timeout_add(300, do_search_callback, builder);
+    // A torn trailing record from an interrupted append is not mapped
+    s->mapped = mapped;
+    s->records = (const HistoryRecord *)(base + sizeof(HistoryHeader));
+    s->n_records = (size - sizeof(HistoryHeader)) / sizeof(HistoryRecord);
 }
 
-static void on_search_result_selected(GtkListBox *box, GtkListBoxRow *row, gpointer user_data)
+static HistorySeries *history_series_get(const std::string &station_id, const char *pollutant)
 {
-    if (!row)
-        return;
-    GtkBuilder *builder = GTK_BUILDER(user_data);
-
-    int idx = gtk_list_box_row_get_index(row);
-    select_search_result_by_index(builder, idx);
+    std::string key = station_id + "/" + pollutant;
+    auto it = history_series.find(key);
+    if (it != history_series.end())
+        return it->second;
+
+    HistorySeries *s = new HistorySeries();
+    s->path = history_series_path(station_id, pollutant);
+    s->mapped = NULL;
+    s->records = NULL;
+    s->n_records = 0;
+    history_series_map(s);
+    history_series[key] = s;
+    return s;
 }
 
-static void populate_search_dropdown(GtkBuilder *builder)
+// Index of the first record at or after `time`
+static size_t history_series_lower_bound(const HistorySeries *s, guint32 time)
 {
-    GObject *dropdown_obj = gtk_builder_get_object(builder, "search_dropdown");
-    GObject *listbox_obj = gtk_builder_get_object(builder, "search_results_list");
+    const HistoryRecord *begin = s->records;
+    const HistoryRecord *end = s->records + s->n_records;
+    const HistoryRecord *it = std::lower_bound(
+        begin, end, time, [](const HistoryRecord &r, guint32 t) { return r.time < t; });
+    return (size_t)(it - begin);
+}
 
-    if (!dropdown_obj || !listbox_obj)
+// Replaces the file with its records from `first` on. The mapping is dropped
+// first so the file can be replaced on every platform.
+static void history_series_rewrite(HistorySeries *s, size_t first)
+{
+    size_t live = s->n_records - first;
+    gsize size = sizeof(HistoryHeader) + live * sizeof(HistoryRecord);
+    char *buffer = (char *)g_malloc(size);
+    HistoryHeader header = {HISTORY_MAGIC, HISTORY_VERSION};
+    memcpy(buffer, &header, sizeof(header));
+    if (live > 0)
+        memcpy(buffer + sizeof(header), s->records + first, live * sizeof(HistoryRecord));
+
+    history_series_unmap(s);
+    GError *error = NULL;
+    if (!g_file_set_contents(s->path, buffer, (gssize)size, &error))
     {
-        g_print("Search dropdown UI elements not found!\n");
-        return;
+        g_printerr("Failed to rewrite %s: %s\n", s->path, error->message);
+        g_error_free(error);
     }
+    g_free(buffer);
+    history_series_map(s);
+}
+
+static void history_series_compact(HistorySeries *s, guint32 now)
+{
+    guint32 cutoff = now - HISTORY_RETENTION_HOURS * 3600;
+    size_t expired = history_series_lower_bound(s, cutoff);
+    if (expired * 2 > s->n_records)
+        history_series_rewrite(s, expired);
+}
 
-    GtkListBox *listbox = GTK_LIST_BOX(listbox_obj);
+// True if the file holds exactly the mapped records, i.e. no torn tail
+static bool history_series_intact(const HistorySeries *s)
+{
+    GStatBuf st;
+    return g_stat(s->path, &st) == 0 &&
+           (gsize)st.st_size == sizeof(HistoryHeader) + s->n_records * sizeof(HistoryRecord);
+}
 
-    GtkWidget *child;
-    while ((child = gtk_widget_get_first_child(GTK_WIDGET(listbox))) != NULL)
+// Stamps points the feed sent without times. They are taken to be the
+// latest consecutive hours, so the longest run at their start that repeats
+// the stored tail is already stored, and nothing is new unless the feed has
+// advanced past it. New points get the hours up to the current one, and
+// never one at or before the last stored hour.
+static void history_place_untimed(const HistorySeries *s, const HistoryRecord *points, size_t n_points,
+                                  std::vector<HistoryRecord> &out)
+{
+    size_t stored = 0;
+    for (size_t k = std::min(n_points, s->n_records); k > 0 && stored == 0; k--)
     {
-        gtk_list_box_remove(listbox, child);
+        const HistoryRecord *tail = s->records + s->n_records - k;
+        size_t j = 0;
+        while (j < k && tail[j].value == points[j].value)
+            j++;
+        if (j == k)
+            stored = k;
     }
 
-    for (const auto &result : search_results)
-    {
-        GtkWidget *row = gtk_list_box_row_new();
-        GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
-        gtk_widget_set_margin_start(box, 10);
-        gtk_widget_set_margin_end(box, 10);
-        gtk_widget_set_margin_top(box, 8);
-        gtk_widget_set_margin_bottom(box, 8);
+    size_t fresh = n_points - stored;
+    guint32 hour = (guint32)(g_get_real_time() / G_USEC_PER_SEC / 3600 * 3600);
+    guint32 last = s->n_records > 0 ? s->records[s->n_records - 1].time : 0;
+    guint32 first = hour - (guint32)(fresh > 0 ? fresh - 1 : 0) * 3600;
+    if (first <= last)
+        first = last + 3600;
 
-        GtkWidget *info_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
-        gtk_widget_set_hexpand(info_box, TRUE);
+    out.clear();
+    for (size_t i = 0; i < fresh; i++)
+        out.push_back({first + (guint32)i * 3600, points[stored + i].value});
+}
 
-        GtkWidget *name_label = gtk_label_new(result.station_name.c_str());
-        gtk_label_set_xalign(GTK_LABEL(name_label), 0);
-        gtk_widget_add_css_class(name_label, "heading");
+// Appends the points (oldest first) that are newer than the last stored one.
+// Points with a time of 0 are placed by history_place_untimed.
+static void history_append(const std::string &station_id, const char *pollutant, const HistoryRecord *points,
+                           size_t n_points)
+{
+    if (station_id.empty() || n_points == 0)
+        return;
 
-        char subtitle[256];
-        snprintf(subtitle, sizeof(subtitle), "%s • %s", result.country.c_str(), result.source.c_str());
-        GtkWidget *subtitle_label = gtk_label_new(subtitle);
-        gtk_label_set_xalign(GTK_LABEL(subtitle_label), 0);
-        gtk_widget_add_css_class(subtitle_label, "dim-label");
-        gtk_widget_add_css_class(subtitle_label, "caption");
+    g_mutex_lock(&history_lock);
+    HistorySeries *s = history_series_get(station_id, pollutant);
+    std::vector<HistoryRecord> placed;
+    if (points[0].time == 0)
+    {
+        history_place_untimed(s, points, n_points, placed);
+        points = placed.data();
+        n_points = placed.size();
+    }
+    guint32 last = s->n_records > 0 ? s->records[s->n_records - 1].time : 0;
 
-        gtk_box_append(GTK_BOX(info_box), name_label);
-        gtk_box_append(GTK_BOX(info_box), subtitle_label);
+    size_t first_new = 0;
+    while (first_new < n_points && points[first_new].time <= last)
+        first_new++;
+    if (first_new == n_points)
+    {
+        g_mutex_unlock(&history_lock);
+        return;
+    }
 
-        GtkWidget *aqi_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
-        gtk_widget_set_valign(aqi_box, GTK_ALIGN_CENTER);
+    bool fresh = s->mapped == NULL;
+    if (fresh)
+    {
+        char *dir = g_path_get_dirname(s->path);
+        g_mkdir_with_parents(dir, 0700);
+        g_free(dir);
+    }
+    else if (!history_series_intact(s))
+    {
+        // Cut a record torn by an interrupted append before appending after it
+        history_series_rewrite(s, 0);
+    }
 
-        char aqi_str[16];
-        if (result.has_aqi)
+    // A missing or invalid file is started over
+    FILE *f = g_fopen(s->path, fresh ? "wb" : "ab");
+    if (f)
+    {
+        bool ok = true;
+        if (fresh)
         {
-            snprintf(aqi_str, sizeof(aqi_str), "%d", result.aqi);
+            HistoryHeader header = {HISTORY_MAGIC, HISTORY_VERSION};
+            ok = fwrite(&header, sizeof(header), 1, f) == 1;
         }
-        else
-        {
-            snprintf(aqi_str, sizeof(aqi_str), "--");
-        }
-        GtkWidget *aqi_label = gtk_label_new(aqi_str);
-        gtk_widget_add_css_class(aqi_label, "title-2");
 
-        if (result.has_aqi)
-        {
-            if (result.aqi <= 50)
-                gtk_widget_add_css_class(aqi_label, "aqi-good");
-            else if (result.aqi <= 100)
-                gtk_widget_add_css_class(aqi_label, "aqi-ok");
-            else
-                gtk_widget_add_css_class(aqi_label, "aqi-bad");
-        }
+        size_t count = n_points - first_new;
+        ok = ok && fwrite(points + first_new, sizeof(HistoryRecord), count, f) == count;
+        if (fclose(f) != 0 || !ok)
+            g_printerr("Failed to append to %s\n", s->path);
+    }
+    else
+    {
+        g_printerr("Failed to open %s\n", s->path);
+    }
 
-        gtk_box_append(GTK_BOX(aqi_box), aqi_label);
+    history_series_map(s);
+    history_series_compact(s, points[n_points - 1].time);
+    g_mutex_unlock(&history_lock);
+}
 
-        gtk_box_append(GTK_BOX(box), info_box);
-        gtk_box_append(GTK_BOX(box), aqi_box);
+// Fills `out` with the values of the last `hours` hours, oldest first.
+static void history_read(const std::string &station_id, const char *pollutant, int hours,
+                         std::vector<double> &out)
+{
+    out.clear();
+    if (station_id.empty())
+        return;
 
-        gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(row), box);
-        gtk_list_box_append(listbox, row);
+    g_mutex_lock(&history_lock);
+    HistorySeries *s = history_series_get(station_id, pollutant);
+    if (s->n_records > 0)
+    {
+        guint32 newest = s->records[s->n_records - 1].time;
+        guint32 since = newest > (guint32)(hours - 1) * 3600 ? newest - (guint32)(hours - 1) * 3600 : 0;
+        for (size_t i = history_series_lower_bound(s, since); i < s->n_records; i++)
+            out.push_back(s->records[i].value);
     }
+    g_mutex_unlock(&history_lock);
+}
 
-    gtk_widget_set_visible(GTK_WIDGET(dropdown_obj), !search_results.empty());
+// Loads the stored histories of a station, e.g. before its feed connects
+static void history_load_station(WAQIStationData &station)
+{
+    for (const PollutantField &field : pollutant_fields)
+    {
+        if (field.history)
+            history_read(station.station_id, field.history, HISTORY_CHART_HOURS, station.*field.series);
+    }
 }
-#endif
 
-// --- LibSoup Network Test Logic (Added) ---
+// --- Station Snapshot Cache ---
+// The last decoded state of each station is kept as one small binary file:
+// a fixed header with the scalar fields, then the station name, url and
+// attribution. Histories are not repeated here, they come from the history
+// store. Decode jobs rewrite the file, off the main loop, after a batch of
+// events that changed what it records; selecting a station maps it and
+// shows the values, marked stale, until the feed delivers. The last
+// selected station is remembered so the next launch starts from its
+// snapshot, which also seeds the station's decoder.
+
+#define SNAPSHOT_MAGIC 0x53514141 // "AAQS"
+#define SNAPSHOT_VERSION 1
 
-static void on_network_test_complete(GObject *source, GAsyncResult *result, gpointer user_data)
+typedef struct
 {
-    SoupSession *session = SOUP_SESSION(source);
-    GtkWidget *log_view = GTK_WIDGET(user_data);
+    guint32 magic;
+    guint32 version;
+    gint64 saved_at; // Unix seconds
+    double latitude;
+    double longitude;
+    double pm25;
+    double pm10;
+    double o3;
+    double no2;
+    double co;
+    double so2;
+    double temperature;
+    double humidity;
+    double wind_speed;
+    gint32 aqi;
+    gint32 wind_direction;
+    guint32 name_len;
+    guint32 url_len;
+    guint32 attribution_len;
+    guint32 reserved;
+} StationSnapshotHeader;
+
+static char *station_snapshot_dir()
+{
+    return g_build_filename(g_get_user_cache_dir(), "aqi-dashboard", "stations", NULL);
+}
+
+static char *station_snapshot_path(const std::string &station_id)
+{
+    std::string file_name = station_file_name(station_id) + ".snap";
+    char *dir = station_snapshot_dir();
+    char *path = g_build_filename(dir, file_name.c_str(), NULL);
+    g_free(dir);
+    return path;
+}
+
+// The file contents for `station` with saved_at left 0, so two encodings
+// compare equal exactly when the recorded state is the same. Empty if
+// there is nothing worth recording.
+static void station_snapshot_encode(const WAQIStationData &station, std::string &contents)
+{
+    contents.clear();
+    if (station.station_id.empty() || !station.has_data)
+        return;
+
+    StationSnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = SNAPSHOT_MAGIC;
+    h.version = SNAPSHOT_VERSION;
+    h.latitude = station.latitude;
+    h.longitude = station.longitude;
+    h.pm25 = station.pm25;
+    h.pm10 = station.pm10;
+    h.o3 = station.o3;
+    h.no2 = station.no2;
+    h.co = station.co;
+    h.so2 = station.so2;
+    h.temperature = station.temperature;
+    h.humidity = station.humidity;
+    h.wind_speed = station.wind_speed;
+    h.aqi = station.aqi;
+    h.wind_direction = station.wind_direction;
+    h.name_len = (guint32)station.station_name.size();
+    h.url_len = (guint32)station.station_url.size();
+    h.attribution_len = (guint32)station.attribution.size();
+
+    contents.append((const char *)&h, sizeof(h));
+    contents += station.station_name;
+    contents += station.station_url;
+    contents += station.attribution;
+}
+
+// Called from decode jobs with an encoding from station_snapshot_encode.
+// The file is stamped with the current time and replaced atomically;
+// `contents` is left as it was passed in.
+static void station_snapshot_write(const std::string &station_id, std::string &contents)
+{
+    gint64 saved_at = g_get_real_time() / G_USEC_PER_SEC;
+    size_t saved_at_offset = offsetof(StationSnapshotHeader, saved_at);
+    memcpy(&contents[saved_at_offset], &saved_at, sizeof(saved_at));
+
+    char *dir = station_snapshot_dir();
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
 
+    char *path = station_snapshot_path(station_id);
     GError *error = NULL;
-    GBytes *bytes = soup_session_send_and_read_finish(session, result, &error);
+    if (!g_file_set_contents(path, contents.data(), (gssize)contents.size(), &error))
+    {
+        g_printerr("Failed to write %s: %s\n", path, error->message);
+        g_clear_error(&error);
+    }
+    g_free(path);
 
-    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(log_view));
-    std::string log_text;
+    saved_at = 0;
+    memcpy(&contents[saved_at_offset], &saved_at, sizeof(saved_at));
+}
 
-    if (error)
+// Fills `out` from the stored snapshot; false if there is none or it is unusable
+static bool station_snapshot_load(const std::string &station_id, WAQIStationData &out)
+{
+    char *path = station_snapshot_path(station_id);
+    GMappedFile *mapped = g_mapped_file_new(path, FALSE, NULL);
+    if (!mapped)
     {
-        log_text = "ERROR: ";
-        log_text += error->message;
-        g_error_free(error);
+        g_free(path);
+        return false;
     }
-    else
+
+    gsize size = g_mapped_file_get_length(mapped);
+    const char *base = g_mapped_file_get_contents(mapped);
+    StationSnapshotHeader h;
+    bool ok = size >= sizeof(h);
+    if (ok)
     {
-        log_text = "STATUS: Success (200 OK)\n";
-        guint status = soup_message_get_status(soup_session_get_async_result_message(session, result));
-        char status_buf[64];
-        snprintf(status_buf, sizeof(status_buf), "HTTP Status: %u\n", status);
-        log_text += status_buf;
+        memcpy(&h, base, sizeof(h));
+        ok = h.magic == SNAPSHOT_MAGIC && h.version == SNAPSHOT_VERSION &&
+             size == sizeof(h) + (gsize)h.name_len + h.url_len + h.attribution_len;
+    }
+    if (!ok)
+    {
+        g_printerr("Ignoring invalid station snapshot %s\n", path);
+        g_mapped_file_unref(mapped);
+        g_free(path);
+        return false;
+    }
 
-        if (bytes)
-        {
-            gsize size = 0;
-            const char *data = (const char *)g_bytes_get_data(bytes, &size);
+    const char *p = base + sizeof(h);
+    out.station_id = station_id;
+    out.station_name.assign(p, h.name_len);
+    p += h.name_len;
+    out.station_url.assign(p, h.url_len);
+    p += h.url_len;
+    out.attribution.assign(p, h.attribution_len);
+    out.latitude = h.latitude;
+    out.longitude = h.longitude;
+    out.pm25 = h.pm25;
+    out.pm10 = h.pm10;
+    out.o3 = h.o3;
+    out.no2 = h.no2;
+    out.co = h.co;
+    out.so2 = h.so2;
+    out.temperature = h.temperature;
+    out.humidity = h.humidity;
+    out.wind_speed = h.wind_speed;
+    out.aqi = h.aqi;
+    out.wind_direction = h.wind_direction;
+    out.has_data = true;
+    out.stale = true;
+
+    g_mapped_file_unref(mapped);
+    g_free(path);
+    return true;
+}
 
-            if (g_utf8_validate(data, size, NULL))
-            {
-                log_text += "\n--- RESPONSE BODY ---\n";
-                // Truncate if too long
-                if (size > 1024)
-                {
-                    log_text += std::string(data, 1024);
-                    log_text += "\n...[truncated]...";
-                }
-                else
-                {
-                    log_text += std::string(data, size);
-                }
-            }
-            else
-            {
-                log_text += "\n[Binary or Invalid UTF-8 Data Received]";
-            }
-            g_bytes_unref(bytes);
-        }
-        else
+static char *station_snapshot_last_path()
+{
+    char *dir = station_snapshot_dir();
+    char *path = g_build_filename(dir, "last-station", NULL);
+    g_free(dir);
+    return path;
+}
+
+static void on_last_station_written(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GError *error = NULL;
+    if (!g_file_replace_contents_finish(G_FILE(source), result, NULL, &error))
+    {
+        g_printerr("Failed to remember the last station: %s\n", error->message);
+        g_clear_error(&error);
+    }
+}
+
+// Main thread: remembers the selected station for the next launch
+static void station_snapshot_remember(const std::string &station_id)
+{
+    char *dir = station_snapshot_dir();
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    char *path = station_snapshot_last_path();
+    GFile *file = g_file_new_for_path(path);
+    GBytes *contents = g_bytes_new(station_id.data(), station_id.size());
+    g_file_replace_contents_bytes_async(file, contents, NULL, FALSE, G_FILE_CREATE_REPLACE_DESTINATION, NULL,
+                                        on_last_station_written, NULL);
+    g_bytes_unref(contents);
+    g_object_unref(file);
+    g_free(path);
+}
+
+// Decodes one SSE event into `station` and keeps the means of an hourly
+// event in the history store. Apart from that store, which is safe to use
+// from any thread, it touches no global state, so it runs on the decode
+// pool rather than the main loop.
+static void parse_sse_event(WAQIStationData &station, const char *json_data, size_t len)
+{
+    WAQIHourlyMeans hourly;
+    if (waqi_decode_event(station, json_data, len, &hourly) != WAQI_EVENT_HOURLY)
+        return;
+
+    // Only the hours not yet stored are appended; the histories are then
+    // read back so they also cover the days before this session.
+    for (size_t i = 0; i < N_POLLUTANT_FIELDS; i++)
+    {
+        const PollutantField &field = pollutant_fields[i];
+        const HistoryRecord *points = hourly.points[i];
+        size_t n_points = hourly.n_points[i];
+        if (!field.history || n_points == 0)
+            continue;
+        history_append(station.station_id, field.history, points, n_points);
+        history_read(station.station_id, field.history, HISTORY_CHART_HOURS, station.*field.series);
+
+        // Without a usable store, fall back to the event's own points
+        if ((station.*field.series).empty())
         {
-            log_text += "\n(Empty Response Body)";
+            for (size_t j = 0; j < n_points; j++)
+                (station.*field.series).push_back(points[j].value);
         }
     }
+}
 
-    gtk_text_buffer_set_text(buffer, log_text.c_str(), -1);
+// --- SSE Decoding ---
+// Events are decoded on a shared thread pool into a decoder-owned
+// WAQIStationData. After each drained batch the worker publishes a copy as
+// the latest snapshot and the main loop picks it up in a single coalesced
+// idle callback, so a burst of events costs one UI update. Jobs for one
+// decoder never overlap, which keeps events of a stream in order while
+// separate streams decode in parallel.
+
+typedef struct
+{
+    gint ref_count;
+    GMutex lock;
+
+    // Guarded by lock
+    GQueue events; // GBytes payloads waiting to be decoded
+    bool job_queued;
+    WAQIStationData *pending; // Latest snapshot not yet picked up by the UI
+    bool publish_queued;
+
+    // Only touched by the pool job currently running this decoder
+    WAQIStationData state;
+    std::string saved; // Snapshot encoding last written or loaded
+
+    // Main thread only
+    bool detached;          // Owning stream is gone, drop further snapshots
+    WAQIStationData latest; // Last snapshot published to the main loop
+} SseDecoder;
+
+static GThreadPool *sse_decode_pool = NULL;
+
+static SseDecoder *sse_decoder_new(const std::string &station_id)
+{
+    SseDecoder *decoder = new SseDecoder();
+    decoder->ref_count = 1;
+    g_mutex_init(&decoder->lock);
+    g_queue_init(&decoder->events);
+    decoder->state.station_id = station_id;
+
+    // Start from the snapshot the dashboard shows meanwhile, so events that
+    // arrive before the first `meta` keep its name and location
+    if (station_snapshot_load(station_id, decoder->state))
+        station_snapshot_encode(decoder->state, decoder->saved);
+    history_load_station(decoder->state);
+    return decoder;
 }
 
-static void on_network_test_clicked(GtkButton *button, gpointer user_data)
+static SseDecoder *sse_decoder_ref(SseDecoder *decoder)
 {
-    // user_data is the GtkEntry
-    GtkWidget *entry = GTK_WIDGET(user_data);
+    g_atomic_int_inc(&decoder->ref_count);
+    return decoder;
+}
 
-    // Retrieve the text view from the entry's data
-    GtkWidget *log_view = GTK_WIDGET(g_object_get_data(G_OBJECT(entry), "log_view"));
-    if (!log_view)
+static void sse_decoder_unref(SseDecoder *decoder)
+{
+    if (!g_atomic_int_dec_and_test(&decoder->ref_count))
         return;
+    g_queue_clear_full(&decoder->events, (GDestroyNotify)g_bytes_unref);
+    delete decoder->pending;
+    g_mutex_clear(&decoder->lock);
+    delete decoder;
+}
 
-    const char *url = gtk_editable_get_text(GTK_EDITABLE(entry));
-    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(log_view));
+// Main thread: mirrors a decoded snapshot into the dashboard state.
+static void apply_station_snapshot(WAQIStationData *snapshot)
+{
+    current_station_data = std::move(*snapshot);
 
-    if (!url || !*url)
+    if (g_current_builder && current_station_data.has_data)
     {
-        gtk_text_buffer_set_text(buffer, "Error: Please enter a URL.", -1);
-        return;
+        current_aqi_data.aqi = current_station_data.aqi;
+        current_aqi_data.pm25 = current_station_data.pm25;
+        current_aqi_data.pm10 = current_station_data.pm10;
+
+        set_aqi_status(current_aqi_data);
+
+        if (!current_station_data.pm25_history.empty())
+        {
+            current_aqi_data.history.clear();
+            for (double val : current_station_data.pm25_history)
+            {
+                current_aqi_data.history.push_back((int)val);
+            }
+        }
+        while (current_aqi_data.history.size() < 24)
+        {
+            current_aqi_data.history.insert(current_aqi_data.history.begin(), current_aqi_data.aqi);
+        }
+
+        update_aqi_display(g_current_builder);
     }
+}
 
-    gtk_text_buffer_set_text(buffer, "Sending request...\nWaiting for response...", -1);
 
-    SoupSession *session = soup_session_new();
-    SoupMessage *msg = soup_message_new("GET", url);
+static gboolean on_sse_decoder_publish(gpointer user_data)
+{
+    SseDecoder *decoder = (SseDecoder *)user_data;
+
+    g_mutex_lock(&decoder->lock);
+    WAQIStationData *snapshot = decoder->pending;
+    decoder->pending = NULL;
+    decoder->publish_queued = false;
+    g_mutex_unlock(&decoder->lock);
 
-    if (!msg)
+    if (snapshot && !decoder->detached)
     {
-        gtk_text_buffer_set_text(buffer, "Error: Invalid URL format.", -1);
-        g_object_unref(session);
-        return;
+        decoder->latest = *snapshot;
+        if (snapshot->station_id == current_sse_station_id)
+            apply_station_snapshot(snapshot);
     }
 
-    soup_session_send_and_read_async(
-        session,
-        msg,
-        G_PRIORITY_DEFAULT,
-        NULL,
-        on_network_test_complete,
-        log_view);
-
-    g_object_unref(msg);
-    g_object_unref(session);
+    delete snapshot;
+    sse_decoder_unref(decoder);
+    return G_SOURCE_REMOVE;
 }
 
-static void update_aqi_display(GtkBuilder *builder)
+static void sse_decode_worker(gpointer data, gpointer user_data)
 {
-    GObject *result_box_obj = gtk_builder_get_object(builder, "aqi_result_box");
-    if (!result_box_obj)
-        return;
+    SseDecoder *decoder = (SseDecoder *)data;
 
-    GtkLabel *lbl_city = GTK_LABEL(gtk_builder_get_object(builder, "lbl_city_name"));
-    GtkLabel *lbl_aqi = GTK_LABEL(gtk_builder_get_object(builder, "lbl_aqi_value"));
-    GtkLabel *lbl_status = GTK_LABEL(gtk_builder_get_object(builder, "lbl_aqi_status"));
-    GtkLabel *lbl_pm25 = GTK_LABEL(gtk_builder_get_object(builder, "lbl_pm25"));
-    GtkLabel *lbl_pm10 = GTK_LABEL(gtk_builder_get_object(builder, "lbl_pm10"));
+    std::string encoded;
+    while (true)
+    {
+        g_mutex_lock(&decoder->lock);
+        GBytes *event = (GBytes *)g_queue_pop_head(&decoder->events);
+        if (!event)
+        {
+            decoder->job_queued = false;
+            g_mutex_unlock(&decoder->lock);
+            break;
+        }
+        bool last = g_queue_is_empty(&decoder->events);
+        g_mutex_unlock(&decoder->lock);
 
-    char buffer[64];
+        gsize size = 0;
+        const char *json = (const char *)g_bytes_get_data(event, &size);
+        {
+            TRACE_SPAN("parse_sse_event");
+            parse_sse_event(decoder->state, json, size - 1);
+        }
+        decoder->state.stale = false; // Heard from the feed
+        g_bytes_unref(event);
 
-    if (lbl_city)
-        gtk_label_set_text(lbl_city, current_aqi_data.city);
+        if (!last)
+            continue;
 
-    if (lbl_aqi)
-    {
-        snprintf(buffer, sizeof(buffer), "%d", current_aqi_data.aqi);
-        gtk_label_set_text(lbl_aqi, buffer);
+        // Rewrite the snapshot only if the batch changed what it records
+        station_snapshot_encode(decoder->state, encoded);
+        if (!encoded.empty() && encoded != decoder->saved)
+        {
+            station_snapshot_write(decoder->state.station_id, encoded);
+            decoder->saved.swap(encoded);
+        }
+
+        // Queue drained: publish what we have, replacing any snapshot the
+        // UI has not picked up yet.
+        WAQIStationData *snapshot = new WAQIStationData(decoder->state);
+
+        g_mutex_lock(&decoder->lock);
+        WAQIStationData *stale = decoder->pending;
+        decoder->pending = snapshot;
+        bool queue_publish = !decoder->publish_queued;
+        decoder->publish_queued = true;
+        g_mutex_unlock(&decoder->lock);
+
+        delete stale;
+        if (queue_publish)
+            g_idle_add(on_sse_decoder_publish, sse_decoder_ref(decoder));
     }
 
-    if (lbl_status)
-        gtk_label_set_text(lbl_status, current_aqi_data.status);
+    sse_decoder_unref(decoder);
+}
 
-    if (lbl_pm25)
+// Main thread: queues a copy of one framed event on the decoder.
+static void sse_decoder_push(SseDecoder *decoder, const char *data, size_t len)
+{
+    if (!sse_decode_pool)
     {
-        snprintf(buffer, sizeof(buffer), "PM2.5: %.1f µg/m³", current_aqi_data.pm25);
-        gtk_label_set_text(lbl_pm25, buffer);
+        sse_decode_pool = g_thread_pool_new(sse_decode_worker, NULL, (gint)g_get_num_processors(), FALSE, NULL);
     }
 
-    if (lbl_pm10)
+    // The payload is NUL-terminated for the strstr-based field lookups
+    GBytes *event = g_bytes_new(data, len + 1);
+
+    g_mutex_lock(&decoder->lock);
+    g_queue_push_tail(&decoder->events, event);
+    bool queue_job = !decoder->job_queued;
+    decoder->job_queued = true;
+    g_mutex_unlock(&decoder->lock);
+
+    if (queue_job)
+        g_thread_pool_push(sse_decode_pool, sse_decoder_ref(decoder), NULL);
+}
+
+static void on_sse_event(const char *data, size_t len, gpointer user_data)
+{
+    sse_decoder_push((SseDecoder *)user_data, data, len);
+}
+
+// --- SSE Stream Manager ---
+// Any number of station feeds can be live at once, keyed by station id and
+// multiplexed over the shared HTTP client session. Each stream owns its framer and
+// decoder, reconnects with exponential backoff (or the server's retry:
+// value) and resumes with Last-Event-ID. Subscriptions past the
+// concurrency cap wait for a free slot. The dashboard shows whichever
+// station is current_sse_station_id.
+
+#define SSE_MAX_ACTIVE_STREAMS 64
+#define SSE_BACKOFF_INITIAL_MS 1000
+#define SSE_BACKOFF_MAX_MS 60000
+
+// Without HTTP/2 every live feed holds its own connection
+static_assert(SSE_MAX_ACTIVE_STREAMS <= HTTP_MAX_CONNS_PER_HOST, "SSE streams would stall on connection slots");
+
+typedef struct
+{
+    gint ref_count;
+    std::string station_id;
+    bool closed; // Unsubscribed; pending callbacks only drop their ref
+
+    SoupMessage *msg;
+    GCancellable *cancellable;
+    GInputStream *stream;
+    SseFramer framer;
+    SseDecoder *decoder;
+
+    guint reconnect_source;
+    guint attempts; // Consecutive failed connections, resets on data
+} SseStream;
+
+static std::map<std::string, SseStream *> sse_streams;
+static std::vector<std::string> sse_waiting_streams;
+static guint sse_active_count = 0;
+
+static void sse_stream_connect(SseStream *s);
+
+static SseStream *sse_stream_ref(SseStream *s)
+{
+    s->ref_count++;
+    return s;
+}
+
+static void sse_stream_unref(SseStream *s)
+{
+    if (--s->ref_count > 0)
+        return;
+    g_clear_object(&s->msg);
+    g_clear_object(&s->cancellable);
+    g_clear_object(&s->stream);
+    g_free(s->framer.data);
+    sse_decoder_unref(s->decoder);
+    delete s;
+}
+
+// Tears down the current connection, keeping framer id/retry state.
+static void sse_stream_disconnect(SseStream *s)
+{
+    if (s->cancellable)
     {
-        snprintf(buffer, sizeof(buffer), "PM10: %.1f µg/m³", current_aqi_data.pm10);
-        gtk_label_set_text(lbl_pm10, buffer);
+        g_cancellable_cancel(s->cancellable);
+        g_clear_object(&s->cancellable);
     }
+    // A read may still be pending on the stream; it is closed once that
+    // read returns cancelled and drops the last reference.
+    g_clear_object(&s->stream);
+    g_clear_object(&s->msg);
+    sse_framer_reset(&s->framer);
+}
+
+static gboolean on_sse_reconnect(gpointer user_data)
+{
+    SseStream *s = (SseStream *)user_data;
+    s->reconnect_source = 0;
+    if (!s->closed)
+        sse_stream_connect(s);
+    return G_SOURCE_REMOVE;
+}
 
-    GtkLabel *lbl_o3 = GTK_LABEL(gtk_builder_get_object(builder, "lbl_o3"));
-    GtkLabel *lbl_no2 = GTK_LABEL(gtk_builder_get_object(builder, "lbl_no2"));
-    GtkLabel *lbl_co = GTK_LABEL(gtk_builder_get_object(builder, "lbl_co"));
-    GtkLabel *lbl_so2 = GTK_LABEL(gtk_builder_get_object(builder, "lbl_so2"));
+static void sse_stream_schedule_reconnect(SseStream *s)
+{
+    sse_stream_disconnect(s);
+    if (s->closed || s->reconnect_source)
+        return;
 
-    if (lbl_o3 && current_station_data.has_data)
+    guint delay = s->framer.retry_ms;
+    if (delay == 0)
     {
-        snprintf(buffer, sizeof(buffer), "O₃: %.1f ppb", current_station_data.o3);
-        gtk_label_set_text(lbl_o3, buffer);
+        delay = SSE_BACKOFF_INITIAL_MS;
+        for (guint i = 0; i < s->attempts && delay < SSE_BACKOFF_MAX_MS; i++)
+            delay *= 2;
+        if (delay > SSE_BACKOFF_MAX_MS)
+            delay = SSE_BACKOFF_MAX_MS;
+        // Jitter so a wall of streams dropped together does not reconnect in lockstep
+        delay += g_random_int_range(0, delay / 4 + 1);
     }
+    s->attempts++;
+
+    g_print("SSE stream %s reconnecting in %u ms\n", s->station_id.c_str(), delay);
+    s->reconnect_source = g_timeout_add_full(G_PRIORITY_DEFAULT, delay, on_sse_reconnect,
+                                             sse_stream_ref(s), (GDestroyNotify)sse_stream_unref);
+}
+
+static void sse_read_next_chunk(SseStream *s);
 
-    if (lbl_no2 && current_station_data.has_data)
+static void on_sse_read_complete(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    GInputStream *stream = G_INPUT_STREAM(source);
+    SseStream *s = (SseStream *)user_data;
+    GError *error = NULL;
+
+    gssize bytes_read = g_input_stream_read_finish(stream, result, &error);
+
+    if (s->closed || stream != s->stream)
     {
-        snprintf(buffer, sizeof(buffer), "NO₂: %.1f ppb", current_station_data.no2);
-        gtk_label_set_text(lbl_no2, buffer);
+        g_clear_error(&error);
+        sse_stream_unref(s);
+        return;
     }
 
-    if (lbl_co && current_station_data.has_data)
+    if (error)
     {
-        snprintf(buffer, sizeof(buffer), "CO: %.1f ppm", current_station_data.co / 1000.0);
-        gtk_label_set_text(lbl_co, buffer);
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_printerr("SSE read error (%s): %s\n", s->station_id.c_str(), error->message);
+            sse_stream_schedule_reconnect(s);
+        }
+        g_clear_error(&error);
+        sse_stream_unref(s);
+        return;
     }
 
-    if (lbl_so2 && current_station_data.has_data)
+    if (bytes_read <= 0)
     {
-        snprintf(buffer, sizeof(buffer), "SO₂: %.2f ppb", current_station_data.so2);
-        gtk_label_set_text(lbl_so2, buffer);
+        g_print("SSE stream ended (%s)\n", s->station_id.c_str());
+        sse_stream_schedule_reconnect(s);
+        sse_stream_unref(s);
+        return;
     }
 
-    GtkLabel *lbl_temp = GTK_LABEL(gtk_builder_get_object(builder, "lbl_temperature"));
-    GtkLabel *lbl_humidity = GTK_LABEL(gtk_builder_get_object(builder, "lbl_humidity"));
-    GtkLabel *lbl_wind = GTK_LABEL(gtk_builder_get_object(builder, "lbl_wind"));
+    s->attempts = 0;
+    sse_framer_feed(&s->framer, (size_t)bytes_read);
+
+    sse_read_next_chunk(s);
+    sse_stream_unref(s);
+}
+
+static void sse_read_next_chunk(SseStream *s)
+{
+    size_t avail = 0;
+    char *dest = sse_framer_reserve(&s->framer, &avail);
+
+    g_input_stream_read_async(
+        s->stream,
+        dest,
+        avail,
+        G_PRIORITY_DEFAULT,
+        s->cancellable,
+        on_sse_read_complete,
+        sse_stream_ref(s));
+}
+
+static void on_sse_send_complete(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    SoupSession *session = SOUP_SESSION(source);
+    SseStream *s = (SseStream *)user_data;
+    GError *error = NULL;
+
+    GInputStream *stream = soup_session_send_finish(session, result, &error);
 
-    if (lbl_temp && current_station_data.has_data)
+    if (s->closed || soup_session_get_async_result_message(session, result) != s->msg)
     {
-        snprintf(buffer, sizeof(buffer), "🌡️ %.1f°C", current_station_data.temperature);
-        gtk_label_set_text(lbl_temp, buffer);
+        g_clear_error(&error);
+        g_clear_object(&stream);
+        sse_stream_unref(s);
+        return;
     }
 
-    if (lbl_humidity && current_station_data.has_data)
+    if (error)
     {
-        snprintf(buffer, sizeof(buffer), "💧 %.0f%%", current_station_data.humidity);
-        gtk_label_set_text(lbl_humidity, buffer);
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_printerr("SSE connection failed (%s): %s\n", s->station_id.c_str(), error->message);
+            sse_stream_schedule_reconnect(s);
+        }
+        g_clear_error(&error);
+        sse_stream_unref(s);
+        return;
     }
 
-    if (lbl_wind && current_station_data.has_data)
+    guint status = soup_message_get_status(s->msg);
+    if (!SOUP_STATUS_IS_SUCCESSFUL(status))
     {
-        const char *wind_dir = "";
-        int wd = current_station_data.wind_direction;
-        if (wd >= 337 || wd < 22)
-            wind_dir = "N";
-        else if (wd < 67)
-            wind_dir = "NE";
-        else if (wd < 112)
-            wind_dir = "E";
-        else if (wd < 157)
-            wind_dir = "SE";
-        else if (wd < 202)
-            wind_dir = "S";
-        else if (wd < 247)
-            wind_dir = "SW";
-        else if (wd < 292)
-            wind_dir = "W";
-        else
-            wind_dir = "NW";
-        snprintf(buffer, sizeof(buffer), "💨 %.1f m/s %s", current_station_data.wind_speed, wind_dir);
-        gtk_label_set_text(lbl_wind, buffer);
+        g_printerr("SSE connection failed (%s): HTTP %u\n", s->station_id.c_str(), status);
+        g_object_unref(stream);
+        sse_stream_schedule_reconnect(s);
+        sse_stream_unref(s);
+        return;
     }
 
-    GtkLabel *lbl_advice = GTK_LABEL(gtk_builder_get_object(builder, "lbl_health_advice"));
-    if (lbl_advice)
+    g_print("SSE stream connected: %s\n", s->station_id.c_str());
+    s->stream = stream;
+    sse_framer_reset(&s->framer);
+
+    sse_read_next_chunk(s);
+    sse_stream_unref(s);
+}
+
+static void sse_stream_connect(SseStream *s)
+{
+    char url[256];
+    snprintf(url, sizeof(url), "https://airnet.waqi.info/airnet/sse/feed/%s", s->station_id.c_str());
+
+    g_print("Starting SSE stream: %s\n", url);
+
+    SoupMessage *msg = http_client_message_new("GET", url, HTTP_PRIORITY_STREAM);
+    if (!msg)
     {
-        const char *advice = "";
-        if (current_aqi_data.aqi <= 50)
-            advice = "Air quality is good. Enjoy outdoor activities!";
-        else if (current_aqi_data.aqi <= 100)
-            advice = "Air quality is acceptable. Sensitive groups should limit prolonged outdoor exertion.";
-        else if (current_aqi_data.aqi <= 150)
-            advice = "Unhealthy for sensitive groups. Reduce prolonged outdoor exertion.";
-        else if (current_aqi_data.aqi <= 200)
-            advice = "Unhealthy. Everyone may experience health effects.";
-        else if (current_aqi_data.aqi <= 300)
-            advice = "Very unhealthy. Avoid outdoor activities.";
+        // Retried like a dropped connection, so the stream keeps its slot
+        // and backs off rather than stalling for good
+        g_printerr("Failed to create SSE request (%s)\n", s->station_id.c_str());
+        sse_stream_schedule_reconnect(s);
+        return;
+    }
+
+    SoupMessageHeaders *headers = soup_message_get_request_headers(msg);
+    soup_message_headers_append(headers, "Accept", "text/event-stream");
+    soup_message_headers_append(headers, "Cache-Control", "no-cache");
+    if (s->framer.last_event_id[0])
+        soup_message_headers_append(headers, "Last-Event-ID", s->framer.last_event_id);
+
+    s->msg = msg;
+    s->cancellable = g_cancellable_new();
+
+    soup_session_send_async(
+        http_client_session(),
+        msg,
+        http_client_io_priority(HTTP_PRIORITY_STREAM),
+        s->cancellable,
+        on_sse_send_complete,
+        sse_stream_ref(s));
+}
+
+static void sse_stream_start(const std::string &station_id)
+{
+    SseStream *s = new SseStream();
+    s->ref_count = 1;
+    s->station_id = station_id;
+    s->decoder = sse_decoder_new(station_id);
+    sse_framer_init(&s->framer, on_sse_event, s->decoder);
+
+    sse_streams[station_id] = s;
+    sse_active_count++;
+    sse_stream_connect(s);
+}
+
+// Feeds the dashboard moves away from stay connected for a grace period,
+// so flipping back to a recent station reuses its live stream and snapshot.
+#define SSE_LINGER_SECONDS 30
+
+static std::map<std::string, guint> sse_linger_sources; // By station id
+
+static void sse_manager_unsubscribe(const std::string &station_id);
+
+// Starts a feed for station_id unless one is already live or waiting.
+static void sse_manager_subscribe(const std::string &station_id)
+{
+    auto linger = sse_linger_sources.find(station_id);
+    if (linger != sse_linger_sources.end())
+    {
+        g_source_remove(linger->second);
+        sse_linger_sources.erase(linger);
+    }
+
+    if (sse_streams.count(station_id))
+        return;
+    for (const auto &id : sse_waiting_streams)
+    {
+        if (id == station_id)
+            return;
+    }
+
+    if (sse_active_count >= SSE_MAX_ACTIVE_STREAMS)
+    {
+        g_print("SSE stream %s queued, %u streams already active\n", station_id.c_str(), sse_active_count);
+        sse_waiting_streams.push_back(station_id);
+        return;
+    }
+
+    sse_stream_start(station_id);
+}
+
+static void sse_manager_unsubscribe(const std::string &station_id)
+{
+    auto linger = sse_linger_sources.find(station_id);
+    if (linger != sse_linger_sources.end())
+    {
+        g_source_remove(linger->second);
+        sse_linger_sources.erase(linger);
+    }
+
+    for (auto it = sse_waiting_streams.begin(); it != sse_waiting_streams.end(); ++it)
+    {
+        if (*it == station_id)
+        {
+            sse_waiting_streams.erase(it);
+            return;
+        }
+    }
+
+    auto it = sse_streams.find(station_id);
+    if (it == sse_streams.end())
+        return;
+
+    SseStream *s = it->second;
+    sse_streams.erase(it);
+    sse_active_count--;
+
+    s->closed = true;
+    s->decoder->detached = true;
+    if (s->reconnect_source)
+    {
+        g_source_remove(s->reconnect_source);
+        s->reconnect_source = 0;
+    }
+    sse_stream_disconnect(s);
+    sse_stream_unref(s);
+
+    if (!sse_waiting_streams.empty() && sse_active_count < SSE_MAX_ACTIVE_STREAMS)
+    {
+        std::string next = sse_waiting_streams.front();
+        sse_waiting_streams.erase(sse_waiting_streams.begin());
+        sse_stream_start(next);
+    }
+}
+
+static gboolean on_sse_linger_expired(gpointer user_data)
+{
+    char *station_id = (char *)user_data;
+    sse_linger_sources.erase(station_id);
+    sse_manager_unsubscribe(station_id);
+    return G_SOURCE_REMOVE;
+}
+
+// Drops interest in a feed: queued feeds go at once, live ones linger.
+static void sse_manager_release(const std::string &station_id)
+{
+    if (!sse_streams.count(station_id))
+    {
+        sse_manager_unsubscribe(station_id);
+        return;
+    }
+    if (sse_linger_sources.count(station_id))
+        return;
+    sse_linger_sources[station_id] = g_timeout_add_seconds_full(
+        G_PRIORITY_DEFAULT, SSE_LINGER_SECONDS, on_sse_linger_expired, g_strdup(station_id.c_str()), g_free);
+}
+
+// True if the dashboard already follows station_id with live data
+static bool waqi_station_is_current(const std::string &station_id)
+{
+    if (station_id != current_sse_station_id)
+        return false;
+    auto it = sse_streams.find(station_id);
+    return it != sse_streams.end() && it->second->decoder->latest.has_data;
+}
+
+static void waqi_fetch_station_data(const std::string &station_id, WAQIStationData &station_data)
+{
+    station_data.has_data = false;
+    station_data.station_id = station_id;
+
+    // The dashboard follows a single station; drop the previous one
+    if (!current_sse_station_id.empty() && current_sse_station_id != station_id)
+        sse_manager_release(current_sse_station_id);
+
+    current_sse_station_id = station_id;
+
+    // Reselecting a live station shows its last snapshot straight away
+    auto it = sse_streams.find(station_id);
+    if (it != sse_streams.end() && it->second->decoder->latest.has_data)
+    {
+        WAQIStationData snapshot = it->second->decoder->latest;
+        apply_station_snapshot(&snapshot);
+    }
+    else if (g_current_builder)
+    {
+        // Otherwise show the last-known values until the feed delivers, or
+        // at least chart the stored history
+        WAQIStationData cached = WAQIStationData();
+        if (station_snapshot_load(station_id, cached))
+        {
+            history_load_station(cached);
+            apply_station_snapshot(&cached);
+        }
         else
-            advice = "Hazardous! Avoid all outdoor activities.";
-        gtk_label_set_text(lbl_advice, advice);
+        {
+            std::vector<double> pm25;
+            history_read(station_id, "pm25", HISTORY_CHART_HOURS, pm25);
+            if (!pm25.empty())
+            {
+                current_aqi_data.history.clear();
+                for (double val : pm25)
+                    current_aqi_data.history.push_back((int)val);
+                update_aqi_display(g_current_builder);
+            }
+        }
     }
 
-    if (lbl_status)
+    station_snapshot_remember(station_id);
+    sse_manager_subscribe(station_id);
+    g_print("SSE stream started for station %s\n", station_id.c_str());
+}
+
+// Reopens the station selected in the previous session, starting from its
+// snapshot so the dashboard has values before the network answers.
+static void station_snapshot_warm_start(GtkBuilder *builder)
+{
+    char *path = station_snapshot_last_path();
+    char *station_id = NULL;
+    gsize length = 0;
+    bool found = g_file_get_contents(path, &station_id, &length, NULL) && length > 0;
+    g_free(path);
+
+    WAQIStationData cached = WAQIStationData();
+    if (!found || !station_snapshot_load(std::string(station_id, length), cached))
+    {
+        g_free(station_id);
+        return;
+    }
+    g_free(station_id);
+
+    GObject *entry_obj = gtk_builder_get_object(builder, "city_entry");
+    if (entry_obj)
+    {
+        g_signal_handlers_block_by_func(entry_obj, (gpointer)on_city_entry_changed, builder);
+        gtk_editable_set_text(GTK_EDITABLE(entry_obj), cached.station_name.c_str());
+        g_signal_handlers_unblock_by_func(entry_obj, (gpointer)on_city_entry_changed, builder);
+    }
+
+    g_free(g_api_city_name);
+    g_api_city_name = g_strdup(cached.station_name.c_str());
+    current_aqi_data.city = g_api_city_name;
+    current_aqi_data.history.clear();
+
+    g_current_builder = builder;
+    waqi_fetch_station_data(cached.station_id, current_station_data);
+}
+#endif
+
+// --- Live Data State & Helpers ---
+
+#define LIVE_CHART_WINDOW 24    // Samples shown on the live charts
+#define LIVE_CHART_MAX_CORES 64 // Per-core lines drawn on the CPU chart
+
+static MetricSeries<float> live_cpu_series;
+static MetricSeries<float> live_mem_series;
+static MetricSeries<float> live_net_series;
+
+// Per-core load only feeds the CPU chart's lines, so each ring just holds
+// the chart window. Grown on the main thread as cores show up.
+static std::vector<RingSeries<float>> live_core_series;
+
+// --- Chart Widget ---
+// AqiChart builds its frame as a render node tree in the snapshot vfunc, so
+// the series is stroked and filled by the GSK renderer (GL/Vulkan where
+// available) instead of being rasterized on the CPU and uploaded each frame.
+// The static layers come from aqi_chart.cpp, which the benchmarks also
+// render offscreen.
+
+#define AQI_TYPE_CHART (aqi_chart_get_type())
+G_DECLARE_FINAL_TYPE(AqiChart, aqi_chart, AQI, CHART, GtkWidget)
+
+struct _AqiChart
+{
+    GtkWidget parent_instance;
+
+    // Model, set once by the page that owns the chart. Without a live
+    // series the chart plots current_aqi_data.history.
+    const MetricSeries<float> *live_series;
+    const std::vector<RingSeries<float>> *live_lines; // Thin lines under the series, or NULL
+    ChartUnit unit;
+    double hover_x; // Widget coordinates, valid while hovering
+    bool hovering;
+    bool dirty; // Series changed since the points were last computed
+
+    // Background, grid, axis labels, filled series and live value label only
+    // change with the data or the allocation; hover reuses this node and
+    // appends the crosshair on top.
+    GskRenderNode *static_node;
+    int cached_width;
+    int cached_height;
+    size_t cached_samples;
+    int cached_scale;
+    ChartGeometry cached_geo;
+    std::vector<ChartPoint> *cached_points; // Decimated series the node was built from
+    std::vector<ChartPoint> *points;        // Scratch for the current frame
+    std::vector<std::vector<ChartPoint>> *cached_line_points; // Same for live_lines
+    std::vector<std::vector<ChartPoint>> *line_points;
+};
+
+G_DEFINE_TYPE(AqiChart, aqi_chart, GTK_TYPE_WIDGET)
+
+template <typename Series>
+static void chart_snapshot_hover_overlay(AqiChart *self, GtkSnapshot *snapshot, const Series &history,
+                                         const ChartGeometry &geo, int width)
+{
+    PangoContext *pango = gtk_widget_get_pango_context(GTK_WIDGET(self));
+    double mouse_x = self->hover_x;
+
+    // Samples are evenly spaced, so the nearest one is a division away
+    long index = lround((mouse_x - geo.margin_x) / geo.step_x);
+    if (index < 0 || (size_t)index >= history.size())
+        return;
+    if (fabs(geo.margin_x + index * geo.step_x - mouse_x) >= geo.step_x / 1.5)
+        return;
+
+    double x = geo.margin_x + index * geo.step_x;
+    double y = chart_value_y(geo, history[index]);
+
+    // Dashed crosshair as 4px segments
+    const GdkRGBA crosshair = {0.5f, 0.5f, 0.5f, 0.8f};
+    for (double dash_y = geo.margin_y; dash_y < geo.margin_y + geo.graph_h; dash_y += 8.0)
+    {
+        double dash_h = MIN(4.0, geo.margin_y + geo.graph_h - dash_y);
+        graphene_rect_t dash = GRAPHENE_RECT_INIT((float)(x - 0.5), (float)dash_y, 1.0f, (float)dash_h);
+        gtk_snapshot_append_color(snapshot, &crosshair, &dash);
+    }
+
+    // Point marker: white disc with a 2px series-coloured ring
+    GskRoundedRect marker;
+    graphene_rect_t marker_bounds = GRAPHENE_RECT_INIT((float)(x - 6), (float)(y - 6), 12.0f, 12.0f);
+    gsk_rounded_rect_init_from_rect(&marker, &marker_bounds, 6.0f);
+    const GdkRGBA white = {1.0f, 1.0f, 1.0f, 1.0f};
+    gtk_snapshot_push_rounded_clip(snapshot, &marker);
+    gtk_snapshot_append_color(snapshot, &white, &marker.bounds);
+    gtk_snapshot_pop(snapshot);
+    const float ring_widths[4] = {2.0f, 2.0f, 2.0f, 2.0f};
+    const GdkRGBA ring_colors[4] = {chart_series_color, chart_series_color, chart_series_color, chart_series_color};
+    gtk_snapshot_append_border(snapshot, &marker, ring_widths, ring_colors);
+
+    char tooltip[32];
+    chart_format_value(self->unit, (double)history[index], tooltip, sizeof(tooltip));
+
+    PangoRectangle ink;
+    chart_text_extents(pango, tooltip, "Sans 10px", &ink);
+
+    double box_w = ink.width + 10;
+    double box_h = ink.height + 10;
+    double box_x = x + 10;
+    double box_y = y - 10 - box_h;
+
+    if (box_x + box_w > width - 20)
+        box_x = x - 10 - box_w;
+    if (box_y < geo.margin_y)
+        box_y = y + 10;
+
+    const GdkRGBA box_color = {0.2f, 0.2f, 0.2f, 0.9f};
+    graphene_rect_t box = GRAPHENE_RECT_INIT((float)box_x, (float)box_y, (float)box_w, (float)box_h);
+    gtk_snapshot_append_color(snapshot, &box_color, &box);
+    chart_append_text(snapshot, pango, tooltip, "Sans 10px", &white, box_x + 5, box_y + box_h - 5);
+}
+
+static bool chart_cache_matches(const std::vector<ChartPoint> &cached, const std::vector<ChartPoint> &points)
+{
+    if (cached.size() != points.size())
+        return false;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        if (cached[i].index != points[i].index || cached[i].value != points[i].value)
+            return false;
+    }
+    return true;
+}
+
+static bool chart_lines_cache_match(const std::vector<std::vector<ChartPoint>> &cached,
+                                    const std::vector<std::vector<ChartPoint>> &lines)
+{
+    if (cached.size() != lines.size())
+        return false;
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        if (!chart_cache_matches(cached[i], lines[i]))
+            return false;
+    }
+    return true;
+}
+
+template <typename Series>
+static void chart_snapshot_series(AqiChart *self, GtkSnapshot *snapshot, const Series &history)
+{
+    GtkWidget *widget = GTK_WIDGET(self);
+    int width = gtk_widget_get_width(widget);
+    int height = gtk_widget_get_height(widget);
+    int scale = gtk_widget_get_scale_factor(widget);
+    if (history.empty() || width <= 0 || height <= 0)
+        return;
+
+    bool resized = !self->static_node || self->cached_width != width || self->cached_height != height ||
+                   self->cached_scale != scale || self->cached_samples != history.size();
+
+    // Hover-only frames skip the series entirely and reuse the cached node
+    if (self->dirty || resized)
+    {
+        ChartGeometry geo = chart_layout(history, width, height, scale, *self->points);
+        if (self->live_lines)
+            chart_layout_lines(*self->live_lines, history.size(), width, scale, geo, *self->line_points);
+
+        // Rebuild the static layers only when the plotted points or the
+        // allocation changed; the comparison is bounded by the plot width.
+        if (resized || !chart_cache_matches(*self->cached_points, *self->points) ||
+            !chart_lines_cache_match(*self->cached_line_points, *self->line_points))
+        {
+            char value_label[64];
+            if (self->live_series)
+                chart_format_value(self->unit, history.back(), value_label, sizeof(value_label));
+            g_clear_pointer(&self->static_node, gsk_render_node_unref);
+            self->static_node =
+                chart_build_static_node(gtk_widget_get_pango_context(widget), *self->points, self->line_points, geo,
+                                        width, height, self->live_series ? value_label : NULL);
+
+            self->cached_width = width;
+            self->cached_height = height;
+            self->cached_scale = scale;
+            self->cached_samples = history.size();
+            self->cached_geo = geo;
+            std::swap(self->cached_points, self->points);
+            std::swap(self->cached_line_points, self->line_points);
+        }
+        self->dirty = false;
+    }
+
+    if (self->static_node)
+        gtk_snapshot_append_node(snapshot, self->static_node);
+
+    if (self->hovering)
+        chart_snapshot_hover_overlay(self, snapshot, history, self->cached_geo, width);
+}
+
+// Charts borrow their series: live charts read a window of the ring buffer
+// and the dashboard chart current_aqi_data, without copying.
+static void aqi_chart_snapshot(GtkWidget *widget, GtkSnapshot *snapshot)
+{
+    TRACE_SPAN("aqi_chart_snapshot");
+    AqiChart *self = AQI_CHART(widget);
+
+    if (self->live_series)
+        chart_snapshot_series(self, snapshot, SeriesWindow<RingSeries<float>>(self->live_series->raw, LIVE_CHART_WINDOW));
+    else
+        chart_snapshot_series(self, snapshot, current_aqi_data.history);
+}
+
+// Call whenever the chart's series changed; hover and resizes need not
+static void aqi_chart_invalidate(AqiChart *self)
+{
+    self->dirty = true;
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+static void aqi_chart_set_live_series(AqiChart *self, const MetricSeries<float> *series, ChartUnit unit)
+{
+    self->live_series = series;
+    self->unit = unit;
+    aqi_chart_invalidate(self);
+}
+
+// Lines drawn under the live series, such as the per-core load under the
+// total; they share its scale and end with its newest sample
+static void aqi_chart_set_live_lines(AqiChart *self, const std::vector<RingSeries<float>> *lines)
+{
+    self->live_lines = lines;
+    aqi_chart_invalidate(self);
+}
+
+static void on_chart_motion(GtkEventControllerMotion *controller, double x, double y, gpointer user_data)
+{
+    AqiChart *self = AQI_CHART(user_data);
+    self->hover_x = x;
+    self->hovering = true;
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+static void on_chart_leave(GtkEventControllerMotion *controller, gpointer user_data)
+{
+    AqiChart *self = AQI_CHART(user_data);
+    self->hovering = false;
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+static void aqi_chart_finalize(GObject *object)
+{
+    AqiChart *self = AQI_CHART(object);
+    g_clear_pointer(&self->static_node, gsk_render_node_unref);
+    delete self->cached_points;
+    delete self->points;
+    delete self->cached_line_points;
+    delete self->line_points;
+    G_OBJECT_CLASS(aqi_chart_parent_class)->finalize(object);
+}
+
+static void aqi_chart_class_init(AqiChartClass *klass)
+{
+    G_OBJECT_CLASS(klass)->finalize = aqi_chart_finalize;
+    GTK_WIDGET_CLASS(klass)->snapshot = aqi_chart_snapshot;
+    gtk_widget_class_set_css_name(GTK_WIDGET_CLASS(klass), "aqichart");
+}
+
+static void aqi_chart_init(AqiChart *self)
+{
+    self->live_series = NULL;
+    self->live_lines = NULL;
+    self->unit = CHART_UNIT_AQI;
+    self->hover_x = 0.0;
+    self->hovering = false;
+    self->dirty = true;
+
+    self->static_node = NULL;
+    self->cached_width = 0;
+    self->cached_height = 0;
+    self->cached_samples = 0;
+    self->cached_scale = 0;
+    self->cached_geo = ChartGeometry();
+    self->cached_points = new std::vector<ChartPoint>();
+    self->points = new std::vector<ChartPoint>();
+    self->cached_line_points = new std::vector<std::vector<ChartPoint>>();
+    self->line_points = new std::vector<std::vector<ChartPoint>>();
+
+    GtkEventController *motion = gtk_event_controller_motion_new();
+    g_signal_connect(motion, "motion", G_CALLBACK(on_chart_motion), self);
+    g_signal_connect(motion, "leave", G_CALLBACK(on_chart_leave), self);
+    gtk_widget_add_controller(GTK_WIDGET(self), motion);
+}
+
+// --- Callbacks ---
+
+#ifndef __ANDROID__
+static gboolean do_search_callback(gpointer user_data)
+{
+    GtkBuilder *builder = GTK_BUILDER(user_data);
+    search_timeout_id = 0;
+
+    GObject *entry_obj = gtk_builder_get_object(builder, "city_entry");
+    if (!entry_obj)
+        return FALSE;
+
+    const char *query = gtk_editable_get_text(GTK_EDITABLE(entry_obj));
+    if (query && strlen(query) >= 2)
+    {
+        waqi_search_cities_async(query, builder, SEARCH_MODE_DROPDOWN);
+    }
+    else
+    {
+        waqi_search_cities_async(query, builder, SEARCH_MODE_DROPDOWN);
+    }
+
+    return FALSE;
+}
+
+static void on_city_entry_changed(GtkEditable *editable, gpointer user_data)
+{
+    GtkBuilder *builder = GTK_BUILDER(user_data);
+
+    if (search_timeout_id > 0)
     {
-        GtkWidget *status_widget = GTK_WIDGET(lbl_status);
-        gtk_widget_remove_css_class(status_widget, "aqi-good");
-        gtk_widget_remove_css_class(status_widget, "aqi-ok");
-        gtk_widget_remove_css_class(status_widget, "aqi-bad");
+        g_source_remove(search_timeout_id);
+        search_timeout_id = 0;
+    }
+
+    // Cached queries (e.g. backspacing to an earlier prefix) skip the debounce
+    if (waqi_search_is_cached(gtk_editable_get_text(editable)))
+    {
+        waqi_search_cities_async(gtk_editable_get_text(editable), builder, SEARCH_MODE_DROPDOWN);
+        return;
+    }
+
+    search_timeout_id = g_timeout_add(300, do_search_callback, builder);
+}
+
+// --- Search Result List Model ---
+// The dropdown is a GtkListView over a GListStore of AqiSearchItem, so only
+// the visible rows are realized and row widgets are recycled on scroll.
+
+#define AQI_TYPE_SEARCH_ITEM (aqi_search_item_get_type())
+G_DECLARE_FINAL_TYPE(AqiSearchItem, aqi_search_item, AQI, SEARCH_ITEM, GObject)
+
+struct _AqiSearchItem
+{
+    GObject parent_instance;
+    WAQISearchBatch *batch; // Keeps the result's strings alive
+    const WAQISearchResult *result;
+};
+
+G_DEFINE_TYPE(AqiSearchItem, aqi_search_item, G_TYPE_OBJECT)
+
+static GListStore *search_results_store = NULL;
+
+static void aqi_search_item_finalize(GObject *object)
+{
+    waqi_search_batch_unref(AQI_SEARCH_ITEM(object)->batch);
+    G_OBJECT_CLASS(aqi_search_item_parent_class)->finalize(object);
+}
+
+static void aqi_search_item_class_init(AqiSearchItemClass *klass)
+{
+    G_OBJECT_CLASS(klass)->finalize = aqi_search_item_finalize;
+}
+
+static void aqi_search_item_init(AqiSearchItem *self)
+{
+    self->batch = NULL;
+    self->result = NULL;
+}
+
+static AqiSearchItem *aqi_search_item_new(WAQISearchBatch *batch, size_t index)
+{
+    AqiSearchItem *item = AQI_SEARCH_ITEM(g_object_new(AQI_TYPE_SEARCH_ITEM, NULL));
+    item->batch = waqi_search_batch_ref(batch);
+    item->result = &batch->results[index];
+    return item;
+}
+
+// True when two results render identically, so the existing item can stay
+static bool search_result_same_row(const WAQISearchResult &a, const WAQISearchResult &b)
+{
+    return strcmp(a.station_id, b.station_id) == 0 && strcmp(a.station_name, b.station_name) == 0 &&
+           strcmp(a.country, b.country) == 0 && strcmp(a.source, b.source) == 0 && a.has_aqi == b.has_aqi &&
+           (!a.has_aqi || a.aqi == b.aqi);
+}
+
+static void on_search_row_setup(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data)
+{
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+    gtk_widget_set_margin_start(box, 10);
+    gtk_widget_set_margin_end(box, 10);
+    gtk_widget_set_margin_top(box, 8);
+    gtk_widget_set_margin_bottom(box, 8);
+
+    GtkWidget *info_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+    gtk_widget_set_hexpand(info_box, TRUE);
+
+    GtkWidget *name_label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(name_label), 0);
+    gtk_widget_add_css_class(name_label, "heading");
+
+    GtkWidget *subtitle_label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(subtitle_label), 0);
+    gtk_widget_add_css_class(subtitle_label, "dim-label");
+    gtk_widget_add_css_class(subtitle_label, "caption");
+
+    gtk_box_append(GTK_BOX(info_box), name_label);
+    gtk_box_append(GTK_BOX(info_box), subtitle_label);
+
+    GtkWidget *aqi_label = gtk_label_new(NULL);
+    gtk_widget_set_valign(aqi_label, GTK_ALIGN_CENTER);
+    gtk_widget_add_css_class(aqi_label, "title-2");
+
+    gtk_box_append(GTK_BOX(box), info_box);
+    gtk_box_append(GTK_BOX(box), aqi_label);
+
+    g_object_set_data(G_OBJECT(box), "name_label", name_label);
+    g_object_set_data(G_OBJECT(box), "subtitle_label", subtitle_label);
+    g_object_set_data(G_OBJECT(box), "aqi_label", aqi_label);
+
+    gtk_list_item_set_child(list_item, box);
+}
+
+static void on_search_row_bind(GtkSignalListItemFactory *factory, GtkListItem *list_item, gpointer user_data)
+{
+    GtkWidget *box = gtk_list_item_get_child(list_item);
+    AqiSearchItem *item = AQI_SEARCH_ITEM(gtk_list_item_get_item(list_item));
+    if (!box || !item || !item->result)
+        return;
+    const WAQISearchResult &result = *item->result;
+
+    GtkLabel *name_label = GTK_LABEL(g_object_get_data(G_OBJECT(box), "name_label"));
+    GtkLabel *subtitle_label = GTK_LABEL(g_object_get_data(G_OBJECT(box), "subtitle_label"));
+    GtkWidget *aqi_label = GTK_WIDGET(g_object_get_data(G_OBJECT(box), "aqi_label"));
+
+    gtk_label_set_text(name_label, result.station_name);
+
+    char subtitle[256];
+    snprintf(subtitle, sizeof(subtitle), "%s • %s", result.country, result.source);
+    gtk_label_set_text(subtitle_label, subtitle);
+
+    char aqi_str[16];
+    if (result.has_aqi)
+    {
+        snprintf(aqi_str, sizeof(aqi_str), "%d", result.aqi);
+    }
+    else
+    {
+        snprintf(aqi_str, sizeof(aqi_str), "--");
+    }
+    gtk_label_set_text(GTK_LABEL(aqi_label), aqi_str);
+
+    // Recycled rows may carry the previous item's colour
+    gtk_widget_remove_css_class(aqi_label, "aqi-good");
+    gtk_widget_remove_css_class(aqi_label, "aqi-ok");
+    gtk_widget_remove_css_class(aqi_label, "aqi-bad");
+    if (result.has_aqi)
+    {
+        if (result.aqi <= 50)
+            gtk_widget_add_css_class(aqi_label, "aqi-good");
+        else if (result.aqi <= 100)
+            gtk_widget_add_css_class(aqi_label, "aqi-ok");
+        else
+            gtk_widget_add_css_class(aqi_label, "aqi-bad");
+    }
+}
+
+// The row's own item is used, not its position in search_results, which a
+// newer search may have replaced before the store caught up
+static void on_search_result_activated(GtkListView *list_view, guint position, gpointer user_data)
+{
+    GtkBuilder *builder = GTK_BUILDER(user_data);
+    GListModel *model = G_LIST_MODEL(gtk_list_view_get_model(list_view));
+    AqiSearchItem *item = AQI_SEARCH_ITEM(g_list_model_get_item(model, position));
+    if (!item)
+        return;
+
+    // The reference keeps the item's batch, and so the result, alive
+    select_search_result(builder, *item->result);
+    g_object_unref(item);
+}
+
+static void setup_search_results_list(GtkBuilder *builder)
+{
+    GObject *list_obj = gtk_builder_get_object(builder, "search_results_list");
+    if (!list_obj)
+        return;
+
+    search_results_store = g_list_store_new(AQI_TYPE_SEARCH_ITEM);
+
+    GtkListItemFactory *factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(factory, "setup", G_CALLBACK(on_search_row_setup), NULL);
+    g_signal_connect(factory, "bind", G_CALLBACK(on_search_row_bind), NULL);
+
+    // Positions in the store mirror indices into search_results once
+    // populate_search_dropdown has run
+    GtkNoSelection *selection = gtk_no_selection_new(G_LIST_MODEL(g_object_ref(search_results_store)));
+    gtk_list_view_set_model(GTK_LIST_VIEW(list_obj), GTK_SELECTION_MODEL(selection));
+    gtk_list_view_set_factory(GTK_LIST_VIEW(list_obj), factory);
+    g_object_unref(selection);
+    g_object_unref(factory);
+
+    g_signal_connect(list_obj, "activate", G_CALLBACK(on_search_result_activated), builder);
+}
+
+static void populate_search_dropdown(GtkBuilder *builder)
+{
+    TRACE_SPAN("populate_search_dropdown");
+    GObject *dropdown_obj = gtk_builder_get_object(builder, "search_dropdown");
+
+    if (!dropdown_obj || !search_results_store)
+    {
+        g_print("Search dropdown UI elements not found!\n");
+        return;
+    }
+
+    // Keep the common prefix and suffix and splice only the changed middle,
+    // so a refined query emits a single narrow items-changed
+    GListModel *model = G_LIST_MODEL(search_results_store);
+    guint old_n = g_list_model_get_n_items(model);
+    guint new_n = search_results ? (guint)search_results->results.size() : 0;
+
+    guint prefix = 0;
+    while (prefix < old_n && prefix < new_n)
+    {
+        AqiSearchItem *item = AQI_SEARCH_ITEM(g_list_model_get_item(model, prefix));
+        bool same = search_result_same_row(*item->result, search_results->results[prefix]);
+        g_object_unref(item);
+        if (!same)
+            break;
+        prefix++;
+    }
+
+    guint suffix = 0;
+    while (suffix < old_n - prefix && suffix < new_n - prefix)
+    {
+        AqiSearchItem *item = AQI_SEARCH_ITEM(g_list_model_get_item(model, old_n - 1 - suffix));
+        bool same = search_result_same_row(*item->result, search_results->results[new_n - 1 - suffix]);
+        g_object_unref(item);
+        if (!same)
+            break;
+        suffix++;
+    }
+
+    guint n_removals = old_n - prefix - suffix;
+    guint n_additions = new_n - prefix - suffix;
+    if (n_removals > 0 || n_additions > 0)
+    {
+        std::vector<gpointer> additions;
+        additions.reserve(n_additions);
+        for (guint i = 0; i < n_additions; i++)
+        {
+            additions.push_back(aqi_search_item_new(search_results, prefix + i));
+        }
+
+        g_list_store_splice(search_results_store, prefix, n_removals, additions.data(), n_additions);
+
+        for (gpointer item : additions)
+        {
+            g_object_unref(item);
+        }
+    }
+
+    gtk_widget_set_visible(GTK_WIDGET(dropdown_obj), new_n > 0);
+}
+#endif
+
+// --- LibSoup Network Test Logic (Added) ---
+// The single test request streams the body through a fixed-size buffer
+// instead of reading it whole: only a bounded head and tail are kept for the
+// preview, the rest is counted and optionally hashed, so memory stays flat
+// however large the response is.
+
+#define NETWORK_TEST_CHUNK_SIZE (64 * 1024)
+#define NETWORK_TEST_PREVIEW_BYTES 1024
+
+// Widgets of the Network Test page, resolved when the page is built
+typedef struct
+{
+    GtkWidget *url_entry;
+    GtkWidget *log_view;
+    GtkWidget *test_button;
+    GtkWidget *hash_check;
+    GtkWidget *concurrency_spin;
+    GtkWidget *requests_spin;
+    GtkWidget *duration_spin;
+    GtkWidget *load_button;
+} NetworkTestPage;
+
+static NetworkTestPage network_test_page = {};
+
+typedef struct
+{
+    SoupMessage *msg;
+    GInputStream *stream;
+    GCancellable *cancellable;
+    guint8 *chunk; // NETWORK_TEST_CHUNK_SIZE read buffer
+
+    std::string head;  // First NETWORK_TEST_PREVIEW_BYTES of the body
+    std::string tail;  // Ring of the last NETWORK_TEST_PREVIEW_BYTES
+    size_t tail_pos;   // Next write position once tail is full
+    guint64 total;     // Body bytes received
+    GChecksum *digest; // NULL unless hashing was requested
+    gint64 start_time;
+    gint64 last_update;
+    char *error;
+    bool done;
+} NetworkTestStream;
+
+static NetworkTestStream *network_test_stream = NULL; // At most one at a time
+
+static void network_test_stream_free(NetworkTestStream *s)
+{
+    g_clear_object(&s->msg);
+    g_clear_object(&s->stream);
+    g_clear_object(&s->cancellable);
+    g_free(s->chunk);
+    if (s->digest)
+        g_checksum_free(s->digest);
+    g_free(s->error);
+    delete s;
+}
+
+static void network_test_stream_consume(NetworkTestStream *s, const guint8 *data, size_t len)
+{
+    s->total += len;
+    if (s->digest)
+        g_checksum_update(s->digest, data, len);
+
+    if (s->head.size() < NETWORK_TEST_PREVIEW_BYTES)
+    {
+        size_t n = MIN(len, NETWORK_TEST_PREVIEW_BYTES - s->head.size());
+        s->head.append((const char *)data, n);
+        data += n;
+        len -= n;
+    }
+
+    // Only bytes past the head go to the tail, so the two never overlap
+    if (len >= NETWORK_TEST_PREVIEW_BYTES)
+    {
+        s->tail.assign((const char *)data + len - NETWORK_TEST_PREVIEW_BYTES, NETWORK_TEST_PREVIEW_BYTES);
+        s->tail_pos = 0;
+        return;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        if (s->tail.size() < NETWORK_TEST_PREVIEW_BYTES)
+        {
+            s->tail.push_back((char)data[i]);
+        }
+        else
+        {
+            s->tail[s->tail_pos] = (char)data[i];
+            s->tail_pos = (s->tail_pos + 1) % NETWORK_TEST_PREVIEW_BYTES;
+        }
+    }
+}
+
+// Appends bytes as text, trimming characters cut by the preview boundary.
+// Returns false for data that is not UTF-8 past the boundaries.
+static bool network_test_append_preview(std::string &out, const std::string &bytes, bool cut_start, bool cut_end)
+{
+    const char *begin = bytes.data();
+    const char *limit = begin + bytes.size();
+    if (cut_start)
+    {
+        // Skip continuation bytes of a character that began before the tail
+        int skipped = 0;
+        while (begin < limit && ((guchar)*begin & 0xC0) == 0x80 && skipped < 3)
+        {
+            begin++;
+            skipped++;
+        }
+    }
+
+    const char *valid_end = NULL;
+    if (!g_utf8_validate(begin, limit - begin, &valid_end))
+    {
+        // A character cut by the end of the head is fine, anything else is not text
+        if (!cut_end || limit - valid_end > 3)
+            return false;
+    }
+    out.append(begin, valid_end - begin);
+    return true;
+}
+
+static void network_test_show(NetworkTestStream *s)
+{
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(network_test_page.log_view));
+    std::string log_text;
+    char line[256];
+
+    if (s->error)
+    {
+        log_text = "ERROR: ";
+        log_text += s->error;
+        log_text += "\n";
+    }
+    else if (s->done)
+    {
+        log_text = "STATUS: Success\n";
+    }
+    else
+    {
+        log_text = "STATUS: Receiving...\n";
+    }
+
+    if (s->stream)
+    {
+        snprintf(line, sizeof(line), "HTTP Status: %u\n", soup_message_get_status(s->msg));
+        log_text += line;
+    }
+
+    double elapsed_s = MAX(g_get_monotonic_time() - s->start_time, 1) / (double)G_USEC_PER_SEC;
+    snprintf(line, sizeof(line), "Received: %" G_GUINT64_FORMAT " bytes in %.2f s (%.1f KiB/s)\n", s->total,
+             elapsed_s, s->total / 1024.0 / elapsed_s);
+    log_text += line;
+
+    if (s->done && s->digest)
+    {
+        log_text += "SHA-256: ";
+        log_text += g_checksum_get_string(s->digest);
+        log_text += "\n";
+    }
+
+    if (s->total == 0)
+    {
+        if (s->done)
+            log_text += "\n(Empty Response Body)";
+    }
+    else
+    {
+        // Unroll the tail ring into arrival order
+        std::string tail = s->tail.substr(s->tail_pos) + s->tail.substr(0, s->tail_pos);
+        guint64 skipped = s->total - s->head.size() - tail.size();
+
+        std::string preview;
+        bool text = network_test_append_preview(preview, s->head, false, !tail.empty());
+        if (text && !tail.empty())
+        {
+            if (skipped > 0)
+            {
+                snprintf(line, sizeof(line), "\n...[%" G_GUINT64_FORMAT " bytes not shown]...\n", skipped);
+                preview += line;
+            }
+            text = network_test_append_preview(preview, tail, skipped > 0 || !s->head.empty(), false);
+        }
+
+        if (text)
+        {
+            log_text += "\n--- RESPONSE BODY ---\n";
+            log_text += preview;
+        }
+        else
+        {
+            log_text += "\n[Binary or Invalid UTF-8 Data Received]";
+        }
+    }
+
+    gtk_text_buffer_set_text(buffer, log_text.c_str(), -1);
+}
+
+static void network_test_finish(NetworkTestStream *s)
+{
+    s->done = true;
+    network_test_show(s);
+    gtk_button_set_label(GTK_BUTTON(network_test_page.test_button), "Test Request");
+    if (network_test_stream == s)
+        network_test_stream = NULL;
+    network_test_stream_free(s);
+}
+
+static void on_network_test_read(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    NetworkTestStream *s = (NetworkTestStream *)user_data;
+    GError *error = NULL;
+    gssize n = g_input_stream_read_finish(G_INPUT_STREAM(source), result, &error);
+
+    if (n < 0)
+    {
+        s->error = g_strdup(error->message);
+        g_error_free(error);
+        network_test_finish(s);
+        return;
+    }
+    if (n == 0)
+    {
+        network_test_finish(s);
+        return;
+    }
+
+    network_test_stream_consume(s, s->chunk, (size_t)n);
+
+    // Throttle redraws of the text view to a few per second
+    gint64 now = g_get_monotonic_time();
+    if (now - s->last_update > 250 * 1000)
+    {
+        s->last_update = now;
+        network_test_show(s);
+    }
+
+    g_input_stream_read_async(s->stream, s->chunk, NETWORK_TEST_CHUNK_SIZE,
+                              http_client_io_priority(HTTP_PRIORITY_BACKGROUND), s->cancellable,
+                              on_network_test_read, s);
+}
+
+static void on_network_test_sent(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    NetworkTestStream *s = (NetworkTestStream *)user_data;
+    GError *error = NULL;
+    GInputStream *stream = soup_session_send_finish(SOUP_SESSION(source), result, &error);
+
+    if (!stream)
+    {
+        s->error = g_strdup(error->message);
+        g_error_free(error);
+        network_test_finish(s);
+        return;
+    }
+
+    s->stream = stream;
+    network_test_show(s);
+    g_input_stream_read_async(s->stream, s->chunk, NETWORK_TEST_CHUNK_SIZE,
+                              http_client_io_priority(HTTP_PRIORITY_BACKGROUND), s->cancellable,
+                              on_network_test_read, s);
+}
+
+static void on_network_test_clicked(GtkButton *button, gpointer user_data)
+{
+    if (network_test_stream)
+    {
+        // Second click cancels; the pending read reports the cancellation
+        g_cancellable_cancel(network_test_stream->cancellable);
+        return;
+    }
+
+    const char *url = gtk_editable_get_text(GTK_EDITABLE(network_test_page.url_entry));
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(network_test_page.log_view));
+
+    if (!url || !*url)
+    {
+        gtk_text_buffer_set_text(buffer, "Error: Please enter a URL.", -1);
+        return;
+    }
+
+    SoupMessage *msg = http_client_message_new("GET", url, HTTP_PRIORITY_BACKGROUND);
+
+    if (!msg)
+    {
+        gtk_text_buffer_set_text(buffer, "Error: Invalid URL format.", -1);
+        return;
+    }
+
+    gtk_text_buffer_set_text(buffer, "Sending request...\nWaiting for response...", -1);
+
+    NetworkTestStream *s = new NetworkTestStream();
+    s->msg = msg;
+    s->stream = NULL;
+    s->cancellable = g_cancellable_new();
+    s->chunk = (guint8 *)g_malloc(NETWORK_TEST_CHUNK_SIZE);
+    s->tail_pos = 0;
+    s->total = 0;
+    s->digest = gtk_check_button_get_active(GTK_CHECK_BUTTON(network_test_page.hash_check))
+                    ? g_checksum_new(G_CHECKSUM_SHA256)
+                    : NULL;
+    s->start_time = g_get_monotonic_time();
+    s->last_update = s->start_time;
+    s->error = NULL;
+    s->done = false;
+
+    network_test_stream = s;
+    gtk_button_set_label(button, "Cancel");
+
+    soup_session_send_async(
+        http_client_session(),
+        msg,
+        http_client_io_priority(HTTP_PRIORITY_BACKGROUND),
+        s->cancellable,
+        on_network_test_sent,
+        s);
+}
+
+// --- Network Load Test ---
+// Fires requests at one URL through the shared HTTP client with a fixed
+// number in flight, until the request count or the duration runs out, and
+// reports throughput plus latency percentiles. Per phase timings come from
+// libsoup's message metrics; DNS, TCP and TLS only show up for requests that
+// opened a new connection.
+
+// Log-linear latency histogram in the style of HdrHistogram. Values below
+// 2^LATENCY_SUB_BUCKET_BITS are exact; above that each power of two is split
+// into 2^(LATENCY_SUB_BUCKET_BITS - 1) linear buckets, so any microsecond
+// value is reported within ~1.6% of itself.
+#define LATENCY_SUB_BUCKET_BITS 7
+#define LATENCY_HALF_BUCKET (1 << (LATENCY_SUB_BUCKET_BITS - 1))
+
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() : counts_(bucket_index(INT64_MAX) + 1, 0) {}
+
+    void record(gint64 us)
+    {
+        if (us < 0)
+            us = 0;
+        counts_[bucket_index(us)]++;
+        if (count_ == 0 || us < min_)
+            min_ = us;
+        if (us > max_)
+            max_ = us;
+        count_++;
+    }
+
+    guint64 count() const { return count_; }
+    gint64 max() const { return max_; }
+
+    // Highest value equivalent to the q-th quantile (0..1), clamped to max
+    gint64 percentile(double q) const
+    {
+        if (count_ == 0)
+            return 0;
+        guint64 rank = (guint64)ceil(q * count_);
+        if (rank < 1)
+            rank = 1;
+        guint64 seen = 0;
+        for (size_t i = 0; i < counts_.size(); i++)
+        {
+            seen += counts_[i];
+            if (seen >= rank)
+                return std::min(bucket_highest(i), max_);
+        }
+        return max_;
+    }
+
+private:
+    static size_t bucket_index(gint64 us)
+    {
+        if (us < 2 * LATENCY_HALF_BUCKET)
+            return (size_t)us;
+        int msb = 63 - __builtin_clzll((unsigned long long)us);
+        int shift = msb - LATENCY_SUB_BUCKET_BITS + 1;
+        return (size_t)shift * LATENCY_HALF_BUCKET + (size_t)(us >> shift);
+    }
+
+    static gint64 bucket_highest(size_t index)
+    {
+        if (index < 2 * LATENCY_HALF_BUCKET)
+            return (gint64)index;
+        int shift = (int)(index / LATENCY_HALF_BUCKET) - 1;
+        gint64 sub = (gint64)(index - (size_t)shift * LATENCY_HALF_BUCKET);
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::vector<guint64> counts_;
+    guint64 count_ = 0;
+    gint64 min_ = 0;
+    gint64 max_ = 0;
+};
+
+typedef enum
+{
+    LOAD_PHASE_TOTAL,
+    LOAD_PHASE_DNS,
+    LOAD_PHASE_TCP,
+    LOAD_PHASE_TLS,
+    LOAD_PHASE_TTFB,
+    LOAD_PHASE_TRANSFER,
+    LOAD_PHASE_COUNT
+} LoadTestPhase;
+
+static const char *load_phase_names[LOAD_PHASE_COUNT] = {
+    "total", "dns", "tcp connect", "tls handshake", "ttfb", "transfer"};
+
+typedef struct
+{
+    std::string url;
+    int concurrency;
+    int request_limit; // 0: until the deadline
+    gint64 deadline;   // Monotonic us, 0: until the request limit
+    gint64 start_time;
+    gint64 end_time;
+
+    int started;
+    int in_flight;
+    int completed;
+    int failed;
+    int new_connections;
+    guint64 bytes;
+    bool stopping;
+    std::map<guint, int> status_counts;
+    std::string last_error;
+    LatencyHistogram phases[LOAD_PHASE_COUNT];
+
+    GCancellable *cancellable;
+    guint progress_id;
+} LoadTestRun;
+
+static LoadTestRun *load_test_run = NULL; // At most one run at a time
+
+static void load_test_append_row(std::string &out, const char *name, const LatencyHistogram &h)
+{
+    char line[160];
+    if (h.count() == 0)
+    {
+        snprintf(line, sizeof(line), "  %-14s %9s\n", name, "-");
+    }
+    else
+    {
+        snprintf(line, sizeof(line), "  %-14s %9.2f %9.2f %9.2f %9.2f %7" G_GUINT64_FORMAT "\n", name,
+                 h.percentile(0.50) / 1000.0, h.percentile(0.90) / 1000.0, h.percentile(0.99) / 1000.0,
+                 h.max() / 1000.0, h.count());
+    }
+    out += line;
+}
+
+static std::string load_test_report(const LoadTestRun *run)
+{
+    gint64 end = run->end_time ? run->end_time : g_get_monotonic_time();
+    double elapsed_s = MAX(end - run->start_time, 1) / (double)G_USEC_PER_SEC;
+    int done = run->completed + run->failed;
+    std::string out;
+    char line[256];
+
+    snprintf(line, sizeof(line), "%s %s\n\n", run->end_time ? (run->stopping ? "STOPPED:" : "FINISHED:") : "RUNNING:",
+             run->url.c_str());
+    out += line;
+    snprintf(line, sizeof(line), "Requests:    %d ok, %d failed, %d in flight (concurrency %d)\n", run->completed,
+             run->failed, run->in_flight, run->concurrency);
+    out += line;
+    snprintf(line, sizeof(line), "Elapsed:     %.2f s\n", elapsed_s);
+    out += line;
+    snprintf(line, sizeof(line), "Throughput:  %.1f req/s, %.1f KiB/s\n", done / elapsed_s,
+             run->bytes / 1024.0 / elapsed_s);
+    out += line;
+    snprintf(line, sizeof(line), "Connections: %d new, %d reused\n", run->new_connections,
+             run->completed - run->new_connections);
+    out += line;
+
+    if (!run->status_counts.empty())
+    {
+        out += "Status:     ";
+        for (const auto &sc : run->status_counts)
+        {
+            snprintf(line, sizeof(line), " %u x%d", sc.first, sc.second);
+            out += line;
+        }
+        out += "\n";
+    }
+    if (!run->last_error.empty())
+    {
+        out += "Last error:  " + run->last_error + "\n";
+    }
+
+    out += "\nLatency (ms)         p50       p90       p99       max   count\n";
+    for (int p = 0; p < LOAD_PHASE_COUNT; p++)
+        load_test_append_row(out, load_phase_names[p], run->phases[p]);
+
+    // HDR-style percentile spectrum of the total latency
+    const LatencyHistogram &total = run->phases[LOAD_PHASE_TOTAL];
+    if (total.count() > 0)
+    {
+        static const double spectrum[] = {0.0, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.999, 1.0};
+        out += "\nPercentile spectrum (total)\n";
+        gint64 max_us = MAX(total.max(), 1);
+        for (double q : spectrum)
+        {
+            gint64 us = total.percentile(q);
+            int bar = (int)(40.0 * us / max_us);
+            snprintf(line, sizeof(line), "  %7.3f%%  %9.2f ms  %s\n", q * 100.0, us / 1000.0,
+                     std::string(bar, '#').c_str());
+            out += line;
+        }
+    }
+    return out;
+}
+
+static void load_test_show_report(const LoadTestRun *run)
+{
+    if (!network_test_page.log_view)
+        return;
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(network_test_page.log_view));
+    std::string report = load_test_report(run);
+    gtk_text_buffer_set_text(buffer, report.c_str(), -1);
+}
+
+static void load_test_record_metrics(LoadTestRun *run, SoupMessage *msg)
+{
+    SoupMessageMetrics *m = soup_message_get_metrics(msg);
+    if (!m)
+        return;
+
+    guint64 fetch_start = soup_message_metrics_get_fetch_start(m);
+    guint64 dns_start = soup_message_metrics_get_dns_start(m);
+    guint64 dns_end = soup_message_metrics_get_dns_end(m);
+    guint64 connect_start = soup_message_metrics_get_connect_start(m);
+    guint64 connect_end = soup_message_metrics_get_connect_end(m);
+    guint64 tls_start = soup_message_metrics_get_tls_start(m);
+    guint64 request_start = soup_message_metrics_get_request_start(m);
+    guint64 response_start = soup_message_metrics_get_response_start(m);
+    guint64 response_end = soup_message_metrics_get_response_end(m);
+
+    if (fetch_start && response_end)
+        run->phases[LOAD_PHASE_TOTAL].record((gint64)(response_end - fetch_start));
+    if (dns_start && dns_end)
+        run->phases[LOAD_PHASE_DNS].record((gint64)(dns_end - dns_start));
+    if (connect_start && connect_end)
+    {
+        run->new_connections++;
+        guint64 tcp_end = tls_start ? tls_start : connect_end;
+        run->phases[LOAD_PHASE_TCP].record((gint64)(tcp_end - connect_start));
+        if (tls_start)
+            run->phases[LOAD_PHASE_TLS].record((gint64)(connect_end - tls_start));
+    }
+    if (request_start && response_start)
+        run->phases[LOAD_PHASE_TTFB].record((gint64)(response_start - request_start));
+    if (response_start && response_end)
+        run->phases[LOAD_PHASE_TRANSFER].record((gint64)(response_end - response_start));
+}
+
+static void load_test_issue(LoadTestRun *run);
+
+static void load_test_free(LoadTestRun *run)
+{
+    if (run->progress_id)
+        g_source_remove(run->progress_id);
+    g_clear_object(&run->cancellable);
+    delete run;
+}
+
+static void load_test_finish(LoadTestRun *run)
+{
+    run->end_time = g_get_monotonic_time();
+    load_test_show_report(run);
+    if (network_test_page.load_button)
+        gtk_button_set_label(GTK_BUTTON(network_test_page.load_button), "Run Load Test");
+    if (load_test_run == run)
+        load_test_run = NULL;
+    load_test_free(run);
+}
+
+static void on_load_test_request_complete(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    LoadTestRun *run = (LoadTestRun *)user_data;
+    SoupSession *session = SOUP_SESSION(source);
+    SoupMessage *msg = soup_session_get_async_result_message(session, result);
+
+    GError *error = NULL;
+    GBytes *bytes = soup_session_send_and_read_finish(session, result, &error);
+    run->in_flight--;
+
+    if (error)
+    {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            run->failed++;
+            run->last_error = error->message;
+        }
+        g_error_free(error);
+    }
+    else
+    {
+        run->completed++;
+        run->status_counts[soup_message_get_status(msg)]++;
+        if (bytes)
+        {
+            run->bytes += g_bytes_get_size(bytes);
+            g_bytes_unref(bytes);
+        }
+        load_test_record_metrics(run, msg);
+    }
+
+    load_test_issue(run);
+    if (run->in_flight == 0)
+        load_test_finish(run);
+}
+
+// Tops the run back up to its concurrency, unless it is out of requests,
+// out of time or stopping.
+static void load_test_issue(LoadTestRun *run)
+{
+    while (run->in_flight < run->concurrency && !run->stopping)
+    {
+        if (run->request_limit > 0 && run->started >= run->request_limit)
+            return;
+        if (run->deadline > 0 && g_get_monotonic_time() >= run->deadline)
+            return;
+
+        SoupMessage *msg = http_client_message_new("GET", run->url.c_str(), HTTP_PRIORITY_BACKGROUND);
+        if (!msg)
+            return;
+        soup_message_add_flags(msg, SOUP_MESSAGE_COLLECT_METRICS);
+
+        run->started++;
+        run->in_flight++;
+        soup_session_send_and_read_async(
+            http_client_session(),
+            msg,
+            http_client_io_priority(HTTP_PRIORITY_BACKGROUND),
+            run->cancellable,
+            on_load_test_request_complete,
+            run);
+        g_object_unref(msg);
+    }
+}
+
+static gboolean on_load_test_progress(gpointer user_data)
+{
+    load_test_show_report((LoadTestRun *)user_data);
+    return G_SOURCE_CONTINUE;
+}
+
+static void on_load_test_clicked(GtkButton *button, gpointer user_data)
+{
+    if (load_test_run)
+    {
+        // Second click stops the run; it finishes once in-flight requests unwind
+        load_test_run->stopping = true;
+        g_cancellable_cancel(load_test_run->cancellable);
+        return;
+    }
+
+    const char *url = gtk_editable_get_text(GTK_EDITABLE(network_test_page.url_entry));
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(network_test_page.log_view));
+    if (!url || !*url)
+    {
+        gtk_text_buffer_set_text(buffer, "Error: Please enter a URL.", -1);
+        return;
+    }
+    if (!g_uri_is_valid(url, G_URI_FLAGS_NONE, NULL))
+    {
+        gtk_text_buffer_set_text(buffer, "Error: Invalid URL format.", -1);
+        return;
+    }
+
+    LoadTestRun *run = new LoadTestRun();
+    run->url = url;
+    run->concurrency = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(network_test_page.concurrency_spin));
+    run->request_limit = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(network_test_page.requests_spin));
+    int duration_s = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(network_test_page.duration_spin));
+    run->start_time = g_get_monotonic_time();
+    run->deadline = duration_s > 0 ? run->start_time + (gint64)duration_s * G_USEC_PER_SEC : 0;
+    if (run->request_limit == 0 && run->deadline == 0)
+        run->request_limit = 1;
+    run->cancellable = g_cancellable_new();
+
+    load_test_run = run;
+    gtk_button_set_label(button, "Stop");
+    run->progress_id = g_timeout_add(250, on_load_test_progress, run);
+
+    load_test_issue(run);
+    if (run->in_flight == 0)
+        load_test_finish(run);
+}
+
+// --- Dashboard View Model ---
+// Widget handles are resolved once in on_activate. Each label remembers the
+// text it last displayed, so a render only touches labels whose formatted
+// value changed, and update_aqi_display calls within one frame are folded
+// into a single render from a tick callback.
+
+enum AqiViewField
+{
+    AQI_VIEW_CITY,
+    AQI_VIEW_AQI,
+    AQI_VIEW_STATUS,
+    AQI_VIEW_PM25,
+    AQI_VIEW_PM10,
+    AQI_VIEW_O3,
+    AQI_VIEW_NO2,
+    AQI_VIEW_CO,
+    AQI_VIEW_SO2,
+    AQI_VIEW_TEMPERATURE,
+    AQI_VIEW_HUMIDITY,
+    AQI_VIEW_WIND,
+    AQI_VIEW_ADVICE,
+    AQI_VIEW_N_FIELDS
+};
+
+static const char *const aqi_view_label_ids[AQI_VIEW_N_FIELDS] = {
+    "lbl_city_name", "lbl_aqi_value", "lbl_aqi_status", "lbl_pm25", "lbl_pm10",
+    "lbl_o3", "lbl_no2", "lbl_co", "lbl_so2", "lbl_temperature",
+    "lbl_humidity", "lbl_wind", "lbl_health_advice"};
+
+typedef struct
+{
+    bool bound;
+    GtkWidget *window; // Frame clock source for batching
+    GtkWidget *result_box;
+    GtkWidget *pollutant_box;
+    GtkWidget *weather_box;
+    GtkWidget *chart;
+    GtkLabel *labels[AQI_VIEW_N_FIELDS];
+    std::string rendered[AQI_VIEW_N_FIELDS]; // Text last set on each label
+    bool has_rendered[AQI_VIEW_N_FIELDS];
+    const char *status_class; // aqi-* class currently on the status label
+    guint flush_id;           // Pending tick callback, 0 if none
+} AqiViewModel;
+
+static AqiViewModel aqi_view;
+
+static GtkWidget *aqi_view_lookup(GtkBuilder *builder, const char *id)
+{
+    GObject *obj = gtk_builder_get_object(builder, id);
+    return obj ? GTK_WIDGET(obj) : NULL;
+}
+
+static void aqi_view_bind(GtkBuilder *builder)
+{
+    aqi_view.window = aqi_view_lookup(builder, "window");
+    aqi_view.result_box = aqi_view_lookup(builder, "aqi_result_box");
+    aqi_view.pollutant_box = aqi_view_lookup(builder, "pollutant_detail_box");
+    aqi_view.weather_box = aqi_view_lookup(builder, "weather_box");
+    aqi_view.chart = aqi_view_lookup(builder, "chart_area_current");
+
+    for (int i = 0; i < AQI_VIEW_N_FIELDS; i++)
+    {
+        GtkWidget *label = aqi_view_lookup(builder, aqi_view_label_ids[i]);
+        aqi_view.labels[i] = label ? GTK_LABEL(label) : NULL;
+        aqi_view.has_rendered[i] = false;
+    }
+
+    aqi_view.status_class = NULL;
+    aqi_view.flush_id = 0;
+    aqi_view.bound = true;
+}
+
+static void aqi_view_set_text(AqiViewField field, const char *text)
+{
+    GtkLabel *label = aqi_view.labels[field];
+    if (!label || !text)
+        return;
+    if (aqi_view.has_rendered[field] && aqi_view.rendered[field] == text)
+        return;
+
+    gtk_label_set_text(label, text);
+    aqi_view.rendered[field] = text;
+    aqi_view.has_rendered[field] = true;
+}
+
+static void aqi_view_render()
+{
+    TRACE_SPAN("aqi_view_render");
+    if (!aqi_view.result_box)
+        return;
+
+    char buffer[64];
+
+    aqi_view_set_text(AQI_VIEW_CITY, current_aqi_data.city);
+
+    snprintf(buffer, sizeof(buffer), "%d", current_aqi_data.aqi);
+    aqi_view_set_text(AQI_VIEW_AQI, buffer);
+
+    if (current_station_data.stale)
+    {
+        snprintf(buffer, sizeof(buffer), "%s · last known", current_aqi_data.status);
+        aqi_view_set_text(AQI_VIEW_STATUS, buffer);
+    }
+    else
+    {
+        aqi_view_set_text(AQI_VIEW_STATUS, current_aqi_data.status);
+    }
+
+    snprintf(buffer, sizeof(buffer), "PM2.5: %.1f µg/m³", current_aqi_data.pm25);
+    aqi_view_set_text(AQI_VIEW_PM25, buffer);
+
+    snprintf(buffer, sizeof(buffer), "PM10: %.1f µg/m³", current_aqi_data.pm10);
+    aqi_view_set_text(AQI_VIEW_PM10, buffer);
+
+    if (current_station_data.has_data)
+    {
+        snprintf(buffer, sizeof(buffer), "O₃: %.1f ppb", current_station_data.o3);
+        aqi_view_set_text(AQI_VIEW_O3, buffer);
+
+        snprintf(buffer, sizeof(buffer), "NO₂: %.1f ppb", current_station_data.no2);
+        aqi_view_set_text(AQI_VIEW_NO2, buffer);
+
+        snprintf(buffer, sizeof(buffer), "CO: %.1f ppm", current_station_data.co / 1000.0);
+        aqi_view_set_text(AQI_VIEW_CO, buffer);
+
+        snprintf(buffer, sizeof(buffer), "SO₂: %.2f ppb", current_station_data.so2);
+        aqi_view_set_text(AQI_VIEW_SO2, buffer);
+
+        snprintf(buffer, sizeof(buffer), "🌡️ %.1f°C", current_station_data.temperature);
+        aqi_view_set_text(AQI_VIEW_TEMPERATURE, buffer);
+
+        snprintf(buffer, sizeof(buffer), "💧 %.0f%%", current_station_data.humidity);
+        aqi_view_set_text(AQI_VIEW_HUMIDITY, buffer);
+
+        const char *wind_dir = "";
+        int wd = current_station_data.wind_direction;
+        if (wd >= 337 || wd < 22)
+            wind_dir = "N";
+        else if (wd < 67)
+            wind_dir = "NE";
+        else if (wd < 112)
+            wind_dir = "E";
+        else if (wd < 157)
+            wind_dir = "SE";
+        else if (wd < 202)
+            wind_dir = "S";
+        else if (wd < 247)
+            wind_dir = "SW";
+        else if (wd < 292)
+            wind_dir = "W";
+        else
+            wind_dir = "NW";
+        snprintf(buffer, sizeof(buffer), "💨 %.1f m/s %s", current_station_data.wind_speed, wind_dir);
+        aqi_view_set_text(AQI_VIEW_WIND, buffer);
+    }
+
+    const char *advice = "";
+    if (current_aqi_data.aqi <= 50)
+        advice = "Air quality is good. Enjoy outdoor activities!";
+    else if (current_aqi_data.aqi <= 100)
+        advice = "Air quality is acceptable. Sensitive groups should limit prolonged outdoor exertion.";
+    else if (current_aqi_data.aqi <= 150)
+        advice = "Unhealthy for sensitive groups. Reduce prolonged outdoor exertion.";
+    else if (current_aqi_data.aqi <= 200)
+        advice = "Unhealthy. Everyone may experience health effects.";
+    else if (current_aqi_data.aqi <= 300)
+        advice = "Very unhealthy. Avoid outdoor activities.";
+    else
+        advice = "Hazardous! Avoid all outdoor activities.";
+    aqi_view_set_text(AQI_VIEW_ADVICE, advice);
+
+    GtkLabel *lbl_status = aqi_view.labels[AQI_VIEW_STATUS];
+    if (lbl_status)
+    {
+        const char *status_class;
+        if (current_aqi_data.aqi <= 50)
+            status_class = "aqi-good";
+        else if (current_aqi_data.aqi <= 100)
+            status_class = "aqi-ok";
+        else
+            status_class = "aqi-bad";
+
+        if (status_class != aqi_view.status_class)
+        {
+            if (aqi_view.status_class)
+                gtk_widget_remove_css_class(GTK_WIDGET(lbl_status), aqi_view.status_class);
+            gtk_widget_add_css_class(GTK_WIDGET(lbl_status), status_class);
+            aqi_view.status_class = status_class;
+        }
+    }
+
+    gtk_widget_set_visible(aqi_view.result_box, TRUE);
+
+    if (aqi_view.chart)
+        aqi_chart_invalidate(AQI_CHART(aqi_view.chart));
+
+    if (aqi_view.pollutant_box && current_station_data.has_data)
+        gtk_widget_set_visible(aqi_view.pollutant_box, TRUE);
+
+    if (aqi_view.weather_box && current_station_data.has_data)
+        gtk_widget_set_visible(aqi_view.weather_box, TRUE);
+}
+
+static gboolean on_aqi_view_tick(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data)
+{
+    aqi_view.flush_id = 0;
+    aqi_view_render();
+    return G_SOURCE_REMOVE;
+}
+
+static void update_aqi_display(GtkBuilder *builder)
+{
+    if (!aqi_view.bound)
+        aqi_view_bind(builder);
+
+    if (aqi_view.flush_id != 0)
+        return; // Already rendering on the next frame
+
+    // Before the window is realized there is no frame clock to batch on
+    if (!aqi_view.window || !gtk_widget_get_realized(aqi_view.window))
+    {
+        aqi_view_render();
+        return;
+    }
+
+    aqi_view.flush_id = gtk_widget_add_tick_callback(aqi_view.window, on_aqi_view_tick, NULL, NULL);
+}
+
+static void on_fetch_aqi_clicked(GtkButton *button, gpointer user_data)
+{
+    GtkBuilder *builder = GTK_BUILDER(user_data);
+
+    GObject *entry_obj = gtk_builder_get_object(builder, "city_entry");
+    if (!entry_obj)
+        return;
+
+    const char *city = gtk_editable_get_text(GTK_EDITABLE(entry_obj));
+    if (!city || !*city)
+    {
+        city = "Delhi";
+    }
+
+#ifndef __ANDROID__
+    g_free(g_api_city_name);
+    g_api_city_name = g_strdup(city);
+    current_aqi_data.city = g_api_city_name;
+    current_aqi_data.aqi = 0;
+    current_aqi_data.pm25 = 0.0;
+    current_aqi_data.pm10 = 0.0;
+    current_aqi_data.status = "Searching...";
+    current_aqi_data.history.clear();
+    for (int i = 0; i < 24; i++)
+        current_aqi_data.history.push_back(0);
+    update_aqi_display(builder);
+
+    // A dropdown search still waiting out the debounce is superseded
+    if (search_timeout_id > 0)
+    {
+        g_source_remove(search_timeout_id);
+        search_timeout_id = 0;
+    }
+    waqi_search_cities_async(city, builder, SEARCH_MODE_AUTO_SELECT_FIRST);
+#else
+    current_aqi_data = get_mock_data(city);
+    update_aqi_display(builder);
+#endif
+}
+
+// --- Media Pipeline ---
+// With "Hardware pipeline" checked, playback runs through a playbin3 we own
+// instead of GtkVideo's built-in one. playbin3 plugs the adaptive demuxers
+// (hlsdemux2/dashdemux2) for HLS and DASH on its own; we raise the hardware
+// decoders above the software ones, and render through gtk4paintablesink,
+// which uploads dmabufs and GL textures without a copy and hands us a
+// GdkPaintable to show in a GtkPicture. The bus and a pair of pad probes on
+// the decoder feed a stats line that separates network stalls (buffer
+// running dry) from decode trouble (late frames with a full buffer).
+// Desktop only: the Android build does not ship GStreamer.
+
+#ifndef __ANDROID__
+#define MEDIA_BUFFER_DURATION_NS (5 * GST_SECOND)
+#define MEDIA_STATS_INTERVAL_MS 1000
+#define MEDIA_LATENCY_MAX_PENDING 64 // Buffers in flight through the decoder
+
+// Hardware decoders, ranked above every software decoder playbin3 could pick
+static const char *const media_hw_decoders[] = {
+    "vah264dec", "vah265dec", "vavp9dec", "vaav1dec",             // VA-API
+    "nvh264dec", "nvh265dec", "nvvp9dec", "nvav1dec",             // NVDEC
+    "d3d11h264dec", "d3d11h265dec", "d3d11vp9dec", "d3d11av1dec", // Direct3D 11
+    "vtdec_hw",                                                   // VideoToolbox
+};
+
+typedef struct
+{
+    GMutex lock;
+    std::map<GstClockTime, gint64> pending; // Buffer pts -> monotonic time it entered the decoder
+    gint64 total_us;
+    guint count;
+} MediaDecodeLatency;
+
+typedef struct
+{
+    GstElement *playbin;
+    GtkWidget *picture;
+    GtkWidget *video; // The GtkVideo used outside pipeline mode
+    GtkLabel *stats_label;
+    guint bus_watch_id;
+    guint stats_id;
+
+    // Main thread only
+    guint generation; // Bumped per pipeline, so results of a stopped one are dropped
+    char *decoder; // Video decoder playbin3 plugged, NULL until known
+    bool decoder_is_hw;
+    int buffer_percent;
+    bool buffering; // Paused to refill
+    guint stalls;
+    gint64 stall_start_us;
+    gint64 stalled_us;
+    guint64 dropped; // Frames the sink dropped for being late
+    guint64 rendered;
+    gint64 jitter_ns;
+    guint64 last_dropped; // Dropped count at the previous stats update
+
+    MediaDecodeLatency latency; // Updated from streaming threads
+} MediaPipeline;
+
+static MediaPipeline media_pipeline;
+
+static void media_rank_hw_decoders()
+{
+    static bool ranked = false;
+    if (ranked)
+        return;
+    ranked = true;
+
+    GstRegistry *registry = gst_registry_get();
+    for (const char *name : media_hw_decoders)
+    {
+        GstPluginFeature *feature = gst_registry_lookup_feature(registry, name);
+        if (!feature)
+            continue;
+        gst_plugin_feature_set_rank(feature, GST_RANK_PRIMARY + 1);
+        gst_object_unref(feature);
+    }
+}
+
+static GstPadProbeReturn on_media_decoder_sink_buffer(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    MediaDecodeLatency *l = (MediaDecodeLatency *)user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!GST_BUFFER_PTS_IS_VALID(buffer))
+        return GST_PAD_PROBE_OK;
+
+    g_mutex_lock(&l->lock);
+    if (l->pending.size() >= MEDIA_LATENCY_MAX_PENDING)
+        l->pending.erase(l->pending.begin());
+    l->pending[GST_BUFFER_PTS(buffer)] = g_get_monotonic_time();
+    g_mutex_unlock(&l->lock);
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn on_media_decoder_src_buffer(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    MediaDecodeLatency *l = (MediaDecodeLatency *)user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!GST_BUFFER_PTS_IS_VALID(buffer))
+        return GST_PAD_PROBE_OK;
+
+    g_mutex_lock(&l->lock);
+    auto it = l->pending.find(GST_BUFFER_PTS(buffer));
+    if (it != l->pending.end())
+    {
+        l->total_us += g_get_monotonic_time() - it->second;
+        l->count++;
+        l->pending.erase(it);
+    }
+    g_mutex_unlock(&l->lock);
+    return GST_PAD_PROBE_OK;
+}
+
+typedef struct
+{
+    guint generation; // Of the pipeline that plugged the decoder
+    bool hw;
+    char *name;
+} MediaDecoderInfo;
+
+static void media_decoder_info_free(gpointer data)
+{
+    MediaDecoderInfo *info = (MediaDecoderInfo *)data;
+    g_free(info->name);
+    g_free(info);
+}
+
+static gboolean on_media_decoder_known(gpointer user_data)
+{
+    MediaDecoderInfo *info = (MediaDecoderInfo *)user_data;
+    if (!media_pipeline.playbin || info->generation != media_pipeline.generation)
+        return G_SOURCE_REMOVE; // Plugged by a pipeline stopped since
+
+    g_free(media_pipeline.decoder);
+    media_pipeline.decoder_is_hw = info->hw;
+    media_pipeline.decoder = g_strdup(info->name);
+    return G_SOURCE_REMOVE;
+}
+
+// Streaming thread: instruments the video decoder once playbin3 plugs it
+static void on_media_element_setup(GstElement *playbin, GstElement *element, gpointer user_data)
+{
+    GstElementFactory *factory = gst_element_get_factory(element);
+    if (!factory)
+        return;
+    const char *klass = gst_element_factory_get_metadata(factory, GST_ELEMENT_METADATA_KLASS);
+    if (!klass || !strstr(klass, "Decoder") || !strstr(klass, "Video"))
+        return;
+
+    GstPad *sink = gst_element_get_static_pad(element, "sink");
+    GstPad *src = gst_element_get_static_pad(element, "src");
+    if (sink)
+    {
+        gst_pad_add_probe(sink, GST_PAD_PROBE_TYPE_BUFFER, on_media_decoder_sink_buffer, &media_pipeline.latency,
+                          NULL);
+        gst_object_unref(sink);
+    }
+    if (src)
+    {
+        gst_pad_add_probe(src, GST_PAD_PROBE_TYPE_BUFFER, on_media_decoder_src_buffer, &media_pipeline.latency, NULL);
+        gst_object_unref(src);
+    }
+
+    MediaDecoderInfo *info = g_new(MediaDecoderInfo, 1);
+    info->generation = GPOINTER_TO_UINT(user_data);
+    info->hw = strstr(klass, "Hardware") != NULL;
+    info->name = g_strdup(GST_OBJECT_NAME(factory));
+    g_idle_add_full(G_PRIORITY_DEFAULT, on_media_decoder_known, info, media_decoder_info_free);
+}
+
+static void media_stats_update()
+{
+    MediaPipeline *m = &media_pipeline;
+
+    g_mutex_lock(&m->latency.lock);
+    double decode_ms = m->latency.count ? m->latency.total_us / (double)m->latency.count / 1000.0 : 0.0;
+    m->latency.total_us = 0;
+    m->latency.count = 0;
+    g_mutex_unlock(&m->latency.lock);
+
+    gint64 stalled_us = m->stalled_us;
+    if (m->buffering)
+        stalled_us += g_get_monotonic_time() - m->stall_start_us;
+
+    // Frames dropped while the buffer was full point at decode or render,
+    // an emptied buffer at the network
+    const char *verdict = "smooth";
+    if (m->buffering || m->buffer_percent < 100)
+        verdict = "network";
+    else if (m->dropped > m->last_dropped)
+        verdict = "decode";
+    m->last_dropped = m->dropped;
+
+    char text[512];
+    snprintf(text, sizeof(text),
+             "Decoder %s%s · buffer %d%% · %u stalls (%.1f s)\n"
+             "%" G_GUINT64_FORMAT " dropped / %" G_GUINT64_FORMAT " rendered · decode %.1f ms · jitter %.1f ms · %s",
+             m->decoder ? m->decoder : "(pending)", m->decoder ? (m->decoder_is_hw ? " (hardware)" : " (software)") : "",
+             m->buffer_percent, m->stalls, stalled_us / 1e6, m->dropped, m->rendered, decode_ms, m->jitter_ns / 1e6,
+             verdict);
+    gtk_label_set_text(m->stats_label, text);
+}
+
+static gboolean on_media_stats_tick(gpointer user_data)
+{
+    media_stats_update();
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean on_media_bus_message(GstBus *bus, GstMessage *msg, gpointer user_data)
+{
+    MediaPipeline *m = &media_pipeline;
+
+    switch (GST_MESSAGE_TYPE(msg))
+    {
+    case GST_MESSAGE_BUFFERING:
+    {
+        // Live streams do not buffer; everything else pauses until refilled
+        gint percent = 0;
+        gst_message_parse_buffering(msg, &percent);
+        m->buffer_percent = percent;
+        if (percent < 100 && !m->buffering)
+        {
+            m->buffering = true;
+            m->stalls++;
+            m->stall_start_us = g_get_monotonic_time();
+            gst_element_set_state(m->playbin, GST_STATE_PAUSED);
+        }
+        else if (percent >= 100 && m->buffering)
+        {
+            m->buffering = false;
+            m->stalled_us += g_get_monotonic_time() - m->stall_start_us;
+            gst_element_set_state(m->playbin, GST_STATE_PLAYING);
+        }
+        break;
+    }
+    case GST_MESSAGE_QOS:
+    {
+        GstFormat format;
+        guint64 processed = 0, dropped = 0;
+        gst_message_parse_qos_stats(msg, &format, &processed, &dropped);
+        if (format == GST_FORMAT_BUFFERS)
+        {
+            m->rendered = processed;
+            m->dropped = dropped;
+        }
+        gint64 jitter = 0;
+        gst_message_parse_qos_values(msg, &jitter, NULL, NULL);
+        m->jitter_ns = jitter;
+        break;
+    }
+    case GST_MESSAGE_EOS:
+        // Loop like GtkVideo does
+        gst_element_seek_simple(m->playbin, GST_FORMAT_TIME,
+                                (GstSeekFlags)(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT), 0);
+        break;
+    case GST_MESSAGE_ERROR:
+    {
+        GError *error = NULL;
+        gst_message_parse_error(msg, &error, NULL);
+        g_printerr("Media pipeline error: %s\n", error->message);
+        gtk_label_set_text(m->stats_label, error->message);
+        g_clear_error(&error);
+        break;
+    }
+    default:
+        break;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void media_pipeline_stop()
+{
+    MediaPipeline *m = &media_pipeline;
+    if (!m->playbin)
+        return;
+
+    gst_element_set_state(m->playbin, GST_STATE_NULL);
+    g_source_remove(m->bus_watch_id);
+    g_source_remove(m->stats_id);
+    m->bus_watch_id = m->stats_id = 0;
+    gst_clear_object(&m->playbin);
+    gtk_picture_set_paintable(GTK_PICTURE(m->picture), NULL);
+    g_clear_pointer(&m->decoder, g_free);
+}
+
+// Builds the sink, wrapped in glsinkbin when the paintable renders through
+// GL so frames stay on the GPU. Returns NULL without gtk4paintablesink.
+static GstElement *media_make_video_sink(GdkPaintable **paintable)
+{
+    GstElement *sink = gst_element_factory_make("gtk4paintablesink", NULL);
+    if (!sink)
+        return NULL;
+
+    g_object_get(sink, "paintable", paintable, NULL);
+    GdkGLContext *gl_context = NULL;
+    g_object_get(*paintable, "gl-context", &gl_context, NULL);
+    if (!gl_context)
+        return sink;
+    g_object_unref(gl_context);
+
+    GstElement *glsink = gst_element_factory_make("glsinkbin", NULL);
+    if (!glsink)
+        return sink;
+    g_object_set(glsink, "sink", sink, NULL);
+    return glsink;
+}
+
+static bool media_pipeline_play(const char *uri)
+{
+    MediaPipeline *m = &media_pipeline;
+    media_pipeline_stop();
+    media_rank_hw_decoders();
+
+    GdkPaintable *paintable = NULL;
+    GstElement *sink = media_make_video_sink(&paintable);
+    GstElement *playbin = NULL;
+    if (sink)
+        playbin = gst_element_factory_make("playbin3", NULL);
+    if (!playbin)
+    {
+        g_printerr("playbin3 or gtk4paintablesink missing, using the default media backend\n");
+        if (sink)
+            gst_object_unref(sink);
+        g_clear_object(&paintable);
+        return false;
+    }
+
+    g_object_set(playbin, "uri", uri, "video-sink", sink, "buffer-duration", (gint64)MEDIA_BUFFER_DURATION_NS, NULL);
+    m->generation++;
+    g_signal_connect(playbin, "element-setup", G_CALLBACK(on_media_element_setup), GUINT_TO_POINTER(m->generation));
+
+    m->playbin = playbin;
+    m->buffer_percent = 100;
+    m->buffering = false;
+    m->stalls = 0;
+    m->stalled_us = 0;
+    m->dropped = m->rendered = m->last_dropped = 0;
+    m->jitter_ns = 0;
+    g_mutex_lock(&m->latency.lock);
+    m->latency.pending.clear();
+    m->latency.total_us = 0;
+    m->latency.count = 0;
+    g_mutex_unlock(&m->latency.lock);
+
+    GstBus *bus = gst_element_get_bus(playbin);
+    m->bus_watch_id = gst_bus_add_watch(bus, on_media_bus_message, NULL);
+    gst_object_unref(bus);
+    m->stats_id = g_timeout_add(MEDIA_STATS_INTERVAL_MS, on_media_stats_tick, NULL);
+
+    gtk_picture_set_paintable(GTK_PICTURE(m->picture), paintable);
+    g_object_unref(paintable);
+    gst_element_set_state(playbin, GST_STATE_PLAYING);
+    return true;
+}
+
+static void media_show_pipeline(bool pipeline)
+{
+    gtk_widget_set_visible(media_pipeline.picture, pipeline);
+    gtk_widget_set_visible(GTK_WIDGET(media_pipeline.stats_label), pipeline);
+    gtk_widget_set_visible(media_pipeline.video, !pipeline);
+}
+#endif
+
+static void on_play_clicked(GtkButton *button, gpointer user_data)
+{
+    GtkBuilder *builder = GTK_BUILDER(user_data);
+    GObject *entry_obj = gtk_builder_get_object(builder, "url_entry");
+    GObject *video_obj = gtk_builder_get_object(builder, "video_player");
+
+    if (!entry_obj || !video_obj)
+        return;
+
+    GtkEntry *entry = GTK_ENTRY(entry_obj);
+    GtkVideo *video = GTK_VIDEO(video_obj);
+
+    const char *url = gtk_editable_get_text(GTK_EDITABLE(entry));
+
+    if (url && *url)
+    {
+#ifndef __ANDROID__
+        GObject *pipeline_obj = gtk_builder_get_object(builder, "pipeline_check");
+        if (pipeline_obj && gtk_check_button_get_active(GTK_CHECK_BUTTON(pipeline_obj)))
+        {
+            gtk_video_set_file(video, NULL);
+            if (media_pipeline_play(url))
+            {
+                media_show_pipeline(true);
+                return;
+            }
+        }
+        media_pipeline_stop();
+        media_show_pipeline(false);
+#endif
+        GFile *file = g_file_new_for_uri(url);
+        gtk_video_set_file(video, file);
+        g_object_unref(file);
+    }
+}
+
+static void on_sidebar_toggle_clicked(GtkToggleButton *button, gpointer user_data)
+{
+    GtkBuilder *builder = GTK_BUILDER(user_data);
+    GObject *split_obj = gtk_builder_get_object(builder, "split_view");
+
+    if (!split_obj)
+        return;
+
+    gboolean active = gtk_toggle_button_get_active(button);
+
+#ifndef __ANDROID__
+    adw_navigation_split_view_set_show_content(ADW_NAVIGATION_SPLIT_VIEW(split_obj), !active);
+#else
+    GObject *sidebar_obj = gtk_builder_get_object(builder, "sidebar");
+    if (sidebar_obj)
+    {
+        gtk_widget_set_visible(GTK_WIDGET(sidebar_obj), active);
+    }
+#endif
+}
+
+static void ensure_stack_page(GtkBuilder *builder, const char *name);
+
+static void on_nav_row_selected(GtkListBox *box, GtkListBoxRow *row, gpointer user_data)
+{
+    if (!row)
+        return;
+    GtkBuilder *builder = GTK_BUILDER(user_data);
+
+    GObject *stack_obj = gtk_builder_get_object(builder, "main_stack");
+    GObject *split_obj = gtk_builder_get_object(builder, "split_view");
+    GObject *title_obj = gtk_builder_get_object(builder, "content_title");
+
+    if (!stack_obj)
+        return;
+
+    GtkStack *stack = GTK_STACK(stack_obj);
+    int idx = gtk_list_box_row_get_index(row);
+
+    // UPDATED: Added 4th page for Network Test
+    const char *page_names[] = {"dashboard", "live_charts", "video", "network_test"};
+    const char *titles[] = {"Dashboard", "Live Charts", "Media Player", "LibSoup Test"};
+    const char *subtitles[] = {"Air Quality", "System Monitoring", "Video", "Connectivity Check"};
+
+    if (idx >= 0 && idx < 4)
+    {
+        ensure_stack_page(builder, page_names[idx]);
+        gtk_stack_set_visible_child_name(stack, page_names[idx]);
+
+        if (title_obj)
+        {
+            adw_window_title_set_title(ADW_WINDOW_TITLE(title_obj), titles[idx]);
+            adw_window_title_set_subtitle(ADW_WINDOW_TITLE(title_obj), subtitles[idx]);
+        }
+
+#ifndef __ANDROID__
+        if (split_obj && adw_navigation_split_view_get_collapsed(ADW_NAVIGATION_SPLIT_VIEW(split_obj)))
+        {
+            g_object_set(split_obj, "show-sidebar", FALSE, NULL);
+        }
+#else
+        GObject *sidebar_obj = gtk_builder_get_object(builder, "sidebar");
+        if (sidebar_obj)
+        {
+            gtk_widget_set_visible(GTK_WIDGET(sidebar_obj), FALSE);
+        }
+#endif
+    }
+}
+
+// --- Background Sampling ---
+// A dedicated thread takes the system samples and hands them over through a
+// single-producer/single-consumer ring. The main thread only drains it from
+// a frame tick callback while the live charts are mapped, plus an idle
+// fallback when the ring fills up so the rollups keep their history.
+
+#define LIVE_SAMPLE_INTERVAL_MS 1000    // Window visible
+#define LIVE_SAMPLE_BACKGROUND_MS 10000 // Window hidden, minimized or suspended
+#define LIVE_SAMPLE_QUEUE_SIZE 1024     // Power of two
+#define LIVE_SAMPLE_DRAIN_THRESHOLD (LIVE_SAMPLE_QUEUE_SIZE / 2)
+
+typedef struct
+{
+    gint64 time_us;
+    float cpu;
+    float mem;
+    float net;
+    float cpu_core[LIVE_CHART_MAX_CORES];
+    int n_cores;
+} LiveSample;
+
+typedef struct
+{
+    LiveSample slots[LIVE_SAMPLE_QUEUE_SIZE];
+    std::atomic<size_t> head; // Advanced by the sampler thread only
+    std::atomic<size_t> tail; // Advanced by the main thread only
+} LiveSampleQueue;
+
+static LiveSampleQueue live_sample_queue;
+static std::atomic<bool> live_drain_scheduled(false);
+
+// Sampler thread state; the lock only guards the rate-change wakeup
+static GThread *live_sampler_thread = NULL;
+static GMutex live_sampler_lock;
+static GCond live_sampler_cond;
+static int live_sample_interval_ms = LIVE_SAMPLE_INTERVAL_MS;
+static bool live_sample_rate_changed = false;
+
+static guint live_tick_id = 0;
+
+static bool live_sample_queue_push(LiveSampleQueue *queue, const LiveSample &sample)
+{
+    size_t head = queue->head.load(std::memory_order_relaxed);
+    size_t tail = queue->tail.load(std::memory_order_acquire);
+    if (head - tail == LIVE_SAMPLE_QUEUE_SIZE)
+        return false;
+    queue->slots[head & (LIVE_SAMPLE_QUEUE_SIZE - 1)] = sample;
+    queue->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+static bool live_sample_queue_pop(LiveSampleQueue *queue, LiveSample *sample)
+{
+    size_t tail = queue->tail.load(std::memory_order_relaxed);
+    size_t head = queue->head.load(std::memory_order_acquire);
+    if (tail == head)
+        return false;
+    *sample = queue->slots[tail & (LIVE_SAMPLE_QUEUE_SIZE - 1)];
+    queue->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+static size_t live_sample_queue_length(LiveSampleQueue *queue)
+{
+    return queue->head.load(std::memory_order_acquire) - queue->tail.load(std::memory_order_acquire);
+}
+
+// Main thread: moves queued samples into the series; returns how many
+static guint live_series_drain()
+{
+    guint n = 0;
+    LiveSample sample;
+    while (live_sample_queue_pop(&live_sample_queue, &sample))
+    {
+        live_cpu_series.push(sample.time_us, sample.cpu);
+        live_mem_series.push(sample.time_us, sample.mem);
+        live_net_series.push(sample.time_us, sample.net);
+        for (int i = 0; i < sample.n_cores; i++)
+        {
+            if ((size_t)i == live_core_series.size())
+                live_core_series.emplace_back(LIVE_CHART_WINDOW);
+            live_core_series[i].push(sample.time_us, sample.cpu_core[i]);
+        }
+        n++;
+    }
+    return n;
+}
+
+static gboolean on_live_drain_idle(gpointer user_data)
+{
+    live_drain_scheduled.store(false);
+    live_series_drain();
+    return G_SOURCE_REMOVE;
+}
+
+static gpointer live_sampler_main(gpointer user_data)
+{
+    SystemSample sample;
+
+    g_mutex_lock(&live_sampler_lock);
+    for (;;)
+    {
+        int interval_ms = live_sample_interval_ms;
+        g_mutex_unlock(&live_sampler_lock);
+
+        {
+            TRACE_SPAN("system_sampler_read");
+            system_sampler_read(&sample);
+        }
+        LiveSample live;
+        live.time_us = g_get_real_time();
+        live.cpu = (float)sample.cpu_total;
+        live.mem = (float)sample.mem_used;
+        live.net = (float)sample.net_mbps;
+        live.n_cores = MIN(sample.n_cores, LIVE_CHART_MAX_CORES);
+        for (int i = 0; i < live.n_cores; i++)
+            live.cpu_core[i] = (float)sample.cpu_core[i];
+        live_sample_queue_push(&live_sample_queue, live);
+
+        // Nobody is draining (charts unmapped); hand over before the ring fills
+        if (live_sample_queue_length(&live_sample_queue) >= LIVE_SAMPLE_DRAIN_THRESHOLD &&
+            !live_drain_scheduled.exchange(true))
+            g_idle_add(on_live_drain_idle, NULL);
+
+        g_mutex_lock(&live_sampler_lock);
+        gint64 deadline = g_get_monotonic_time() + (gint64)interval_ms * 1000;
+        while (!live_sample_rate_changed)
+        {
+            if (!g_cond_wait_until(&live_sampler_cond, &live_sampler_lock, deadline))
+                break;
+        }
+        live_sample_rate_changed = false;
+    }
+    return NULL;
+}
+
+static void live_sampler_set_interval(int interval_ms)
+{
+    g_mutex_lock(&live_sampler_lock);
+    if (live_sample_interval_ms != interval_ms)
+    {
+        live_sample_interval_ms = interval_ms;
+        live_sample_rate_changed = true;
+        g_cond_signal(&live_sampler_cond);
+    }
+    g_mutex_unlock(&live_sampler_lock);
+}
+
+// Hidden, minimized and (on mobile) suspended windows only need slow samples
+static void live_sampler_update_rate(GtkWidget *window)
+{
+    bool background = !gtk_widget_get_mapped(window);
+
+    GdkSurface *surface = gtk_native_get_surface(GTK_NATIVE(window));
+    if (surface && GDK_IS_TOPLEVEL(surface))
+    {
+        GdkToplevelState state = gdk_toplevel_get_state(GDK_TOPLEVEL(surface));
+        if (state & GDK_TOPLEVEL_STATE_MINIMIZED)
+            background = true;
+#if GTK_CHECK_VERSION(4, 12, 0)
+        if (state & GDK_TOPLEVEL_STATE_SUSPENDED)
+            background = true;
+#endif
+    }
+
+    live_sampler_set_interval(background ? LIVE_SAMPLE_BACKGROUND_MS : LIVE_SAMPLE_INTERVAL_MS);
+}
+
+static void on_live_window_visibility(GtkWidget *window, gpointer user_data)
+{
+    live_sampler_update_rate(window);
+}
+
+static void on_live_surface_state(GObject *surface, GParamSpec *pspec, gpointer user_data)
+{
+    live_sampler_update_rate(GTK_WIDGET(user_data));
+}
+
+static void on_live_window_realize(GtkWidget *window, gpointer user_data)
+{
+    GdkSurface *surface = gtk_native_get_surface(GTK_NATIVE(window));
+    if (surface)
+        g_signal_connect_object(surface, "notify::state", G_CALLBACK(on_live_surface_state), window,
+                                (GConnectFlags)0);
+}
+
+static gboolean on_live_charts_tick(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data)
+{
+    TRACE_SPAN("on_live_charts_tick");
+    GtkBuilder *builder = GTK_BUILDER(user_data);
+    if (live_series_drain() == 0)
+        return G_SOURCE_CONTINUE;
+
+    const char *ids[] = {"chart_live_cpu", "chart_live_mem", "chart_live_net", NULL};
+    for (const char **id = ids; *id; id++)
+    {
+        GObject *obj = gtk_builder_get_object(builder, *id);
+        if (obj)
+            aqi_chart_invalidate(AQI_CHART(obj));
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void on_live_charts_map(GtkWidget *widget, gpointer user_data)
+{
+    if (live_tick_id == 0)
+        live_tick_id = gtk_widget_add_tick_callback(widget, on_live_charts_tick, user_data, NULL);
+}
+
+static void on_live_charts_unmap(GtkWidget *widget, gpointer user_data)
+{
+    if (live_tick_id != 0)
+    {
+        gtk_widget_remove_tick_callback(widget, live_tick_id);
+        live_tick_id = 0;
+    }
+}
+
+// The page's map/unmap hooks are connected when it is built, see
+// setup_live_charts_page
+static void live_sampler_start(GtkWindow *window)
+{
+    g_signal_connect(window, "map", G_CALLBACK(on_live_window_visibility), NULL);
+    g_signal_connect(window, "unmap", G_CALLBACK(on_live_window_visibility), NULL);
+    g_signal_connect(window, "realize", G_CALLBACK(on_live_window_realize), NULL);
+
+    if (!live_sampler_thread)
+        live_sampler_thread = g_thread_new("live-sampler", live_sampler_main, NULL);
+}
+
+// --- Startup Profiling ---
+// --profile-startup (or AQI_PROFILE_STARTUP=1, which also covers the work
+// done before option parsing) prints milestones relative to the start of
+// main, up to the first frame the window's frame clock delivers.
+
+static bool startup_profile_enabled = false;
+static gint64 startup_profile_origin = 0;
+
+static void startup_mark(const char *phase)
+{
+    if (!startup_profile_enabled)
+        return;
+    g_print("[startup] %8.2f ms  %s\n", (g_get_monotonic_time() - startup_profile_origin) / 1000.0, phase);
+}
+
+static gboolean on_startup_first_frame(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data)
+{
+    startup_mark("first frame");
+    return G_SOURCE_REMOVE;
+}
+
+// --- Performance HUD ---
+// Ctrl+Shift+H (or --perf-hud, AQI_PERF_HUD=1) overlays the window with the
+// frame time and the p50/p99 of every span recorded in the last few
+// seconds. --trace FILE (or AQI_TRACE=FILE) records from startup and writes
+// all spans still in the rings as Chrome trace JSON on exit, which Perfetto
+// and chrome://tracing open directly; Ctrl+Shift+T writes one on demand.
+
+#define PERF_HUD_WINDOW_US (5 * G_USEC_PER_SEC)
+#define PERF_HUD_REFRESH_MS 500
+#define PERF_HUD_FRAMES 128 // Frame intervals kept for the frame time stats
 
-        if (current_aqi_data.aqi <= 50)
-            gtk_widget_add_css_class(status_widget, "aqi-good");
-        else if (current_aqi_data.aqi <= 100)
-            gtk_widget_add_css_class(status_widget, "aqi-ok");
-        else
-            gtk_widget_add_css_class(status_widget, "aqi-bad");
-    }
+typedef struct
+{
+    GtkWidget *window;
+    GtkWidget *label; // NULL until the HUD is first shown
+    bool visible;
+    guint tick_id;
+    guint refresh_id;
+
+    gint64 last_frame_us;
+    gint64 frame_intervals_us[PERF_HUD_FRAMES];
+    size_t n_frames; // Total recorded, the last PERF_HUD_FRAMES are kept
+} PerfHud;
+
+static PerfHud perf_hud;
+static char *trace_export_path = NULL;
+static bool perf_hud_requested = false;
+
+static void trace_update_enabled()
+{
+    bool enabled = trace_export_path != NULL || perf_hud.visible;
+#ifdef HAVE_SYSPROF
+    enabled = enabled || g_getenv("SYSPROF_TRACE_FD") != NULL;
+#endif
+    trace_enabled.store(enabled);
+}
 
-    gtk_widget_set_visible(GTK_WIDGET(result_box_obj), TRUE);
+static bool trace_export_chrome(const char *path, GError **error)
+{
+    std::vector<TraceEvent> events;
+    std::vector<guint> tids;
+    trace_collect(0, events, &tids);
 
-    GObject *chart_area_obj = gtk_builder_get_object(builder, "chart_area_current");
-    if (chart_area_obj)
+    GString *json = g_string_new("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    guint max_tid = 0;
+    for (size_t i = 0; i < events.size(); i++)
     {
-        gtk_widget_queue_draw(GTK_WIDGET(chart_area_obj));
+        const TraceEvent &e = events[i];
+        g_string_append_printf(json, "%s\n{\"name\":\"%s\",\"cat\":\"aqi\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                                     "\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT "}",
+                               i ? "," : "", e.name, tids[i], e.start_us, e.duration_us);
+        max_tid = std::max(max_tid, tids[i]);
     }
-
-    GObject *pollutant_box = gtk_builder_get_object(builder, "pollutant_detail_box");
-    if (pollutant_box && current_station_data.has_data)
+    for (guint tid = 1; tid <= max_tid; tid++)
     {
-        gtk_widget_set_visible(GTK_WIDGET(pollutant_box), TRUE);
+        g_string_append_printf(json, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                                     "\"args\":{\"name\":\"thread %u\"}}",
+                               events.empty() && tid == 1 ? "" : ",", tid, tid);
     }
+    g_string_append(json, "\n]}\n");
 
-    GObject *weather_box = gtk_builder_get_object(builder, "weather_box");
-    if (weather_box && current_station_data.has_data)
-    {
-        gtk_widget_set_visible(GTK_WIDGET(weather_box), TRUE);
-    }
+    bool ok = g_file_set_contents(path, json->str, (gssize)json->len, error);
+    if (ok)
+        g_print("Wrote %zu trace events to %s\n", events.size(), path);
+    g_string_free(json, TRUE);
+    return ok;
 }
 
-static void on_fetch_aqi_clicked(GtkButton *button, gpointer user_data)
+static gint64 perf_percentile(std::vector<gint64> &values, double q)
 {
-    GtkBuilder *builder = GTK_BUILDER(user_data);
+    size_t k = (size_t)(q * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
 
-    GObject *entry_obj = gtk_builder_get_object(builder, "city_entry");
-    if (!entry_obj)
-        return;
+static void perf_hud_refresh()
+{
+    GString *text = g_string_new(NULL);
 
-    const char *city = gtk_editable_get_text(GTK_EDITABLE(entry_obj));
-    if (!city || !*city)
+    size_t n = std::min(perf_hud.n_frames, (size_t)PERF_HUD_FRAMES);
+    if (n > 0)
     {
-        city = "Delhi";
+        std::vector<gint64> frames(perf_hud.frame_intervals_us, perf_hud.frame_intervals_us + n);
+        gint64 sum = 0;
+        for (gint64 v : frames)
+            sum += v;
+        double mean_ms = sum / (double)n / 1000.0;
+        g_string_append_printf(text, "frame %6.2f ms  p99 %6.2f ms  %5.1f fps", mean_ms,
+                               perf_percentile(frames, 0.99) / 1000.0, mean_ms > 0 ? 1000.0 / mean_ms : 0.0);
     }
 
-#ifndef __ANDROID__
-    g_free(g_api_city_name);
-    g_api_city_name = g_strdup(city);
-    current_aqi_data.city = g_api_city_name;
-    current_aqi_data.aqi = 0;
-    current_aqi_data.pm25 = 0.0;
-    current_aqi_data.pm10 = 0.0;
-    current_aqi_data.status = "Searching...";
-    current_aqi_data.history.clear();
-    for (int i = 0; i < 24; i++)
-        current_aqi_data.history.push_back(0);
-    update_aqi_display(builder);
+    std::vector<TraceEvent> events;
+    trace_collect(g_get_monotonic_time() - PERF_HUD_WINDOW_US, events, NULL);
+    std::map<std::string, std::vector<gint64>> spans;
+    for (const TraceEvent &e : events)
+        spans[e.name].push_back(e.duration_us);
 
-    waqi_search_cities_async(city, builder, SEARCH_MODE_AUTO_SELECT_FIRST);
-#else
-    current_aqi_data = get_mock_data(city);
-    update_aqi_display(builder);
-#endif
+    for (auto &span : spans)
+    {
+        std::vector<gint64> &d = span.second;
+        size_t count = d.size();
+        gint64 p50 = perf_percentile(d, 0.5);
+        gint64 p99 = perf_percentile(d, 0.99);
+        g_string_append_printf(text, "\n%-26s %5zu  p50 %8.3f ms  p99 %8.3f ms", span.first.c_str(), count,
+                               p50 / 1000.0, p99 / 1000.0);
+    }
+
+    gtk_label_set_text(GTK_LABEL(perf_hud.label), text->str);
+    g_string_free(text, TRUE);
 }
 
-static void on_play_clicked(GtkButton *button, gpointer user_data)
+static gboolean on_perf_hud_refresh(gpointer user_data)
 {
-    GtkBuilder *builder = GTK_BUILDER(user_data);
-    GObject *entry_obj = gtk_builder_get_object(builder, "url_entry");
-    GObject *video_obj = gtk_builder_get_object(builder, "video_player");
-
-    if (!entry_obj || !video_obj)
-        return;
-
-    GtkEntry *entry = GTK_ENTRY(entry_obj);
-    GtkVideo *video = GTK_VIDEO(video_obj);
+    perf_hud_refresh();
+    return G_SOURCE_CONTINUE;
+}
 
-    const char *url = gtk_editable_get_text(GTK_EDITABLE(entry));
+// Also keeps the frame clock running while the HUD is shown, so idle frames
+// are measured too
+static gboolean on_perf_hud_tick(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data)
+{
+    gint64 now = gdk_frame_clock_get_frame_time(frame_clock);
+    if (perf_hud.last_frame_us)
+        perf_hud.frame_intervals_us[perf_hud.n_frames++ % PERF_HUD_FRAMES] = now - perf_hud.last_frame_us;
+    perf_hud.last_frame_us = now;
+    return G_SOURCE_CONTINUE;
+}
 
-    if (url && *url)
+// Wraps the window content in an overlay the first time the HUD is shown
+static void perf_hud_build()
+{
+    AdwApplicationWindow *window = ADW_APPLICATION_WINDOW(perf_hud.window);
+    GtkWidget *content = adw_application_window_get_content(window);
+    GtkWidget *overlay = gtk_overlay_new();
+    if (content)
     {
-        GFile *file = g_file_new_for_uri(url);
-        gtk_video_set_file(video, file);
-        g_object_unref(file);
+        g_object_ref(content);
+        adw_application_window_set_content(window, NULL);
+        gtk_overlay_set_child(GTK_OVERLAY(overlay), content);
+        g_object_unref(content);
     }
+    adw_application_window_set_content(window, overlay);
+
+    perf_hud.label = gtk_label_new(NULL);
+    gtk_widget_add_css_class(perf_hud.label, "perf-hud");
+    gtk_widget_set_halign(perf_hud.label, GTK_ALIGN_END);
+    gtk_widget_set_valign(perf_hud.label, GTK_ALIGN_START);
+    gtk_widget_set_can_target(perf_hud.label, FALSE);
+    gtk_overlay_add_overlay(GTK_OVERLAY(overlay), perf_hud.label);
 }
 
-static void on_sidebar_toggle_clicked(GtkToggleButton *button, gpointer user_data)
+static void perf_hud_set_visible(bool visible)
 {
-    GtkBuilder *builder = GTK_BUILDER(user_data);
-    GObject *split_obj = gtk_builder_get_object(builder, "split_view");
-
-    if (!split_obj)
+    if (perf_hud.visible == visible)
         return;
+    perf_hud.visible = visible;
+    trace_update_enabled();
 
-    gboolean active = gtk_toggle_button_get_active(button);
-
-#ifndef __ANDROID__
-    adw_navigation_split_view_set_show_content(ADW_NAVIGATION_SPLIT_VIEW(split_obj), !active);
-#else
-    GObject *sidebar_obj = gtk_builder_get_object(builder, "sidebar");
-    if (sidebar_obj)
+    if (visible)
     {
-        gtk_widget_set_visible(GTK_WIDGET(sidebar_obj), active);
+        if (!perf_hud.label)
+            perf_hud_build();
+        perf_hud.last_frame_us = 0;
+        perf_hud.n_frames = 0;
+        perf_hud.tick_id = gtk_widget_add_tick_callback(perf_hud.window, on_perf_hud_tick, NULL, NULL);
+        perf_hud.refresh_id = g_timeout_add(PERF_HUD_REFRESH_MS, on_perf_hud_refresh, NULL);
+        perf_hud_refresh();
     }
-#endif
+    else
+    {
+        gtk_widget_remove_tick_callback(perf_hud.window, perf_hud.tick_id);
+        g_source_remove(perf_hud.refresh_id);
+        perf_hud.tick_id = perf_hud.refresh_id = 0;
+    }
+    gtk_widget_set_visible(perf_hud.label, visible);
 }
 
-static void on_nav_row_selected(GtkListBox *box, GtkListBoxRow *row, gpointer user_data)
+static gboolean on_perf_hud_toggle(GtkWidget *widget, GVariant *args, gpointer user_data)
 {
-    if (!row)
-        return;
-    GtkBuilder *builder = GTK_BUILDER(user_data);
-
-    GObject *stack_obj = gtk_builder_get_object(builder, "main_stack");
-    GObject *split_obj = gtk_builder_get_object(builder, "split_view");
-    GObject *title_obj = gtk_builder_get_object(builder, "content_title");
-
-    if (!stack_obj)
-        return;
-
-    GtkStack *stack = GTK_STACK(stack_obj);
-    int idx = gtk_list_box_row_get_index(row);
+    perf_hud_set_visible(!perf_hud.visible);
+    return TRUE;
+}
 
-    // UPDATED: Added 4th page for Network Test
-    const char *page_names[] = {"dashboard", "live_charts", "video", "network_test"};
-    const char *titles[] = {"Dashboard", "Live Charts", "Media Player", "LibSoup Test"};
-    const char *subtitles[] = {"Air Quality", "System Monitoring", "Video", "Connectivity Check"};
+static gboolean on_trace_save(GtkWidget *widget, GVariant *args, gpointer user_data)
+{
+    char *path = g_strdup(trace_export_path);
+    if (!path)
+    {
+        char *name = g_strdup_printf("trace-%" G_GINT64_FORMAT ".json", g_get_real_time() / G_USEC_PER_SEC);
+        char *dir = g_build_filename(g_get_user_cache_dir(), "aqi-dashboard", NULL);
+        g_mkdir_with_parents(dir, 0700);
+        path = g_build_filename(dir, name, NULL);
+        g_free(dir);
+        g_free(name);
+    }
 
-    if (idx >= 0 && idx < 4)
+    GError *error = NULL;
+    if (!trace_export_chrome(path, &error))
     {
-        gtk_stack_set_visible_child_name(stack, page_names[idx]);
+        g_printerr("Failed to write trace %s: %s\n", path, error->message);
+        g_clear_error(&error);
+    }
+    g_free(path);
+    return TRUE;
+}
 
-        if (title_obj)
-        {
-            adw_window_title_set_title(ADW_WINDOW_TITLE(title_obj), titles[idx]);
-            adw_window_title_set_subtitle(ADW_WINDOW_TITLE(title_obj), subtitles[idx]);
-        }
+static void perf_hud_init(GtkWindow *window)
+{
+    perf_hud.window = GTK_WIDGET(window);
+
+    GtkEventController *shortcuts = gtk_shortcut_controller_new();
+    gtk_shortcut_controller_set_scope(GTK_SHORTCUT_CONTROLLER(shortcuts), GTK_SHORTCUT_SCOPE_GLOBAL);
+    gtk_shortcut_controller_add_shortcut(
+        GTK_SHORTCUT_CONTROLLER(shortcuts),
+        gtk_shortcut_new(gtk_shortcut_trigger_parse_string("<Control><Shift>h"),
+                         gtk_callback_action_new(on_perf_hud_toggle, NULL, NULL)));
+    gtk_shortcut_controller_add_shortcut(
+        GTK_SHORTCUT_CONTROLLER(shortcuts),
+        gtk_shortcut_new(gtk_shortcut_trigger_parse_string("<Control><Shift>t"),
+                         gtk_callback_action_new(on_trace_save, NULL, NULL)));
+    gtk_widget_add_controller(GTK_WIDGET(window), shortcuts);
+
+    if (perf_hud_requested)
+        perf_hud_set_visible(true);
+}
 
+static void on_app_shutdown(GApplication *app, gpointer user_data)
+{
 #ifndef __ANDROID__
-        if (split_obj && adw_navigation_split_view_get_collapsed(ADW_NAVIGATION_SPLIT_VIEW(split_obj)))
-        {
-            g_object_set(split_obj, "show-sidebar", FALSE, NULL);
-        }
-#else
-        GObject *sidebar_obj = gtk_builder_get_object(builder, "sidebar");
-        if (sidebar_obj)
-        {
-            gtk_widget_set_visible(GTK_WIDGET(sidebar_obj), FALSE);
-        }
+    media_pipeline_stop();
 #endif
+    if (!trace_export_path)
+        return;
+    GError *error = NULL;
+    if (!trace_export_chrome(trace_export_path, &error))
+    {
+        g_printerr("Failed to write trace %s: %s\n", trace_export_path, error->message);
+        g_clear_error(&error);
     }
 }
 
-static gboolean on_live_tick(gpointer user_data)
+static gint on_handle_local_options(GApplication *app, GVariantDict *options, gpointer user_data)
 {
-    GtkBuilder *builder = GTK_BUILDER(user_data);
-    live_tick++;
-
-    int cpu = (int)GetCPULoad();
-    if (history_cpu.size() >= 24)
-        history_cpu.erase(history_cpu.begin());
-    history_cpu.push_back(cpu);
-
-    int mem = (int)GetMemoryUsage();
-    if (history_mem.size() >= 24)
-        history_mem.erase(history_mem.begin());
-    history_mem.push_back(mem);
-
-    int net = (int)GetNetworkUsage();
-    if (history_net.size() >= 24)
-        history_net.erase(history_net.begin());
-    history_net.push_back(net);
-
-    const char *ids[] = {"chart_live_cpu", "chart_live_mem", "chart_live_net", NULL};
-    for (const char **id = ids; *id; id++)
-    {
-        GObject *obj = gtk_builder_get_object(builder, *id);
-        if (obj)
-            gtk_widget_queue_draw(GTK_WIDGET(obj));
-    }
-    return TRUE;
+    if (g_variant_dict_contains(options, "profile-startup"))
+        startup_profile_enabled = true;
+    startup_mark("options parsed");
+
+    // Environment variables cover devices where the command line is out of reach
+    char *trace_path = NULL;
+    if (g_variant_dict_lookup(options, "trace", "^ay", &trace_path))
+        trace_export_path = trace_path;
+    else if (g_getenv("AQI_TRACE"))
+        trace_export_path = g_strdup(g_getenv("AQI_TRACE"));
+    perf_hud_requested = g_variant_dict_contains(options, "perf-hud") || g_strcmp0(g_getenv("AQI_PERF_HUD"), "1") == 0;
+    if (g_variant_dict_contains(options, "verbose"))
+        g_log_set_debug_enabled(TRUE);
+    trace_update_enabled();
+
+    return -1; // Continue with the default handling
 }
 
 static void load_custom_css()
 {
     GtkCssProvider *provider = gtk_css_provider_new();
-    const char *css_data =
-        "window { font-family: 'Segoe UI', Roboto, Helvetica, Arial, sans-serif; }"
-        ".sidebar { background-color: #f8f9fa; border-right: 1px solid #dee2e6; }"
-        ".sidebar list { background-color: transparent; }"
-        ".sidebar row { padding: 10px 16px; color: #333; font-weight: 500; border-radius: 4px; margin: 2px 8px; }"
-        ".sidebar row:selected { color: #0d6efd; background-color: rgba(13, 110, 253, 0.1); }"
-        ".navigation-sidebar image { color: #495057; -gtk-icon-style: symbolic; }"
-        ".navigation-sidebar row:selected image { color: #0d6efd; }"
-        ".dashboard-title { font-size: 28px; font-weight: 600; color: #212529; }"
-        ".section-title { font-size: 20px; font-weight: 600; color: #212529; margin-top: 24px; margin-bottom: 16px; border-bottom: 1px solid #dee2e6; padding-bottom: 8px; }"
-        ".card { background-color: #fff; border: 1px solid rgba(0,0,0,.125); border-radius: 4px; padding: 20px; box-shadow: 0 2px 4px rgba(0,0,0,0.02); }"
-        ".stat-value { font-size: 28px; font-weight: 700; color: #212529; }"
-        ".stat-label { font-size: 13px; color: #6c757d; font-weight: 600; text-transform: uppercase; }"
-        ".btn-primary { background-color: #0d6efd; color: white; border-radius: 4px; font-weight: 600; padding: 6px 12px; }"
-        ".btn-outline { background-color: white; color: #6c757d; border: 1px solid #6c757d; border-radius: 4px; font-weight: 600; padding: 6px 12px; }"
-        ".aqi-good { color: #198754; }"
-        ".aqi-ok { color: #fd7e14; }"
-        ".aqi-bad { color: #dc3545; }"
-        ".video-card { padding: 0; overflow: hidden; border-radius: 12px; }"
-        ".video-card video { border-radius: 12px; background: #000; min-height: 200px; }";
-    gtk_css_provider_load_from_string(provider, css_data);
+    gtk_css_provider_load_from_resource(provider, "/com/example/mygtk4app/style.css");
 
     GdkDisplay *display = gdk_display_get_default();
     if (display)
@@ -2009,10 +5255,10 @@ static void load_custom_css()
     g_object_unref(provider);
 }
 
-// Function to programmatically build the Network Test page since we cannot modify layout.ui
-static void setup_network_test_ui(GtkBuilder *builder)
+// The Network Test page is built programmatically; only its sidebar row is
+// created at startup, the page itself on first navigation.
+static void setup_network_test_nav(GtkBuilder *builder)
 {
-    // 1. Add Sidebar Item
     GObject *nav_list_obj = gtk_builder_get_object(builder, "nav_list");
     if (nav_list_obj)
     {
@@ -2034,73 +5280,219 @@ static void setup_network_test_ui(GtkBuilder *builder)
 
         gtk_list_box_append(GTK_LIST_BOX(nav_list_obj), row);
     }
+}
 
-    // 2. Add Stack Page
-    GObject *stack_obj = gtk_builder_get_object(builder, "main_stack");
-    if (stack_obj)
+static GtkWidget *build_network_test_page(GtkBuilder *builder)
+{
+    // Main container
+    GtkWidget *scroll = gtk_scrolled_window_new();
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+
+    GtkWidget *clamp = adw_clamp_new();
+    adw_clamp_set_maximum_size(ADW_CLAMP(clamp), 800);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scroll), clamp);
+
+    GtkWidget *content_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 16);
+    gtk_widget_set_margin_top(content_box, 16);
+    gtk_widget_set_margin_bottom(content_box, 24);
+    gtk_widget_set_margin_start(content_box, 16);
+    gtk_widget_set_margin_end(content_box, 16);
+    adw_clamp_set_child(ADW_CLAMP(clamp), content_box);
+
+    // Title
+    GtkWidget *title = gtk_label_new("LibSoup Connectivity Test");
+    gtk_widget_add_css_class(title, "title-1");
+    gtk_widget_set_halign(title, GTK_ALIGN_START);
+    gtk_box_append(GTK_BOX(content_box), title);
+
+    // Controls
+    GtkWidget *ctrl_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    GtkWidget *entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(entry), "Enter URL (e.g. https://httpbin.org/get)");
+    gtk_editable_set_text(GTK_EDITABLE(entry), "https://httpbin.org/get");
+    gtk_widget_set_hexpand(entry, TRUE);
+
+    GtkWidget *btn = gtk_button_new_with_label("Test Request");
+    gtk_widget_add_css_class(btn, "suggested-action");
+
+    GtkWidget *hash_check = gtk_check_button_new_with_label("SHA-256");
+    gtk_widget_set_tooltip_text(hash_check, "Hash the full response body while it streams");
+
+    gtk_box_append(GTK_BOX(ctrl_box), entry);
+    gtk_box_append(GTK_BOX(ctrl_box), hash_check);
+    gtk_box_append(GTK_BOX(ctrl_box), btn);
+    gtk_box_append(GTK_BOX(content_box), ctrl_box);
+
+    // Load test parameters
+    GtkWidget *load_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    struct
+    {
+        const char *label;
+        double min, max, value;
+        GtkWidget **spin;
+    } params[] = {
+        {"Concurrency", 1, HTTP_MAX_CONNS_PER_HOST, 4, &network_test_page.concurrency_spin},
+        {"Requests", 0, 100000, 100, &network_test_page.requests_spin},
+        {"Duration (s)", 0, 3600, 0, &network_test_page.duration_spin},
+    };
+    for (const auto &param : params)
     {
-        // Main container
-        GtkWidget *scroll = gtk_scrolled_window_new();
-        gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+        GtkWidget *label = gtk_label_new(param.label);
+        gtk_widget_add_css_class(label, "dim-label");
+        GtkWidget *spin = gtk_spin_button_new_with_range(param.min, param.max, 1);
+        gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin), param.value);
+        gtk_box_append(GTK_BOX(load_box), label);
+        gtk_box_append(GTK_BOX(load_box), spin);
+        *param.spin = spin;
+    }
+    gtk_widget_set_tooltip_text(network_test_page.requests_spin, "0 runs until the duration is up");
+    gtk_widget_set_tooltip_text(network_test_page.duration_spin, "0 runs until all requests are done");
+
+    GtkWidget *load_btn = gtk_button_new_with_label("Run Load Test");
+    gtk_widget_set_hexpand(load_btn, TRUE);
+    gtk_widget_set_halign(load_btn, GTK_ALIGN_END);
+    gtk_box_append(GTK_BOX(load_box), load_btn);
+    gtk_box_append(GTK_BOX(content_box), load_box);
+
+    // Log output
+    GtkWidget *frame = gtk_frame_new(NULL);
+    gtk_widget_add_css_class(frame, "card");
+
+    GtkWidget *log_scroll = gtk_scrolled_window_new();
+    gtk_widget_set_size_request(log_scroll, -1, 300);
+
+    GtkWidget *log_view = gtk_text_view_new();
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(log_view), FALSE);
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(log_view), TRUE);
+    gtk_text_view_set_left_margin(GTK_TEXT_VIEW(log_view), 10);
+    gtk_text_view_set_right_margin(GTK_TEXT_VIEW(log_view), 10);
+    gtk_text_view_set_top_margin(GTK_TEXT_VIEW(log_view), 10);
+    gtk_text_view_set_bottom_margin(GTK_TEXT_VIEW(log_view), 10);
+    gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(log_view), GTK_WRAP_CHAR);
+
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(log_scroll), log_view);
+    gtk_frame_set_child(GTK_FRAME(frame), log_scroll);
+    gtk_box_append(GTK_BOX(content_box), frame);
+
+    network_test_page.url_entry = entry;
+    network_test_page.log_view = log_view;
+    network_test_page.test_button = btn;
+    network_test_page.hash_check = hash_check;
+    network_test_page.load_button = load_btn;
+    g_signal_connect(btn, "clicked", G_CALLBACK(on_network_test_clicked), NULL);
+    g_signal_connect(load_btn, "clicked", G_CALLBACK(on_load_test_clicked), NULL);
+
+    return scroll;
+}
 
-        GtkWidget *clamp = adw_clamp_new();
-        adw_clamp_set_maximum_size(ADW_CLAMP(clamp), 800);
-        gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scroll), clamp);
+// --- Lazy Stack Pages ---
+// Only the dashboard is in layout.ui. The other pages come from their own
+// resource .ui files (or code) and are added to main_stack the first time
+// they are navigated to.
 
-        GtkWidget *content_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 16);
-        gtk_widget_set_margin_top(content_box, 16);
-        gtk_widget_set_margin_bottom(content_box, 24);
-        gtk_widget_set_margin_start(content_box, 16);
-        gtk_widget_set_margin_end(content_box, 16);
-        adw_clamp_set_child(ADW_CLAMP(clamp), content_box);
+static void setup_live_charts_page(GtkBuilder *builder)
+{
+    struct LiveChartConfig
+    {
+        const char *id;
+        const MetricSeries<float> *series;
+        ChartUnit unit;
+    };
+    LiveChartConfig live_charts[] = {
+        {"chart_live_cpu", &live_cpu_series, CHART_UNIT_PERCENT},
+        {"chart_live_mem", &live_mem_series, CHART_UNIT_PERCENT},
+        {"chart_live_net", &live_net_series, CHART_UNIT_MBPS}};
 
-        // Title
-        GtkWidget *title = gtk_label_new("LibSoup Connectivity Test");
-        gtk_widget_add_css_class(title, "title-1");
-        gtk_widget_set_halign(title, GTK_ALIGN_START);
-        gtk_box_append(GTK_BOX(content_box), title);
+    for (const auto &cfg : live_charts)
+    {
+        GObject *obj = gtk_builder_get_object(builder, cfg.id);
+        if (obj)
+            aqi_chart_set_live_series(AQI_CHART(obj), cfg.series, cfg.unit);
+    }
 
-        // Controls
-        GtkWidget *ctrl_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
-        GtkWidget *entry = gtk_entry_new();
-        gtk_entry_set_placeholder_text(GTK_ENTRY(entry), "Enter URL (e.g. https://httpbin.org/get)");
-        gtk_editable_set_text(GTK_EDITABLE(entry), "https://httpbin.org/get");
-        gtk_widget_set_hexpand(entry, TRUE);
+    GObject *cpu_chart = gtk_builder_get_object(builder, "chart_live_cpu");
+    if (cpu_chart)
+        aqi_chart_set_live_lines(AQI_CHART(cpu_chart), &live_core_series);
 
-        GtkWidget *btn = gtk_button_new_with_label("Test Request");
-        gtk_widget_add_css_class(btn, "suggested-action");
+    GObject *flow = gtk_builder_get_object(builder, "live_charts_flow");
+    if (flow)
+    {
+        g_signal_connect(flow, "map", G_CALLBACK(on_live_charts_map), builder);
+        g_signal_connect(flow, "unmap", G_CALLBACK(on_live_charts_unmap), builder);
+    }
+}
 
-        gtk_box_append(GTK_BOX(ctrl_box), entry);
-        gtk_box_append(GTK_BOX(ctrl_box), btn);
-        gtk_box_append(GTK_BOX(content_box), ctrl_box);
+static void setup_video_page(GtkBuilder *builder)
+{
+    GObject *btn_play = gtk_builder_get_object(builder, "play_button");
+    if (btn_play)
+        g_signal_connect(btn_play, "clicked", G_CALLBACK(on_play_clicked), builder);
 
-        // Log output
-        GtkWidget *frame = gtk_frame_new(NULL);
-        gtk_widget_add_css_class(frame, "card");
+#ifndef __ANDROID__
+    media_pipeline.picture = GTK_WIDGET(gtk_builder_get_object(builder, "video_picture"));
+    media_pipeline.video = GTK_WIDGET(gtk_builder_get_object(builder, "video_player"));
+    media_pipeline.stats_label = GTK_LABEL(gtk_builder_get_object(builder, "video_stats"));
+#else
+    GObject *pipeline_check = gtk_builder_get_object(builder, "pipeline_check");
+    if (pipeline_check)
+        gtk_widget_set_visible(GTK_WIDGET(pipeline_check), FALSE);
+#endif
+}
 
-        GtkWidget *log_scroll = gtk_scrolled_window_new();
-        gtk_widget_set_size_request(log_scroll, -1, 300);
+typedef struct
+{
+    const char *name;
+    const char *title;
+    const char *resource; // NULL when built in code
+    const char *root_id;
+    void (*setup)(GtkBuilder *builder);
+} LazyPage;
+
+static const LazyPage lazy_pages[] = {
+    {"live_charts", "Live Charts", "/com/example/mygtk4app/live_charts.ui", "live_charts_page", setup_live_charts_page},
+    {"video", "Media Player", "/com/example/mygtk4app/video.ui", "video_page", setup_video_page},
+    {"network_test", "LibSoup Test", NULL, NULL, NULL},
+};
+
+static void ensure_stack_page(GtkBuilder *builder, const char *name)
+{
+    GObject *stack_obj = gtk_builder_get_object(builder, "main_stack");
+    if (!stack_obj || gtk_stack_get_child_by_name(GTK_STACK(stack_obj), name))
+        return;
 
-        GtkWidget *log_view = gtk_text_view_new();
-        gtk_text_view_set_editable(GTK_TEXT_VIEW(log_view), FALSE);
-        gtk_text_view_set_monospace(GTK_TEXT_VIEW(log_view), TRUE);
-        gtk_text_view_set_left_margin(GTK_TEXT_VIEW(log_view), 10);
-        gtk_text_view_set_right_margin(GTK_TEXT_VIEW(log_view), 10);
-        gtk_text_view_set_top_margin(GTK_TEXT_VIEW(log_view), 10);
-        gtk_text_view_set_bottom_margin(GTK_TEXT_VIEW(log_view), 10);
-        gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(log_view), GTK_WRAP_CHAR);
+    for (const LazyPage &page : lazy_pages)
+    {
+        if (strcmp(page.name, name) != 0)
+            continue;
 
-        gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(log_scroll), log_view);
-        gtk_frame_set_child(GTK_FRAME(frame), log_scroll);
-        gtk_box_append(GTK_BOX(content_box), frame);
+        gint64 start = g_get_monotonic_time();
+        GtkWidget *child = NULL;
+        if (page.resource)
+        {
+            GError *error = NULL;
+            if (!gtk_builder_add_from_resource(builder, page.resource, &error))
+            {
+                g_printerr("Error loading %s: %s\n", page.resource, error->message);
+                g_clear_error(&error);
+                return;
+            }
+            GObject *root = gtk_builder_get_object(builder, page.root_id);
+            child = root ? GTK_WIDGET(root) : NULL;
+        }
+        else
+        {
+            child = build_network_test_page(builder);
+        }
 
-        // Connect Signal
-        // Pass the log view as data attached to the entry, so we can access it in callback
-        g_object_set_data(G_OBJECT(entry), "log_view", log_view);
-        g_signal_connect(btn, "clicked", G_CALLBACK(on_network_test_clicked), entry);
+        if (!child)
+            return;
+        if (page.setup)
+            page.setup(builder);
+        gtk_stack_add_titled(GTK_STACK(stack_obj), child, page.name, page.title);
 
-        // Add to stack
-        gtk_stack_add_named(GTK_STACK(stack_obj), scroll, "network_test");
+        if (startup_profile_enabled)
+            g_print("[startup] built page %s in %.2f ms\n", page.name, (g_get_monotonic_time() - start) / 1000.0);
+        return;
     }
 }
 
@@ -2112,6 +5504,7 @@ static void on_activate(GtkApplication *app, gpointer user_data)
     g_type_ensure(ADW_TYPE_HEADER_BAR);
     g_type_ensure(ADW_TYPE_CLAMP);
     g_type_ensure(ADW_TYPE_WINDOW_TITLE);
+    g_type_ensure(AQI_TYPE_CHART);
 
 #ifndef __ANDROID__
     g_type_ensure(ADW_TYPE_NAVIGATION_SPLIT_VIEW);
@@ -2123,30 +5516,30 @@ static void on_activate(GtkApplication *app, gpointer user_data)
     g_type_ensure(GTK_TYPE_BOX);
 #endif
 
+    startup_mark("types registered");
+
+    // Desktop builds register the compiled-in bundle from its constructor
 #ifdef __ANDROID__
     GResource *resource = resources_get_resource();
     g_resources_register(resource);
+#else
+    station_index_load();
+    startup_mark("station index loaded");
 #endif
 
     load_custom_css();
+    startup_mark("css loaded");
+
     GtkBuilder *builder = gtk_builder_new();
     GError *error = NULL;
 
-#ifdef __ANDROID__
     if (!gtk_builder_add_from_resource(builder, "/com/example/mygtk4app/layout.ui", &error))
     {
         g_printerr("Error loading layout.ui from resource: %s\n", error->message);
         g_clear_error(&error);
         return;
     }
-#else
-    if (!gtk_builder_add_from_file(builder, "layout.ui", &error))
-    {
-        g_printerr("Error loading layout.ui: %s\n", error->message);
-        g_clear_error(&error);
-        return;
-    }
-#endif
+    startup_mark("layout built");
 
     GObject *window_obj = gtk_builder_get_object(builder, "window");
     if (!window_obj)
@@ -2157,9 +5550,10 @@ static void on_activate(GtkApplication *app, gpointer user_data)
 
     GtkWindow *window = GTK_WINDOW(window_obj);
     gtk_window_set_application(window, app);
+    aqi_view_bind(builder);
 
-    // Inject the Network Test UI programmatically
-    setup_network_test_ui(builder);
+    // Inject the Network Test sidebar row; the page is built lazily
+    setup_network_test_nav(builder);
 
     GObject *btn_fetch = gtk_builder_get_object(builder, "btn_fetch_aqi");
     if (btn_fetch)
@@ -2172,17 +5566,11 @@ static void on_activate(GtkApplication *app, gpointer user_data)
         g_signal_connect(city_entry, "changed", G_CALLBACK(on_city_entry_changed), builder);
     }
 
-    GObject *search_list = gtk_builder_get_object(builder, "search_results_list");
-    if (search_list)
-    {
-        g_signal_connect(search_list, "row-selected", G_CALLBACK(on_search_result_selected), builder);
-    }
+    setup_search_results_list(builder);
+    station_snapshot_warm_start(builder);
+    startup_mark("station snapshot loaded");
 #endif
 
-    GObject *btn_play = gtk_builder_get_object(builder, "play_button");
-    if (btn_play)
-        g_signal_connect(btn_play, "clicked", G_CALLBACK(on_play_clicked), builder);
-
     GObject *sidebar_toggle = gtk_builder_get_object(builder, "sidebar_toggle");
     if (sidebar_toggle)
     {
@@ -2198,143 +5586,129 @@ static void on_activate(GtkApplication *app, gpointer user_data)
             gtk_list_box_select_row(GTK_LIST_BOX(nav_list), first_row);
     }
 
-    GObject *chart_current = gtk_builder_get_object(builder, "chart_area_current");
-    if (chart_current)
-    {
-        gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(chart_current), on_draw_chart, NULL, NULL);
+    live_sampler_start(window);
+    perf_hud_init(window);
+    startup_mark("signals connected");
 
-        GtkEventController *motion = gtk_event_controller_motion_new();
-        g_signal_connect(motion, "motion", G_CALLBACK(on_chart_motion), chart_current);
-        g_signal_connect(motion, "leave", G_CALLBACK(on_chart_leave), chart_current);
-        gtk_widget_add_controller(GTK_WIDGET(chart_current), motion);
-    }
+    if (startup_profile_enabled)
+        gtk_widget_add_tick_callback(GTK_WIDGET(window), on_startup_first_frame, NULL, NULL);
 
-    struct LiveChartConfig
+    gtk_window_present(window);
+    startup_mark("window presented");
+    g_object_set_data_full(G_OBJECT(window), "builder", builder, g_object_unref);
+}
+
+#ifdef __ANDROID__
+// --- Android Startup ---
+// The APK's native libraries live in a per-install directory. dladdr on a
+// libadwaita symbol names it directly, with no /proc/self/maps scan.
+// glib-networking's OpenSSL backend needs libcrypto and libssl from that
+// directory; a thread loads them, and resolves the TLS backend, while
+// on_activate builds the UI. The HTTP session waits for it before the
+// first request. AQI_TLS_PRELOAD_SYNC=1 restores the old inline preload,
+// so AQI_PROFILE_STARTUP=1 can compare time to first frame between the two.
+
+#define ANDROID_LEGACY_LIB_DIR "/data/data/com.example.mygtk4app/lib"
+
+static GThread *android_tls_preload_thread = NULL;
+
+static char *android_library_dir()
+{
+    Dl_info info;
+    if (!dladdr((void *)adw_application_new, &info) || !info.dli_fname)
+        return NULL;
+    return g_path_get_dirname(info.dli_fname);
+}
+
+// Tries the plain name, then the versioned one some builds ship
+static void android_preload_library(const char *lib_dir, const char *name)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s.so", lib_dir, name);
+    GModule *module = g_module_open(path, G_MODULE_BIND_LAZY);
+    if (!module)
     {
-        const char *id;
-        const char *type;
-    };
-    LiveChartConfig live_charts[] = {
-        {"chart_live_cpu", "CPU Load"},
-        {"chart_live_mem", "Memory Usage"},
-        {"chart_live_net", "Network Traffic"}};
+        snprintf(path, sizeof(path), "%s/%s.so.3", lib_dir, name);
+        module = g_module_open(path, G_MODULE_BIND_LAZY);
+    }
 
-    for (const auto &cfg : live_charts)
+    if (!module)
     {
-        GObject *obj = gtk_builder_get_object(builder, cfg.id);
-        if (obj)
-        {
-            GtkWidget *w = GTK_WIDGET(obj);
-            g_object_set_data(G_OBJECT(w), "is_live", (gpointer)1);
-            g_object_set_data(G_OBJECT(w), "live_type", (gpointer)cfg.type);
-            gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(w), on_draw_chart, NULL, NULL);
-
-            GtkEventController *motion = gtk_event_controller_motion_new();
-            g_signal_connect(motion, "motion", G_CALLBACK(on_chart_motion), w);
-            g_signal_connect(motion, "leave", G_CALLBACK(on_chart_leave), w);
-            gtk_widget_add_controller(w, motion);
-        }
+        g_printerr("Failed to load %s from %s: %s\n", name, lib_dir, g_module_error());
+        return;
     }
+    g_module_make_resident(module);
+    g_debug("Loaded %s", path);
+}
 
-    g_timeout_add(1000, on_live_tick, builder);
+static gpointer android_tls_preload_main(gpointer user_data)
+{
+    char *lib_dir = (char *)user_data;
+    android_preload_library(lib_dir, "libcrypto");
+    android_preload_library(lib_dir, "libssl");
+    g_free(lib_dir);
 
-    gtk_window_present(window);
-    g_object_set_data_full(G_OBJECT(window), "builder", builder, g_object_unref);
+    // Scans GIO_EXTRA_MODULES and loads the OpenSSL backend off the main thread
+    g_tls_backend_get_default();
+    startup_mark("tls preloaded");
+    return NULL;
 }
 
-#ifdef __ANDROID__
-static char *find_library_path() {
-    FILE *maps = fopen("/proc/self/maps", "r");
-    if (!maps) return NULL;
-
-    char line[1024];
-    char *found_path = NULL;
-
-    while (fgets(line, sizeof(line), maps)) {
-        // Look for one of our known libraries
-        if (strstr(line, "libadwaita-1.so") || strstr(line, "libgtk-4.so")) {
-            // Parse the path from the line (e.g., ... /data/app/xx/lib/arm64/libadwaita-1.so)
-            char *path_start = strchr(line, '/');
-            if (path_start) {
-                // Find the end of the path
-                char *path_end = strchr(path_start, '\n');
-                if (path_end) *path_end = '\0';
-                
-                // Get the directory component
-                char *last_slash = strrchr(path_start, '/');
-                if (last_slash) {
-                    *last_slash = '\0'; // Cut off the filename
-                    found_path = g_strdup(path_start);
-                    break;
-                }
-            }
-        }
+static void android_tls_preload_wait()
+{
+    if (!android_tls_preload_thread)
+        return;
+    g_thread_join(android_tls_preload_thread);
+    android_tls_preload_thread = NULL;
+}
+
+static void android_startup()
+{
+    char *lib_dir = android_library_dir();
+    if (!lib_dir)
+    {
+        g_printerr("CRITICAL: dladdr could not locate the library directory, falling back to %s\n",
+                   ANDROID_LEGACY_LIB_DIR);
+        lib_dir = g_strdup(ANDROID_LEGACY_LIB_DIR);
     }
-    fclose(maps);
-    return found_path;
+    g_debug("Library path: %s", lib_dir);
+    startup_mark("library path resolved");
+
+    g_setenv("GIO_EXTRA_MODULES", lib_dir, TRUE);
+    g_setenv("SSL_CERT_DIR", "/system/etc/security/cacerts", TRUE);
+
+    android_tls_preload_thread = g_thread_new("tls-preload", android_tls_preload_main, lib_dir);
+    if (g_strcmp0(g_getenv("AQI_TLS_PRELOAD_SYNC"), "1") == 0)
+        android_tls_preload_wait();
 }
 #endif
 
 int main(int argc, char *argv[])
 {
+    startup_profile_origin = g_get_monotonic_time();
+    startup_profile_enabled = g_strcmp0(g_getenv("AQI_PROFILE_STARTUP"), "1") == 0;
+    if (g_strcmp0(g_getenv("AQI_VERBOSE"), "1") == 0)
+        g_log_set_debug_enabled(TRUE);
+
 #ifndef __ANDROID__
     g_setenv("GTK_MEDIA_DRIVER", "gstreamer", TRUE);
     gst_init(&argc, &argv);
 #else
-// 1. Dynamically find where Android put our libraries
-    char *lib_dir = find_library_path();
-    
-    if (lib_dir == NULL) {
-        g_printerr("CRITICAL: Could not find library path in /proc/self/maps! Fallback to legacy.\n");
-        lib_dir = g_strdup("/data/data/com.example.mygtk4app/lib");
-    }
-    
-    g_print("FOUND LIBRARY PATH: %s\n", lib_dir);
-
-    // 2. Setup Environment Variables
-    g_setenv("GIO_EXTRA_MODULES", lib_dir, TRUE);
-    g_setenv("SSL_CERT_DIR", "/system/etc/security/cacerts", TRUE);
-    g_setenv("G_MESSAGES_DEBUG", "all", TRUE);
-
-    // 3. CRITICAL FIX: Pre-load OpenSSL Dependencies using the correct path
-    char path[512];
-    
-    // Load libcrypto
-    snprintf(path, sizeof(path), "%s/libcrypto.so", lib_dir);
-    GModule *mod_crypto = g_module_open(path, G_MODULE_BIND_LAZY);
-    if (!mod_crypto) {
-        // Try versioned name if base fails (common in some builds)
-        snprintf(path, sizeof(path), "%s/libcrypto.so.3", lib_dir);
-        mod_crypto = g_module_open(path, G_MODULE_BIND_LAZY);
-    }
-    
-    if (!mod_crypto) {
-        g_printerr("Failed to load libcrypto from %s: %s\n", lib_dir, g_module_error());
-    } else {
-        g_module_make_resident(mod_crypto);
-        g_print("Successfully loaded libcrypto\n");
-    }
-
-    // Load libssl
-    snprintf(path, sizeof(path), "%s/libssl.so", lib_dir);
-    GModule *mod_ssl = g_module_open(path, G_MODULE_BIND_LAZY);
-    if (!mod_ssl) {
-        snprintf(path, sizeof(path), "%s/libssl.so.3", lib_dir);
-        mod_ssl = g_module_open(path, G_MODULE_BIND_LAZY);
-    }
-
-    if (!mod_ssl) {
-        g_printerr("Failed to load libssl from %s: %s\n", lib_dir, g_module_error());
-    } else {
-        g_module_make_resident(mod_ssl);
-        g_print("Successfully loaded libssl\n");
-    }
-    
-    g_free(lib_dir);
+    android_startup();
 #endif
 
     AdwApplication *app = adw_application_new("com.example.aqi", G_APPLICATION_DEFAULT_FLAGS);
+    g_application_add_main_option(G_APPLICATION(app), "profile-startup", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE,
+                                  "Print a startup timing trace", NULL);
+    g_application_add_main_option(G_APPLICATION(app), "trace", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME,
+                                  "Record tracing spans and write them as Chrome trace JSON on exit", "FILE");
+    g_application_add_main_option(G_APPLICATION(app), "perf-hud", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE,
+                                  "Show the performance overlay", NULL);
+    g_application_add_main_option(G_APPLICATION(app), "verbose", 'v', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE,
+                                  "Print debug messages", NULL);
+    g_signal_connect(app, "handle-local-options", G_CALLBACK(on_handle_local_options), NULL);
     g_signal_connect(app, "activate", G_CALLBACK(on_activate), NULL);
+    g_signal_connect(app, "shutdown", G_CALLBACK(on_app_shutdown), NULL);
 
     int status = g_application_run(G_APPLICATION(app), argc, argv);
     g_object_unref(app);
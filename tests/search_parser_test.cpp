@@ -0,0 +1,142 @@
+// Tests for waqi_parse_search_response and the bounded JSON cursor behind it.
+// Every payload is handed over in a buffer of exactly its length, without a
+// terminating NUL, so a read past `size` shows up under the sanitizers.
+
+#include "aqi_core.h"
+
+#include <string.h>
+#include <string>
+
+static WAQISearchBatch *parse(const std::string &json)
+{
+    char *copy = (char *)g_malloc(json.size() ? json.size() : 1);
+    memcpy(copy, json.data(), json.size());
+    WAQISearchBatch *batch = waqi_parse_search_response(copy, json.size());
+    g_free(copy);
+    return batch;
+}
+
+static const char station_json[] = "{\"s\":{\"a\":\"42\",\"n\":[\"Delhi\",\"extra\"],\"u\":\"india/delhi/@1234\","
+                                   "\"c\":\"IN\",\"$\":\"cpcb\"},\"n\":[\"Delhi\",\"\",\"India\"],\"x\":1234}";
+
+static void test_basic()
+{
+    WAQISearchBatch *batch = parse(std::string("{\"results\":[") + station_json + "]}");
+    g_assert_cmpuint(batch->results.size(), ==, 1);
+
+    const WAQISearchResult &r = batch->results[0];
+    g_assert_cmpstr(r.station_id, ==, "1234");
+    g_assert_cmpstr(r.station_name, ==, "Delhi");
+    g_assert_cmpstr(r.full_address, ==, "Delhi > India");
+    g_assert_cmpstr(r.url, ==, "india/delhi/@1234");
+    g_assert_cmpstr(r.country, ==, "IN");
+    g_assert_cmpstr(r.source, ==, "cpcb");
+    g_assert_cmpint(r.aqi, ==, 42);
+    g_assert_true(r.has_aqi);
+    waqi_search_batch_unref(batch);
+}
+
+static void test_missing_aqi()
+{
+    WAQISearchBatch *batch =
+        parse("{\"results\":[{\"s\":{\"a\":\"-\",\"n\":[\"Nowhere\"],\"u\":\"x/@7\"},\"n\":[\"Nowhere\"]}]}");
+    g_assert_cmpuint(batch->results.size(), ==, 1);
+    g_assert_false(batch->results[0].has_aqi);
+    g_assert_cmpstr(batch->results[0].station_id, ==, "7");
+    waqi_search_batch_unref(batch);
+}
+
+static void test_escapes()
+{
+    WAQISearchBatch *batch = parse("{\"results\":[{\"s\":{\"a\":1,\"n\":[\"Caf\\u00e9 \\\"Nord\\\" a\\/b\\\\c\\n\\t\"],"
+                                   "\"u\":\"x/@1\"},\"n\":[\"A\\u0026B\"]}]}");
+    g_assert_cmpuint(batch->results.size(), ==, 1);
+    g_assert_cmpstr(batch->results[0].station_name, ==, "Caf\xC3\xA9 \"Nord\" a/b\\c\n\t");
+    g_assert_cmpstr(batch->results[0].full_address, ==, "A&B");
+    waqi_search_batch_unref(batch);
+}
+
+static void test_surrogates()
+{
+    // A pair, an unpaired high surrogate, a lone low surrogate, a cut-off escape
+    WAQISearchBatch *batch = parse("{\"results\":["
+                                   "{\"s\":{\"n\":[\"\\ud83d\\ude00!\"],\"u\":\"x/@1\"}},"
+                                   "{\"s\":{\"n\":[\"\\ud83d x\"],\"u\":\"x/@2\"}},"
+                                   "{\"s\":{\"n\":[\"\\ude00\"],\"u\":\"x/@3\"}},"
+                                   "{\"s\":{\"n\":[\"ab\\u12\"],\"u\":\"x/@4\"}}]}");
+    g_assert_cmpuint(batch->results.size(), ==, 4);
+    g_assert_cmpstr(batch->results[0].station_name, ==, "\xF0\x9F\x98\x80!");
+    g_assert_cmpstr(batch->results[1].station_name, ==, "\xEF\xBF\xBD x");
+    g_assert_cmpstr(batch->results[2].station_name, ==, "\xEF\xBF\xBD");
+    g_assert_cmpstr(batch->results[3].station_name, ==, "ab");
+    waqi_search_batch_unref(batch);
+}
+
+static void test_non_object()
+{
+    const char *payloads[] = {"", "[]", "\"results\"", "42", "null", "{\"results\":{}}", "{\"results\":\"x\"}",
+                              "{\"data\":[1,2],\"results\":7}"};
+    for (const char *p : payloads)
+    {
+        WAQISearchBatch *batch = parse(p);
+        g_assert_cmpuint(batch->results.size(), ==, 0);
+        waqi_search_batch_unref(batch);
+    }
+
+    // Entries that are not objects, or malformed ones, are skipped one by one
+    WAQISearchBatch *batch = parse(std::string("{\"results\":[1,\"two\",[3],null,{\"s\":[]},") + station_json + "]}");
+    g_assert_cmpuint(batch->results.size(), ==, 1);
+    g_assert_cmpstr(batch->results[0].station_id, ==, "1234");
+    waqi_search_batch_unref(batch);
+}
+
+static void test_truncated()
+{
+    std::string full = std::string("{\"results\":[") + station_json + "," + station_json + "]}";
+    for (size_t n = 0; n < full.size(); n++)
+    {
+        WAQISearchBatch *batch = parse(full.substr(0, n));
+        g_assert_cmpuint(batch->results.size(), <=, 2);
+        for (const WAQISearchResult &r : batch->results)
+            g_assert_cmpstr(r.station_id, ==, "1234");
+        waqi_search_batch_unref(batch);
+    }
+}
+
+static void test_oversized()
+{
+    // Many results with long names all land in the one string chunk
+    std::string name(64 * 1024, 'n');
+    std::string json = "{\"results\":[";
+    for (int i = 0; i < 200; i++)
+    {
+        if (i)
+            json += ',';
+        json += "{\"s\":{\"n\":[\"" + name + "\"],\"u\":\"x/@" + std::to_string(i) + "\"}}";
+    }
+    json += "]}";
+
+    WAQISearchBatch *batch = parse(json);
+    g_assert_cmpuint(batch->results.size(), ==, 200);
+    g_assert_cmpuint(strlen(batch->results[199].station_name), ==, name.size());
+    g_assert_cmpstr(batch->results[199].station_id, ==, "199");
+    waqi_search_batch_unref(batch);
+
+    // An unterminated string running to the end of a large buffer
+    batch = parse("{\"results\":[{\"s\":{\"n\":[\"" + name);
+    g_assert_cmpuint(batch->results.size(), ==, 0);
+    waqi_search_batch_unref(batch);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/search-parser/basic", test_basic);
+    g_test_add_func("/search-parser/missing-aqi", test_missing_aqi);
+    g_test_add_func("/search-parser/escapes", test_escapes);
+    g_test_add_func("/search-parser/surrogates", test_surrogates);
+    g_test_add_func("/search-parser/non-object", test_non_object);
+    g_test_add_func("/search-parser/truncated", test_truncated);
+    g_test_add_func("/search-parser/oversized", test_oversized);
+    return g_test_run();
+}
@@ -0,0 +1,268 @@
+// Tests for waqi_decode_event and the JSON skipping behind it: each event
+// type, the rules for repeated members, and values that straddle the 64-byte
+// blocks json_skip_value classifies at every possible offset.
+
+#include "aqi_core.h"
+
+#include <math.h>
+#include <string.h>
+#include <string>
+
+// Decodes a copy of `json`, NUL-terminated as the framer leaves events
+static WAQIEventType decode(WAQIStationData &station, const std::string &json, WAQIHourlyMeans *hourly)
+{
+    std::string copy = json;
+    return waqi_decode_event(station, copy.c_str(), copy.size(), hourly);
+}
+
+static size_t field_index(const char *key)
+{
+    for (size_t i = 0; i < N_POLLUTANT_FIELDS; i++)
+        if (strcmp(pollutant_fields[i].key, key) == 0)
+            return i;
+    g_assert_not_reached();
+    return 0;
+}
+
+#define HOURLY_START 1699999200 // 2023-11-14 22:00 UTC
+
+// An hourly array of `n` hour objects, one hour apart from HOURLY_START,
+// with means first, first + 1, ...
+static std::string hourly_array(int n, int first)
+{
+    std::string json = "[";
+    for (int i = 0; i < n; i++)
+    {
+        if (i)
+            json += ',';
+        json += "{\"t\":" + std::to_string(HOURLY_START + i * 3600) + ",\"min\":1,\"max\":9,\"avg\":5,\"mean\":" +
+                std::to_string(first + i) + ",\"n\":3}";
+    }
+    return json + "]";
+}
+
+static void test_meta()
+{
+    WAQIStationData station = {};
+    WAQIHourlyMeans hourly;
+    // "pm25" ahead of "feed" is not the current value
+    WAQIEventType type = decode(station,
+                                "{\"type\":\"meta\",\"name\":\"\\\"Nord\\\" Park\",\"pm25\":[1,900],"
+                                "\"geo\":[12.5,-77.25],\"attributions\":[{\"name\":\"Agency\",\"url\":\"x\"}],"
+                                "\"feed\":{\"pm25\":[1700000000,4550],\"pm10\":[1,8000],\"so2\":[1,250]}}",
+                                &hourly);
+    g_assert_cmpint(type, ==, WAQI_EVENT_META);
+    g_assert_true(station.has_data);
+    g_assert_cmpstr(station.station_name.c_str(), ==, "\"Nord\" Park");
+    g_assert_cmpfloat(station.latitude, ==, 12.5);
+    g_assert_cmpfloat(station.longitude, ==, -77.25);
+    g_assert_cmpfloat(station.pm25, ==, 45.5);
+    g_assert_cmpfloat(station.pm10, ==, 80.0);
+    g_assert_cmpfloat(station.so2, ==, 2.5);
+    g_assert_cmpint(station.aqi, ==, calculate_aqi_from_pm25(45.5));
+}
+
+static void test_instant()
+{
+    WAQIStationData station = {};
+    station.pm10 = 12.0;
+    WAQIHourlyMeans hourly;
+    WAQIEventType type = decode(station,
+                                "{\"type\":\"instant\",\"data\":{\"t\":[[1700000000,20]],"
+                                "\"pm25\":[[1700000100,6012],[1700000000,1]],\"o3\":[[1700000100,1111]]}}",
+                                &hourly);
+    g_assert_cmpint(type, ==, WAQI_EVENT_INSTANT);
+    g_assert_false(station.has_data);
+    g_assert_cmpfloat(fabs(station.pm25 - 60.12), <, 1e-9);
+    g_assert_cmpfloat(fabs(station.o3 - 11.11), <, 1e-9);
+    g_assert_cmpfloat(station.pm10, ==, 12.0); // Absent from the event
+    g_assert_cmpint(station.aqi, ==, calculate_aqi_from_pm25(60.12));
+}
+
+static void test_cwop()
+{
+    WAQIStationData station = {};
+    WAQIHourlyMeans hourly;
+    WAQIEventType type = decode(station,
+                                "{\"type\":\"cwop\",\"data\":{\"x\":[{\"a\":1,\"t\":20,\"dew\":10,\"w\":3,\"wd\":90},"
+                                "{\"a\":2,\"t\":22.5,\"dew\":22.5,\"w\":4.5,\"wd\":180}]}}",
+                                &hourly);
+    g_assert_cmpint(type, ==, WAQI_EVENT_CWOP);
+    g_assert_cmpfloat(station.temperature, ==, 22.5);
+    g_assert_cmpfloat(fabs(station.humidity - 100.0), <, 1e-9);
+    g_assert_cmpfloat(station.wind_speed, ==, 4.5);
+    g_assert_cmpint(station.wind_direction, ==, 180);
+}
+
+// Only the entries' own members count, an entry's leading "t" does not,
+// and nothing past the event's length is read
+static void test_cwop_entries()
+{
+    WAQIStationData station = {};
+    WAQIHourlyMeans hourly;
+    std::string json = "{\"type\":\"cwop\",\"data\":{\"x\":[{\"a\":1,\"t\":20,\"w\":3,\"wd\":90},"
+                       "{\"a\":2,\"q\":{\"t\":99},\"w\":7},{\"t\":30,\"w\":8},"
+                       "{\"a\":3,\"t\":21,\"w\":4,\"wd\":18";
+    std::string buffer = json + "0}]}}";
+    WAQIEventType type = waqi_decode_event(station, buffer.c_str(), json.size(), &hourly);
+    g_assert_cmpint(type, ==, WAQI_EVENT_CWOP);
+    g_assert_cmpfloat(station.temperature, ==, 21);
+    g_assert_cmpfloat(station.wind_speed, ==, 4);
+    g_assert_cmpint(station.wind_direction, ==, 18);
+}
+
+static void test_hourly()
+{
+    WAQIStationData station = {};
+    WAQIHourlyMeans hourly;
+    // Strings that look like structure, a nested "mean" and a "mean" value
+    // all belong to the hour objects without being their means
+    std::string json = "{\"type\":\"hourly\",\"pm25\":" + hourly_array(WAQI_HOURLY_MAX + 6, 100) +
+                       ",\"co\":" + hourly_array(3, 0) +
+                       ",\"o3\":[{\"s\":\"]}\\\\\",\"x\":\"\\\"mean\\\":\",\"d\":{\"mean\":7},\"mean\":1.5},"
+                       "{\"k\":\"mean\",\"mean\":-2}],\"pm10\":[]}";
+    WAQIEventType type = decode(station, json, &hourly);
+    g_assert_cmpint(type, ==, WAQI_EVENT_HOURLY);
+
+    size_t pm25 = field_index("pm25");
+    g_assert_cmpuint(hourly.n_points[pm25], ==, WAQI_HOURLY_MAX);
+    for (size_t i = 0; i < WAQI_HOURLY_MAX; i++)
+    {
+        g_assert_cmpfloat(hourly.points[pm25][i].value, ==, 100.0f + i);
+        g_assert_cmpuint(hourly.points[pm25][i].time, ==, HOURLY_START + i * 3600);
+    }
+
+    // Without a "t" of their own the points are left untimed
+    size_t o3 = field_index("o3");
+    g_assert_cmpuint(hourly.n_points[o3], ==, 2);
+    g_assert_cmpfloat(hourly.points[o3][0].value, ==, 1.5f);
+    g_assert_cmpfloat(hourly.points[o3][1].value, ==, -2.0f);
+    g_assert_cmpuint(hourly.points[o3][0].time, ==, 0);
+    g_assert_cmpuint(hourly.points[o3][1].time, ==, 0);
+
+    g_assert_cmpuint(hourly.n_points[field_index("pm10")], ==, 0);
+    g_assert_cmpuint(hourly.n_points[field_index("co")], ==, 0); // Has no history
+}
+
+static void test_hourly_times()
+{
+    WAQIStationData station = {};
+    WAQIHourlyMeans hourly;
+    // Newest first, as dates, mid-hour, and with a nested "t" to ignore
+    std::string json = "{\"type\":\"hourly\",\"pm25\":[{\"t\":\"2023-11-15 00:30:00\",\"mean\":3},"
+                       "{\"mean\":2,\"x\":{\"t\":5},\"t\":\"2023-11-14T23:00:00Z\"},"
+                       "{\"t\":\"2023-11-15T00:00:00+02:00\",\"mean\":1}],"
+                       "\"pm10\":[{\"t\":1699999200,\"mean\":1},{\"mean\":2}]}";
+    g_assert_cmpint(decode(station, json, &hourly), ==, WAQI_EVENT_HOURLY);
+
+    size_t pm25 = field_index("pm25");
+    g_assert_cmpuint(hourly.n_points[pm25], ==, 3);
+    for (size_t i = 0; i < 3; i++)
+    {
+        g_assert_cmpfloat(hourly.points[pm25][i].value, ==, (float)(1 + i));
+        g_assert_cmpuint(hourly.points[pm25][i].time, ==, HOURLY_START + i * 3600);
+    }
+
+    // One entry without a time leaves the whole pollutant untimed
+    size_t pm10 = field_index("pm10");
+    g_assert_cmpuint(hourly.n_points[pm10], ==, 2);
+    g_assert_cmpuint(hourly.points[pm10][0].time, ==, 0);
+    g_assert_cmpuint(hourly.points[pm10][1].time, ==, 0);
+}
+
+// Shifts an event across the block boundaries with a leading member whose
+// string ends in runs of backslashes, and checks it decodes the same
+static void test_block_offsets()
+{
+    for (size_t pad = 0; pad < 140; pad++)
+    {
+        for (const char *tail : {"", "\\\\", "\\\"", "\\\\\\\"\\\\"})
+        {
+            std::string json = "{\"p\":\"" + std::string(pad, 'm') + tail + "\",\"type\":\"hourly\",\"pm25\":" +
+                               hourly_array(5, pad) + ",\"no2\":[[\"[{\"],{\"mean\":3,\"q\":\"}\"}]}";
+            WAQIStationData station = {};
+            WAQIHourlyMeans hourly;
+            g_assert_cmpint(decode(station, json, &hourly), ==, WAQI_EVENT_HOURLY);
+
+            size_t pm25 = field_index("pm25");
+            g_assert_cmpuint(hourly.n_points[pm25], ==, 5);
+            for (size_t i = 0; i < 5; i++)
+                g_assert_cmpfloat(hourly.points[pm25][i].value, ==, (float)(pad + i));
+            size_t no2 = field_index("no2");
+            g_assert_cmpuint(hourly.n_points[no2], ==, 0); // Not hour objects
+        }
+    }
+}
+
+// Appends a value for json_skip_value to step over, nested `depth` deep
+static void append_value(std::string &json, unsigned &seed, int depth)
+{
+    seed = seed * 1103515245u + 12345u;
+    unsigned pick = (seed >> 16) % (depth > 0 ? 4 : 2);
+    if (pick == 0)
+    {
+        static const char *const parts[] = {"a", "[", "}", "\\\"", "\\\\", "\\u00e3", " ", "mean"};
+        json += '"';
+        for (unsigned n = (seed >> 8) % 40; n; n--)
+        {
+            seed = seed * 1103515245u + 12345u;
+            json += parts[(seed >> 16) % G_N_ELEMENTS(parts)];
+        }
+        json += '"';
+    }
+    else if (pick == 1)
+    {
+        json += std::to_string((int)(seed >> 12) % 100000 - 50000);
+    }
+    else
+    {
+        bool object = pick == 3;
+        json += object ? '{' : '[';
+        for (unsigned n = (seed >> 8) % 9, i = 0; i < n; i++)
+        {
+            if (i)
+                json += ',';
+            if (object)
+                json += "\"k" + std::to_string(i) + "\": ";
+            append_value(json, seed, depth - 1);
+        }
+        json += object ? '}' : ']';
+    }
+}
+
+static void test_skip_value()
+{
+    unsigned seed = 1;
+    for (int i = 0; i < 2000; i++)
+    {
+        std::string json;
+        append_value(json, seed, 1 + i % 5);
+        size_t len = json.size();
+        json += ",\"next\":[1]}";
+
+        for (size_t shift = 0; shift < 3; shift++)
+        {
+            std::string buf = std::string(shift, ' ') + json;
+            const char *p = buf.data() + shift;
+            const char *end = buf.data() + buf.size();
+            g_assert_cmpuint(json_skip_value(p, end) - p, ==, len);
+            // Cut short, a container runs to the end of the input
+            if (len > 1 && (json[0] == '[' || json[0] == '{'))
+                g_assert_true(json_skip_value(p, p + len - 1) == p + len - 1);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/sse-decode/meta", test_meta);
+    g_test_add_func("/sse-decode/instant", test_instant);
+    g_test_add_func("/sse-decode/cwop", test_cwop);
+    g_test_add_func("/sse-decode/cwop-entries", test_cwop_entries);
+    g_test_add_func("/sse-decode/hourly", test_hourly);
+    g_test_add_func("/sse-decode/hourly-times", test_hourly_times);
+    g_test_add_func("/sse-decode/block-offsets", test_block_offsets);
+    g_test_add_func("/sse-decode/skip-value", test_skip_value);
+    return g_test_run();
+}
@@ -0,0 +1,126 @@
+// Tests for the SSE framer: line endings, field handling, chunk boundaries
+// and the discarding of events that outgrow SSE_MAX_EVENT_SIZE.
+
+#include "aqi_core.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+static void collect_event(const char *data, size_t len, gpointer user_data)
+{
+    std::vector<std::string> *events = (std::vector<std::string> *)user_data;
+    g_assert_cmpuint(strlen(data), ==, len); // NUL-terminated in place
+    events->push_back(std::string(data, len));
+}
+
+// Feeds `stream` in chunks of at most `chunk` bytes, as the reader does
+static void feed(SseFramer *f, const std::string &stream, size_t chunk)
+{
+    size_t off = 0;
+    while (off < stream.size())
+    {
+        size_t avail;
+        char *tail = sse_framer_reserve(f, &avail);
+        size_t n = std::min(std::min(avail, chunk), stream.size() - off);
+        memcpy(tail, stream.data() + off, n);
+        sse_framer_feed(f, n);
+        off += n;
+    }
+}
+
+static std::vector<std::string> frame(const std::string &stream, size_t chunk)
+{
+    std::vector<std::string> events;
+    SseFramer f;
+    sse_framer_init(&f, collect_event, &events);
+    feed(&f, stream, chunk);
+    g_free(f.data);
+    return events;
+}
+
+static void test_line_endings()
+{
+    // A trailing '\r' waits for the next chunk, so each stream goes on a little
+    const char *streams[] = {"data: a\n\ndata: b\n\n:", "data: a\r\n\r\ndata: b\r\n\r\n:", "data: a\r\rdata: b\r\r:"};
+    for (const char *s : streams)
+    {
+        std::vector<std::string> events = frame(s, 4096);
+        g_assert_cmpuint(events.size(), ==, 2);
+        g_assert_cmpstr(events[0].c_str(), ==, "a");
+        g_assert_cmpstr(events[1].c_str(), ==, "b");
+    }
+}
+
+static void test_fields()
+{
+    std::vector<std::string> events;
+    SseFramer f;
+    sse_framer_init(&f, collect_event, &events);
+    feed(&f, "\xEF\xBB\xBF: keep-alive\n\nid: 41\nretry: 2500\nevent: x\ndata:one\ndata: two\n\nid: 42\n\n", 4096);
+
+    g_assert_cmpuint(events.size(), ==, 1);
+    g_assert_cmpstr(events[0].c_str(), ==, "one\ntwo");
+    g_assert_cmpstr(f.last_event_id, ==, "42");
+    g_assert_cmpuint(f.retry_ms, ==, 2500);
+    g_free(f.data);
+}
+
+static void test_chunk_boundaries()
+{
+    std::string stream = "data: {\"type\":\"instant\"}\r\n\r\n: ping\r\ndata: x\r\ndata: y\r\rdata: z\n\n";
+    for (size_t chunk = 1; chunk <= stream.size(); chunk++)
+    {
+        std::vector<std::string> events = frame(stream, chunk);
+        g_assert_cmpuint(events.size(), ==, 3);
+        g_assert_cmpstr(events[0].c_str(), ==, "{\"type\":\"instant\"}");
+        g_assert_cmpstr(events[1].c_str(), ==, "x\ny");
+        g_assert_cmpstr(events[2].c_str(), ==, "z");
+    }
+}
+
+static void test_oversized_event()
+{
+    // The tail of the dropped event holds data lines of its own; none of it
+    // may come out as an event
+    std::string big = "data: " + std::string(SSE_MAX_EVENT_SIZE + 1024, 'x') + "\ndata: tail\ndata: more\n\n";
+    const char *endings[] = {"\n", "\r\n", "\r"};
+    for (const char *eol : endings)
+    {
+        std::string stream = "data: before\n\n" + big + "data: after" + eol + eol + ":";
+        for (size_t chunk : {(size_t)4096, (size_t)65536})
+        {
+            std::vector<std::string> events = frame(stream, chunk);
+            g_assert_cmpuint(events.size(), ==, 2);
+            g_assert_cmpstr(events[0].c_str(), ==, "before");
+            g_assert_cmpstr(events[1].c_str(), ==, "after");
+        }
+    }
+}
+
+static void test_reset_clears_discard()
+{
+    std::vector<std::string> events;
+    SseFramer f;
+    sse_framer_init(&f, collect_event, &events);
+    feed(&f, "data: " + std::string(SSE_MAX_EVENT_SIZE + 1024, 'x'), 65536);
+    g_assert_true(f.discarding);
+
+    // A reconnect starts from a clean stream
+    sse_framer_reset(&f);
+    feed(&f, "data: fresh\n\n", 4096);
+    g_assert_cmpuint(events.size(), ==, 1);
+    g_assert_cmpstr(events[0].c_str(), ==, "fresh");
+    g_free(f.data);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/sse-framer/line-endings", test_line_endings);
+    g_test_add_func("/sse-framer/fields", test_fields);
+    g_test_add_func("/sse-framer/chunk-boundaries", test_chunk_boundaries);
+    g_test_add_func("/sse-framer/oversized-event", test_oversized_event);
+    g_test_add_func("/sse-framer/reset-clears-discard", test_reset_clears_discard);
+    return g_test_run();
+}